@@ -8,6 +8,7 @@ import multiprocessing
 import subprocess
 import shutil
 import sys
+import os
 import os.path as path
 import argparse
 
@@ -84,16 +85,21 @@ def download_micropython():
     if path.exists(MICRO_PYTHON_DIR): return
     cmd(["git", "clone", "https://github.com/micropython/micropython.git", MICRO_PYTHON_DIR])
 
-def build_micropython():
+def build_micropython(bench=False, stats=False):
     ensure_exe_installed(["make", "arm-none-eabi-gcc"])
 
 
     cmd(["make", "submodules"], cwd=RP_DIR)
 
+    # The rp2 Makefile appends its own arguments to CMAKE_ARGS from the environment
+    env = dict(os.environ)
+    env["CMAKE_ARGS"] = env.get("CMAKE_ARGS", "") + f" -DSTEPPER_BENCH={'ON' if bench else 'OFF'}"
+    env["CMAKE_ARGS"] += f" -DSTEPPER_STATS={'ON' if stats else 'OFF'}"
+
     cmd(["make",
          f"USER_C_MODULES=\"{path.join(ROOT, USER_MODULE_DIR)}\"",
          '-j', str(multiprocessing.cpu_count() - 1),
-         ], cwd=RP_DIR)
+         ], cwd=RP_DIR, env=env)
 
     if path.exists(BUILD_DIR):
         shutil.rmtree(BUILD_DIR)
@@ -121,6 +127,8 @@ def main():
     parser.add_argument("--clean", action="store_true", help="Clean build artifacts before building")
     parser.add_argument("--rebuild", action="store_true", help="Clean and rebuild Micropython")
     parser.add_argument("--flash", action="store_true", help="Flash the built firmware to the PICO after building")
+    parser.add_argument("--bench", action="store_true", help="Include the `stepper.bench()` microbenchmarks")
+    parser.add_argument("--stats", action="store_true", help="Record step timing, read with `stats()`")
 
     args = parser.parse_args()
 
@@ -133,7 +141,7 @@ def main():
 
     download_micropython()
 
-    build_micropython()
+    build_micropython(bench=args.bench, stats=args.stats)
 
     if args.flash:
         flash_micropython()
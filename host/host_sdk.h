@@ -0,0 +1,105 @@
+#ifndef HOST_SDK_H
+#define HOST_SDK_H
+
+/*
+ * Inspection API of the host stand-ins for the PICO SDK.
+ *
+ * The stand-ins record every write to a simulated peripheral register so
+ * that host tools can check what the library would have done on a PICO.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A single 32 bit store to a simulated peripheral register.
+ */
+typedef struct {
+    uint64_t time_us;
+    volatile uint32_t * reg;
+    uint32_t value;
+} HostWrite;
+
+/*
+ * A change of the PWM level driving a GPIO.
+ */
+typedef struct {
+    uint64_t time_us;
+    uint8_t gpio;
+    uint16_t level;
+} HostPinChange;
+
+/*
+ * Reset all simulated peripherals, the virtual clock, the write log and the
+ * pin trace.
+ */
+void host_reset(void);
+
+/*
+ * Recorded register writes since the last `host_reset` or `host_clear_writes`.
+ */
+const HostWrite * host_writes(void);
+size_t host_write_count(void);
+void host_clear_writes(void);
+
+/*
+ * Enable or disable recording of register writes. Recording is enabled after
+ * `host_reset`. Disable it for long benchmark runs.
+ */
+void host_set_write_log(bool enabled);
+
+/*
+ * Enable or disable the pin trace. Tracing is disabled after `host_reset`.
+ *
+ * While enabled, every change of the PWM level of a GPIO set to
+ * `GPIO_FUNC_PWM` is recorded with the virtual time, whether it was written
+ * by the CPU or by DMA.
+ */
+void host_set_pin_trace(bool enabled);
+
+/*
+ * Recorded pin level changes since the last `host_reset` or
+ * `host_clear_pin_changes`.
+ */
+const HostPinChange * host_pin_changes(void);
+size_t host_pin_change_count(void);
+void host_clear_pin_changes(void);
+
+/*
+ * Current PWM level of a GPIO.
+ */
+uint16_t host_pin_level(unsigned int gpio);
+
+/*
+ * Write the pin trace as text, one `time_us gpio level` line per change.
+ */
+void host_write_pin_trace(FILE * file);
+
+/*
+ * Advance the virtual clock, running every hardware alarm callback due on the
+ * way in deadline order. The clock reads the alarm target while a callback
+ * runs, so deadlines are observed exactly.
+ */
+void host_time_advance(uint64_t us);
+void host_time_advance_to(uint64_t time_us);
+
+/*
+ * Simulate the CPU time of the library by advancing the virtual clock by
+ * `ns` nanoseconds on every register write. Zero after `host_reset`.
+ */
+void host_set_write_cost(uint32_t ns);
+
+/*
+ * Let the given DMA pacing timer fire once. Every busy channel paced by the
+ * timer performs a single transfer.
+ */
+void host_dma_timer_tick(unsigned int timer);
+
+/*
+ * Read back the fraction set with `dma_timer_set_fraction`.
+ */
+void host_dma_timer_fraction(unsigned int timer, uint16_t * numerator, uint16_t * denominator);
+
+#endif // HOST_SDK_H
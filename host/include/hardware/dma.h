@@ -0,0 +1,74 @@
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUM_DMA_CHANNELS 12
+#define NUM_DMA_TIMERS    4
+
+#define DREQ_DMA_TIMER0 0x3b
+#define DREQ_FORCE      0x3f
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8  = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+/*
+ * Channel registers. Addresses are host pointers, hence `uintptr_t`
+ * instead of the 32 bit registers of the RP2040.
+ */
+typedef struct {
+    volatile uintptr_t read_addr;
+    volatile uintptr_t write_addr;
+    volatile uint32_t  transfer_count;
+    volatile uint32_t  ctrl_trig;
+
+    // Writing the transfer count through this alias also triggers the channel
+    volatile uint32_t  al1_transfer_count_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    bool read_increment;
+    bool write_increment;
+    enum dma_channel_transfer_size size;
+    unsigned int ring_bits;
+    bool ring_write;
+    unsigned int dreq;
+    unsigned int chain_to;
+    bool enable;
+} dma_channel_config;
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(unsigned int channel);
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+
+void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config * c, bool incr);
+void channel_config_set_write_increment(dma_channel_config * c, bool incr);
+void channel_config_set_ring(dma_channel_config * c, bool write, unsigned int size_bits);
+void channel_config_set_dreq(dma_channel_config * c, unsigned int dreq);
+void channel_config_set_chain_to(dma_channel_config * c, unsigned int chain_to);
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config * config,
+                           volatile void * write_addr, const volatile void * read_addr,
+                           uint32_t transfer_count, bool trigger);
+
+void dma_start_channel_mask(uint32_t chan_mask);
+void dma_channel_abort(unsigned int channel);
+bool dma_channel_is_busy(unsigned int channel);
+
+dma_channel_hw_t * dma_channel_hw_addr(unsigned int channel);
+
+int  dma_claim_unused_timer(bool required);
+void dma_timer_unclaim(unsigned int timer);
+void dma_timer_set_fraction(unsigned int timer, uint16_t numerator, uint16_t denominator);
+
+static inline unsigned int dma_get_timer_dreq(unsigned int timer_num) {
+    return DREQ_DMA_TIMER0 + timer_num;
+}
+
+#endif // HOST_HARDWARE_DMA_H
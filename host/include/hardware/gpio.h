@@ -0,0 +1,14 @@
+#ifndef HOST_HARDWARE_GPIO_H
+#define HOST_HARDWARE_GPIO_H
+
+#include <stdint.h>
+
+enum gpio_function {
+    GPIO_FUNC_SIO  = 5,
+    GPIO_FUNC_PWM  = 4,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn);
+
+#endif // HOST_HARDWARE_GPIO_H
@@ -0,0 +1,50 @@
+#ifndef HOST_HARDWARE_PWM_H
+#define HOST_HARDWARE_PWM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUM_PWM_SLICES 8
+
+enum pwm_chan {
+    PWM_CHAN_A = 0,
+    PWM_CHAN_B = 1,
+};
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t div;
+    volatile uint32_t ctr;
+    volatile uint32_t cc;
+    volatile uint32_t top;
+} pwm_slice_hw_t;
+
+typedef struct {
+    pwm_slice_hw_t slice[NUM_PWM_SLICES];
+    volatile uint32_t en;
+} pwm_hw_t;
+
+/*
+ * Register block of the simulated PWM peripheral.
+ */
+extern pwm_hw_t host_pwm_hw;
+#define pwm_hw (&host_pwm_hw)
+
+static inline unsigned int pwm_gpio_to_slice_num(unsigned int gpio) {
+    return (gpio >> 1u) & 7u;
+}
+
+static inline unsigned int pwm_gpio_to_channel(unsigned int gpio) {
+    return gpio & 1u;
+}
+
+void pwm_set_wrap(unsigned int slice_num, uint16_t wrap);
+void pwm_set_enabled(unsigned int slice_num, bool enabled);
+void pwm_set_clkdiv(unsigned int slice_num, float divider);
+void pwm_set_chan_level(unsigned int slice_num, unsigned int chan, uint16_t level);
+void pwm_set_both_levels(unsigned int slice_num, uint16_t level_a, uint16_t level_b);
+void pwm_set_gpio_level(unsigned int gpio, uint16_t level);
+void pwm_set_counter(unsigned int slice_num, uint16_t c);
+void pwm_set_mask_enabled(uint32_t mask);
+
+#endif // HOST_HARDWARE_PWM_H
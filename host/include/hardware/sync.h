@@ -0,0 +1,19 @@
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+/*
+ * Data memory barrier. Orders memory accesses between the two cores.
+ */
+static inline void __dmb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ * Send an event, waking a core waiting in `__wfe`. Nothing waits on the host.
+ */
+static inline void __sev(void) {
+}
+
+#endif // HOST_HARDWARE_SYNC_H
@@ -0,0 +1,39 @@
+#ifndef HOST_HARDWARE_TIMER_H
+#define HOST_HARDWARE_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * The host timer runs on a virtual clock that only moves when `sleep_us` is
+ * called or a host tool advances it. See `host_sdk.h`.
+ */
+
+#define NUM_GENERIC_TIMERS 1
+#define NUM_ALARMS 4
+
+typedef uint64_t absolute_time_t;
+
+typedef void (*hardware_alarm_callback_t)(unsigned int alarm_num);
+
+static inline absolute_time_t from_us_since_boot(uint64_t us) {
+    return us;
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+void busy_wait_until(absolute_time_t t);
+
+int  hardware_alarm_claim_unused(bool required);
+void hardware_alarm_unclaim(unsigned int alarm_num);
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(unsigned int alarm_num);
+void hardware_alarm_force_irq(unsigned int alarm_num);
+
+#endif // HOST_HARDWARE_TIMER_H
@@ -0,0 +1,31 @@
+#ifndef HOST_PICO_MULTICORE_H
+#define HOST_PICO_MULTICORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Core 1 is simulated with a thread. The inter-core FIFOs block like the
+ * hardware ones, 8 words deep in each direction.
+ *
+ * Everything else of the host stand-ins is single threaded, so code on the
+ * simulated core 1 must be the only user of the virtual clock and the
+ * simulated peripherals while it runs.
+ */
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+bool multicore_fifo_rvalid(void);
+bool multicore_fifo_wready(void);
+
+void multicore_lockout_victim_init(void);
+bool multicore_lockout_victim_is_initialized(unsigned int core_num);
+
+/*
+ * Number of the calling core.
+ */
+unsigned int get_core_num(void);
+
+#endif // HOST_PICO_MULTICORE_H
@@ -0,0 +1,35 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+/*
+ * Host stand-in for the PICO SDK `pico/stdlib.h`.
+ *
+ * Only the parts used by `stepperlib` are provided.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+// Set by the SDK for builds running on the RP2040
+#define PICO_ON_DEVICE 0
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+
+/*
+ * Print the message and abort the host process.
+ */
+void panic(const char * fmt, ...);
+
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#endif // HOST_PICO_STDLIB_H
@@ -0,0 +1,30 @@
+#ifndef HOST_PICO_SYNC_H
+#define HOST_PICO_SYNC_H
+
+#include <stdbool.h>
+
+/*
+ * The host runs everything on a single thread, including simulated
+ * interrupts, so critical sections only track their nesting.
+ */
+typedef struct {
+    int depth;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t * crit_sec) {
+    crit_sec->depth = 0;
+}
+
+static inline void critical_section_enter_blocking(critical_section_t * crit_sec) {
+    crit_sec->depth++;
+}
+
+static inline void critical_section_exit(critical_section_t * crit_sec) {
+    crit_sec->depth--;
+}
+
+static inline void critical_section_deinit(critical_section_t * crit_sec) {
+    (void)crit_sec;
+}
+
+#endif // HOST_PICO_SYNC_H
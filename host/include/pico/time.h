@@ -0,0 +1,20 @@
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+#include <stdint.h>
+
+#include "hardware/timer.h"
+
+/*
+ * Sleep for the given number of microseconds of virtual time.
+ */
+void sleep_us(uint64_t us);
+
+/*
+ * Sleep until the next hardware alarm interrupt or until `t`, whichever is
+ * first. Returns true if `t` was reached. Events sent with `__sev` do not
+ * wake the host, so a wait for one ends at the next alarm or the timeout.
+ */
+bool best_effort_wfe_or_timeout(absolute_time_t t);
+
+#endif // HOST_PICO_TIME_H
@@ -0,0 +1,102 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <pico/stdlib.h>
+#include <pico/multicore.h>
+
+#define FIFO_DEPTH 8
+
+typedef struct {
+    uint32_t items[FIFO_DEPTH];
+    uint head;
+    uint count;
+} Fifo;
+
+static pthread_mutex_t fifo_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fifo_changed = PTHREAD_COND_INITIALIZER;
+
+// Indexed by the receiving core
+static Fifo fifos[2];
+
+static pthread_t core1_thread;
+static bool core1_launched;
+static bool victim_initialized[2];
+
+static _Thread_local unsigned int core_num;
+
+static void * core1_main(void * arg) {
+    core_num = 1;
+    ((void (*)(void))arg)();
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    if (core1_launched) panic("core 1 is already running");
+
+    core1_launched = true;
+    if (pthread_create(&core1_thread, NULL, core1_main, (void *)entry)) panic("failed to start core 1");
+}
+
+void multicore_reset_core1(void) {
+    if (!core1_launched) return;
+
+    // A thread can not be reset, so core 1 must have returned from its entry
+    pthread_join(core1_thread, NULL);
+    core1_launched = false;
+    victim_initialized[1] = false;
+
+    pthread_mutex_lock(&fifo_lock);
+    fifos[0] = (Fifo){0};
+    fifos[1] = (Fifo){0};
+    pthread_mutex_unlock(&fifo_lock);
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    Fifo * fifo = &fifos[1 - core_num];
+
+    pthread_mutex_lock(&fifo_lock);
+    while (fifo->count == FIFO_DEPTH) pthread_cond_wait(&fifo_changed, &fifo_lock);
+    fifo->items[(fifo->head + fifo->count++) % FIFO_DEPTH] = data;
+    pthread_cond_broadcast(&fifo_changed);
+    pthread_mutex_unlock(&fifo_lock);
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    Fifo * fifo = &fifos[core_num];
+
+    pthread_mutex_lock(&fifo_lock);
+    while (fifo->count == 0) pthread_cond_wait(&fifo_changed, &fifo_lock);
+    uint32_t data = fifo->items[fifo->head];
+    fifo->head = (fifo->head + 1) % FIFO_DEPTH;
+    fifo->count--;
+    pthread_cond_broadcast(&fifo_changed);
+    pthread_mutex_unlock(&fifo_lock);
+
+    return data;
+}
+
+bool multicore_fifo_rvalid(void) {
+    pthread_mutex_lock(&fifo_lock);
+    bool valid = fifos[core_num].count > 0;
+    pthread_mutex_unlock(&fifo_lock);
+    return valid;
+}
+
+bool multicore_fifo_wready(void) {
+    pthread_mutex_lock(&fifo_lock);
+    bool ready = fifos[1 - core_num].count < FIFO_DEPTH;
+    pthread_mutex_unlock(&fifo_lock);
+    return ready;
+}
+
+void multicore_lockout_victim_init(void) {
+    victim_initialized[core_num] = true;
+}
+
+bool multicore_lockout_victim_is_initialized(unsigned int core) {
+    return victim_initialized[core];
+}
+
+unsigned int get_core_num(void) {
+    return core_num;
+}
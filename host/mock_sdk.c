@@ -0,0 +1,475 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/pwm.h>
+#include <hardware/timer.h>
+
+#include "host_sdk.h"
+
+#define NUM_GPIOS 30
+
+pwm_hw_t host_pwm_hw;
+
+static enum gpio_function gpio_functions[NUM_GPIOS];
+
+static dma_channel_hw_t   dma_channels[NUM_DMA_CHANNELS];
+static dma_channel_config dma_configs[NUM_DMA_CHANNELS];
+static bool               dma_channel_claimed[NUM_DMA_CHANNELS];
+static bool               dma_channel_busy[NUM_DMA_CHANNELS];
+static uint32_t           dma_reload_count[NUM_DMA_CHANNELS];
+
+static bool     dma_timer_claimed[NUM_DMA_TIMERS];
+static uint16_t dma_timer_num[NUM_DMA_TIMERS];
+static uint16_t dma_timer_den[NUM_DMA_TIMERS];
+
+static uint64_t now_us;
+
+static uint32_t write_cost_ns;
+static uint32_t write_cost_acc_ns; // Cost not yet added to the clock
+
+static bool                      alarm_claimed[NUM_ALARMS];
+static bool                      alarm_armed[NUM_ALARMS];
+static uint64_t                  alarm_target[NUM_ALARMS];
+static hardware_alarm_callback_t alarm_callback[NUM_ALARMS];
+
+static HostWrite * writes = NULL;
+static size_t writes_len = 0;
+static size_t writes_cap = 0;
+static bool writes_enabled = true;
+
+static uint16_t        pin_levels[NUM_GPIOS];
+static HostPinChange * pin_changes = NULL;
+static size_t pin_changes_len = 0;
+static size_t pin_changes_cap = 0;
+static bool pin_trace_enabled = false;
+
+// ==================== INSPECTION ====================
+
+static void log_write(volatile uint32_t * reg, uint32_t value) {
+    if (!writes_enabled) return;
+    if (writes_len == writes_cap) {
+        writes_cap = writes_cap ? writes_cap * 2 : 1024;
+        writes = realloc(writes, writes_cap * sizeof(HostWrite));
+        if (!writes) panic("out of memory for write log");
+    }
+    writes[writes_len++] = (HostWrite){ .time_us = now_us, .reg = reg, .value = value };
+}
+
+static void log_pin_change(unsigned int gpio, uint16_t level) {
+    if (pin_changes_len == pin_changes_cap) {
+        pin_changes_cap = pin_changes_cap ? pin_changes_cap * 2 : 1024;
+        pin_changes = realloc(pin_changes, pin_changes_cap * sizeof(HostPinChange));
+        if (!pin_changes) panic("out of memory for pin trace");
+    }
+    pin_changes[pin_changes_len++] = (HostPinChange){ .time_us = now_us, .gpio = gpio, .level = level };
+}
+
+// Update the levels of the PWM GPIOs driven by a slice. GPIO n and n + 16
+// share a slice channel.
+static void update_pins(unsigned int slice) {
+    uint32_t cc = pwm_hw->slice[slice].cc;
+
+    for (unsigned int gpio = slice * 2; gpio < NUM_GPIOS; gpio += 16) {
+        for (unsigned int chan = 0; chan < 2; chan++) {
+            uint16_t level = chan ? cc >> 16 : cc & 0xffff;
+            unsigned int pin = gpio + chan;
+
+            if (pin >= NUM_GPIOS || gpio_functions[pin] != GPIO_FUNC_PWM) continue;
+            if (pin_levels[pin] == level) continue;
+
+            pin_levels[pin] = level;
+            if (pin_trace_enabled) log_pin_change(pin, level);
+        }
+    }
+}
+
+static void dma_trigger(unsigned int channel, uint32_t transfer_count);
+
+static void reg_write(volatile uint32_t * reg, uint32_t value) {
+    *reg = value;
+    log_write(reg, value);
+
+    // The time spent writing passes without running alarm callbacks
+    write_cost_acc_ns += write_cost_ns;
+    now_us            += write_cost_acc_ns / 1000;
+    write_cost_acc_ns %= 1000;
+
+    for (unsigned int slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        if (reg == &pwm_hw->slice[slice].cc) update_pins(slice);
+    }
+    for (unsigned int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (reg != &dma_channels[ch].al1_transfer_count_trig) continue;
+        dma_reload_count[ch] = value;
+        dma_trigger(ch, value);
+    }
+}
+
+void host_reset(void) {
+    memset(&host_pwm_hw, 0, sizeof(host_pwm_hw));
+    memset(gpio_functions, 0, sizeof(gpio_functions));
+
+    memset(dma_channels, 0, sizeof(dma_channels));
+    memset(dma_configs, 0, sizeof(dma_configs));
+    memset(dma_channel_claimed, 0, sizeof(dma_channel_claimed));
+    memset(dma_channel_busy, 0, sizeof(dma_channel_busy));
+    memset(dma_reload_count, 0, sizeof(dma_reload_count));
+
+    memset(dma_timer_claimed, 0, sizeof(dma_timer_claimed));
+    memset(dma_timer_num, 0, sizeof(dma_timer_num));
+    memset(dma_timer_den, 0, sizeof(dma_timer_den));
+
+    now_us = 0;
+    write_cost_ns     = 0;
+    write_cost_acc_ns = 0;
+    memset(alarm_claimed, 0, sizeof(alarm_claimed));
+    memset(alarm_armed, 0, sizeof(alarm_armed));
+    memset(alarm_target, 0, sizeof(alarm_target));
+    memset(alarm_callback, 0, sizeof(alarm_callback));
+
+    host_clear_writes();
+    writes_enabled = true;
+
+    memset(pin_levels, 0, sizeof(pin_levels));
+    host_clear_pin_changes();
+    pin_trace_enabled = false;
+}
+
+const HostWrite * host_writes(void) { return writes; }
+size_t host_write_count(void) { return writes_len; }
+void host_clear_writes(void) { writes_len = 0; }
+void host_set_write_log(bool enabled) { writes_enabled = enabled; }
+
+void host_set_pin_trace(bool enabled) { pin_trace_enabled = enabled; }
+const HostPinChange * host_pin_changes(void) { return pin_changes; }
+size_t host_pin_change_count(void) { return pin_changes_len; }
+void host_clear_pin_changes(void) { pin_changes_len = 0; }
+
+uint16_t host_pin_level(unsigned int gpio) {
+    return gpio < NUM_GPIOS ? pin_levels[gpio] : 0;
+}
+
+void host_write_pin_trace(FILE * file) {
+    fprintf(file, "# time_us gpio level\n");
+    for (size_t i = 0; i < pin_changes_len; i++) {
+        const HostPinChange * c = &pin_changes[i];
+        fprintf(file, "%llu %u %u\n", (unsigned long long)c->time_us, c->gpio, c->level);
+    }
+}
+
+// ==================== STDLIB ====================
+
+void panic(const char * fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+void sleep_us(uint64_t us) {
+    host_time_advance(us);
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    (void)clk_index;
+    return 125000000;
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn) {
+    if (gpio >= NUM_GPIOS) panic("invalid gpio %u", gpio);
+    gpio_functions[gpio] = fn;
+
+    // Start tracing from the level the slice already drives
+    if (fn == GPIO_FUNC_PWM) update_pins(pwm_gpio_to_slice_num(gpio));
+}
+
+// ==================== TIMER ====================
+
+uint64_t time_us_64(void) { return now_us; }
+uint32_t time_us_32(void) { return (uint32_t)now_us; }
+
+void busy_wait_until(absolute_time_t t) {
+    if (t > now_us) host_time_advance_to(t);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    uint64_t wake = t;
+    for (int a = 0; a < NUM_ALARMS; a++) {
+        if (alarm_armed[a] && alarm_target[a] < wake) wake = alarm_target[a];
+    }
+    host_time_advance_to(wake);
+    return now_us >= t;
+}
+
+int hardware_alarm_claim_unused(bool required) {
+    for (int a = 0; a < NUM_ALARMS; a++) {
+        if (alarm_claimed[a]) continue;
+        alarm_claimed[a] = true;
+        return a;
+    }
+    if (required) panic("no hardware alarms available");
+    return -1;
+}
+
+void hardware_alarm_unclaim(unsigned int alarm_num) {
+    alarm_claimed[alarm_num] = false;
+    alarm_armed[alarm_num]   = false;
+}
+
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback) {
+    alarm_callback[alarm_num] = callback;
+    if (!callback) alarm_armed[alarm_num] = false;
+}
+
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t) {
+    if (t <= now_us) {
+        alarm_armed[alarm_num] = false;
+        return true;
+    }
+    alarm_target[alarm_num] = t;
+    alarm_armed[alarm_num]  = true;
+    return false;
+}
+
+void hardware_alarm_cancel(unsigned int alarm_num) {
+    alarm_armed[alarm_num] = false;
+}
+
+// The interrupt is taken on the next advance of the clock
+void hardware_alarm_force_irq(unsigned int alarm_num) {
+    alarm_target[alarm_num] = now_us;
+    alarm_armed[alarm_num]  = true;
+}
+
+void host_time_advance_to(uint64_t time_us) {
+    while (true) {
+        int next = -1;
+        for (int a = 0; a < NUM_ALARMS; a++) {
+            if (!alarm_armed[a] || alarm_target[a] > time_us) continue;
+            if (next < 0 || alarm_target[a] < alarm_target[next]) next = a;
+        }
+        if (next < 0) break;
+
+        alarm_armed[next] = false;
+        if (alarm_target[next] > now_us) now_us = alarm_target[next];
+        if (alarm_callback[next]) alarm_callback[next](next);
+    }
+    if (time_us > now_us) now_us = time_us;
+}
+
+void host_time_advance(uint64_t us) {
+    host_time_advance_to(now_us + us);
+}
+
+void host_set_write_cost(uint32_t ns) {
+    write_cost_ns = ns;
+}
+
+// ==================== PWM ====================
+
+void pwm_set_wrap(unsigned int slice_num, uint16_t wrap) {
+    reg_write(&pwm_hw->slice[slice_num].top, wrap);
+}
+
+// EN mirrors the enable bits of the slice CSRs
+static void update_en(void) {
+    uint32_t en = 0;
+    for (unsigned int s = 0; s < NUM_PWM_SLICES; s++) en |= (pwm_hw->slice[s].csr & 1u) << s;
+    pwm_hw->en = en;
+}
+
+void pwm_set_enabled(unsigned int slice_num, bool enabled) {
+    uint32_t csr = pwm_hw->slice[slice_num].csr;
+    reg_write(&pwm_hw->slice[slice_num].csr, enabled ? (csr | 1u) : (csr & ~1u));
+    update_en();
+}
+
+void pwm_set_mask_enabled(uint32_t mask) {
+    reg_write(&pwm_hw->en, mask);
+    for (unsigned int s = 0; s < NUM_PWM_SLICES; s++) {
+        uint32_t csr = pwm_hw->slice[s].csr;
+        pwm_hw->slice[s].csr = (mask & (1u << s)) ? (csr | 1u) : (csr & ~1u);
+    }
+}
+
+void pwm_set_counter(unsigned int slice_num, uint16_t c) {
+    reg_write(&pwm_hw->slice[slice_num].ctr, c);
+}
+
+void pwm_set_clkdiv(unsigned int slice_num, float divider) {
+    reg_write(&pwm_hw->slice[slice_num].div, (uint32_t)(divider * 16.0f));
+}
+
+void pwm_set_chan_level(unsigned int slice_num, unsigned int chan, uint16_t level) {
+    uint32_t shift = chan ? 16 : 0;
+    uint32_t cc    = pwm_hw->slice[slice_num].cc;
+    cc = (cc & ~(0xffffu << shift)) | ((uint32_t)level << shift);
+    reg_write(&pwm_hw->slice[slice_num].cc, cc);
+}
+
+void pwm_set_both_levels(unsigned int slice_num, uint16_t level_a, uint16_t level_b) {
+    reg_write(&pwm_hw->slice[slice_num].cc, ((uint32_t)level_b << 16) | level_a);
+}
+
+void pwm_set_gpio_level(unsigned int gpio, uint16_t level) {
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+// ==================== DMA ====================
+
+int dma_claim_unused_channel(bool required) {
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (dma_channel_claimed[ch]) continue;
+        dma_channel_claimed[ch] = true;
+        return ch;
+    }
+    if (required) panic("no DMA channels available");
+    return -1;
+}
+
+void dma_channel_unclaim(unsigned int channel) {
+    dma_channel_claimed[channel] = false;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel) {
+    return (dma_channel_config){
+        .read_increment  = true,
+        .write_increment = false,
+        .size            = DMA_SIZE_32,
+        .ring_bits       = 0,
+        .ring_write      = false,
+        .dreq            = DREQ_FORCE,
+        .chain_to        = channel,
+        .enable          = true,
+    };
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config * c, bool incr) {
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config * c, bool incr) {
+    c->write_increment = incr;
+}
+
+void channel_config_set_ring(dma_channel_config * c, bool write, unsigned int size_bits) {
+    c->ring_write = write;
+    c->ring_bits  = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config * c, unsigned int dreq) {
+    c->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config * c, unsigned int chain_to) {
+    c->chain_to = chain_to;
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config * config,
+                           volatile void * write_addr, const volatile void * read_addr,
+                           uint32_t transfer_count, bool trigger) {
+    dma_configs[channel]                 = *config;
+    dma_channels[channel].write_addr     = (uintptr_t)write_addr;
+    dma_channels[channel].read_addr      = (uintptr_t)read_addr;
+    dma_channels[channel].transfer_count = transfer_count;
+    dma_reload_count[channel]            = transfer_count;
+    dma_channel_busy[channel]            = false;
+    if (trigger) dma_trigger(channel, transfer_count);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask) {
+    for (unsigned int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (chan_mask & (1u << ch)) dma_trigger(ch, dma_reload_count[ch]);
+    }
+}
+
+void dma_channel_abort(unsigned int channel) {
+    dma_channel_busy[channel] = false;
+}
+
+bool dma_channel_is_busy(unsigned int channel) {
+    return dma_channel_busy[channel];
+}
+
+dma_channel_hw_t * dma_channel_hw_addr(unsigned int channel) {
+    return &dma_channels[channel];
+}
+
+int dma_claim_unused_timer(bool required) {
+    for (int t = 0; t < NUM_DMA_TIMERS; t++) {
+        if (dma_timer_claimed[t]) continue;
+        dma_timer_claimed[t] = true;
+        return t;
+    }
+    if (required) panic("no DMA timers available");
+    return -1;
+}
+
+void dma_timer_unclaim(unsigned int timer) {
+    dma_timer_claimed[timer] = false;
+}
+
+void dma_timer_set_fraction(unsigned int timer, uint16_t numerator, uint16_t denominator) {
+    dma_timer_num[timer] = numerator;
+    dma_timer_den[timer] = denominator;
+}
+
+void host_dma_timer_fraction(unsigned int timer, uint16_t * numerator, uint16_t * denominator) {
+    *numerator   = dma_timer_num[timer];
+    *denominator = dma_timer_den[timer];
+}
+
+static uintptr_t advance_addr(uintptr_t addr, uint32_t size, bool ring, unsigned int ring_bits) {
+    if (!ring || ring_bits == 0) return addr + size;
+    uintptr_t mask = ((uintptr_t)1 << ring_bits) - 1;
+    return (addr & ~mask) | ((addr + size) & mask);
+}
+
+static void dma_transfer(unsigned int channel) {
+    dma_channel_config * c  = &dma_configs[channel];
+    dma_channel_hw_t   * hw = &dma_channels[channel];
+
+    if (c->size != DMA_SIZE_32) panic("host DMA only supports 32 bit transfers");
+
+    uint32_t value = *(const volatile uint32_t *)hw->read_addr;
+    uintptr_t dest = hw->write_addr;
+
+    if (c->read_increment)  hw->read_addr  = advance_addr(hw->read_addr,  4, !c->ring_write, c->ring_bits);
+    if (c->write_increment) hw->write_addr = advance_addr(hw->write_addr, 4,  c->ring_write, c->ring_bits);
+
+    // A completed channel triggers the channel it is chained to, which may
+    // in turn re-trigger this one through the write below
+    bool done = --hw->transfer_count == 0;
+    if (done) dma_channel_busy[channel] = false;
+
+    reg_write((volatile uint32_t *)dest, value);
+
+    if (done && c->chain_to != channel) dma_trigger(c->chain_to, dma_reload_count[c->chain_to]);
+}
+
+// Start a channel. Unpaced channels run all their transfers at once.
+static void dma_trigger(unsigned int channel, uint32_t transfer_count) {
+    dma_channels[channel].transfer_count = transfer_count;
+    dma_channel_busy[channel]            = transfer_count > 0;
+
+    if (dma_configs[channel].dreq != DREQ_FORCE) return;
+    while (dma_channel_busy[channel]) dma_transfer(channel);
+}
+
+void host_dma_timer_tick(unsigned int timer) {
+    for (unsigned int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!dma_channel_busy[ch] || dma_configs[ch].dreq != dma_get_timer_dreq(timer)) continue;
+        dma_transfer(ch);
+    }
+}
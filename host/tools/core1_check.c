@@ -0,0 +1,97 @@
+/*
+ * Check the core 1 runtime.
+ *
+ * The runtime must start and stop cleanly, refuse a second start, and run
+ * a differential drive task loop on core 1 that picks up commands sent from
+ * core 0 through the command queue.
+ *
+ * Usage: core1_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pico/multicore.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "core1_runtime.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static volatile uint32_t counter;
+static volatile uint32_t task_core;
+
+static void count(void * ctx) {
+    counter = counter + 1;
+    task_core = get_core_num();
+}
+
+static void wait_loops(uint32_t loops) {
+    uint32_t start = core1_runtime_loops();
+    while (core1_runtime_loops() - start < loops);
+}
+
+int main(int argc, char ** argv) {
+    host_reset();
+    host_set_write_log(false);
+
+    int errors = 0;
+
+    // A plain task
+    errors += !core1_runtime_start(count, NULL);
+    errors += !core1_runtime_active();
+    errors += core1_runtime_start(count, NULL);
+    errors += !multicore_lockout_victim_is_initialized(1);
+    wait_loops(1000);
+    core1_runtime_stop();
+
+    errors += core1_runtime_active();
+    errors += task_core != 1;
+    if (counter != core1_runtime_loops()) {
+        fprintf(stderr, "task: %u calls, runtime counted %u\n", counter, core1_runtime_loops());
+        errors++;
+    }
+
+    // A differential drive driven from core 1
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+
+    host_set_pin_trace(true);
+    errors += !ddrive_start_core1(&ddrive);
+    errors += ddrive_start_timer(&ddrive);
+
+    ddrive_rpm(&ddrive, 60, -30);
+    while (ddrive.cmds.tail != ddrive.cmds.head);
+    wait_loops(100);
+
+    ddrive_stop_core1(&ddrive);
+    errors += ddrive.core1_active;
+
+    if (ddrive.rrpm != 60 || ddrive.lrpm != -30) {
+        fprintf(stderr, "ddrive: rpm %f %f, expected 60 -30\n", ddrive.rrpm, ddrive.lrpm);
+        errors++;
+    }
+
+    // Every loop steps both motors
+    size_t rchanges = 0;
+    size_t lchanges = 0;
+    for (size_t i = 0; i < host_pin_change_count(); i++) {
+        uint8_t gpio = host_pin_changes()[i].gpio;
+        rchanges += gpio >= rpins[0] && gpio <= rpins[3];
+        lchanges += gpio >= lpins[0] && gpio <= lpins[3];
+    }
+    if (!rchanges || !lchanges) {
+        fprintf(stderr, "ddrive: motors did not step\n");
+        errors++;
+    }
+
+    // Core 1 can be restarted
+    errors += !ddrive_start_core1(&ddrive);
+    ddrive_deinit(&ddrive);
+    errors += core1_runtime_active();
+
+    printf("core1: %llu us of stepping on core 1, %s\n", (unsigned long long)time_us_64(), errors ? "FAIL" : "ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
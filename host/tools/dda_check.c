@@ -0,0 +1,141 @@
+/*
+ * Check that the integer DDA emits exactly the commanded number of steps.
+ *
+ * For every axis, the emitted step count after `n` ticks must equal the
+ * commanded `(acc0 + n * rate) / major`, rounded down, for millions of
+ * ticks. The differential drive must distribute its steps the same way.
+ *
+ * Usage: dda_check [ticks]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "dda.h"
+#include "ddrive.h"
+
+#define AXES 4
+
+static int check_counts(const char * name, uint64_t tick, uint64_t commanded[AXES], uint64_t emitted[AXES], uint32_t major) {
+    int errors = 0;
+    for (int i = 0; i < AXES; i++) {
+        uint64_t expected = commanded[i] / major;
+        if (emitted[i] != expected && errors++ < 10) {
+            fprintf(stderr, "%s: axis %d after %llu ticks: %llu steps, expected %llu\n", name, i,
+                    (unsigned long long)tick, (unsigned long long)emitted[i], (unsigned long long)expected);
+        }
+    }
+    return errors;
+}
+
+static void tick(Dda * dda, uint64_t emitted[AXES]) {
+    uint32_t mask = dda_tick(dda);
+    for (int i = 0; i < AXES; i++) emitted[i] += (mask >> i) & 1;
+}
+
+static int check_constant(uint64_t ticks) {
+    const uint32_t rates[AXES] = {982451, 700001, 3, 982451 / 7};
+
+    Dda dda;
+    dda_init(&dda, AXES);
+    dda_set_rates(&dda, rates);
+
+    uint64_t commanded[AXES], emitted[AXES] = {0};
+    int errors = 0;
+
+    for (uint64_t n = 1; n <= ticks; n++) {
+        tick(&dda, emitted);
+        if (n % 1000003 && n != ticks) continue;
+
+        for (int i = 0; i < AXES; i++) commanded[i] = dda.major / 2 + n * rates[i];
+        errors += check_counts("constant", n, commanded, emitted, dda.major);
+    }
+
+    printf("constant rates: %llu ticks, %llu/%llu/%llu/%llu steps, %s\n", (unsigned long long)ticks,
+           (unsigned long long)emitted[0], (unsigned long long)emitted[1],
+           (unsigned long long)emitted[2], (unsigned long long)emitted[3], errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_changing(uint64_t ticks) {
+    const uint32_t major = 1000000;
+
+    Dda dda;
+    dda_init(&dda, AXES);
+
+    uint32_t rates[AXES] = {major, 0, 0, 0};
+    uint64_t commanded[AXES] = {0}, emitted[AXES] = {0};
+    int errors = 0;
+
+    srand(1);
+
+    for (uint64_t n = 0; n < ticks; n++) {
+        // New rates for the slower axes every few hundred ticks
+        if (n % 331 == 0) {
+            for (int i = 1; i < AXES; i++) rates[i] = rand() % (major + 1);
+            dda_set_rates(&dda, rates);
+            if (n == 0) for (int i = 0; i < AXES; i++) commanded[i] = major / 2;
+        }
+
+        tick(&dda, emitted);
+        for (int i = 0; i < AXES; i++) commanded[i] += rates[i];
+    }
+
+    errors += check_counts("changing", ticks, commanded, emitted, major);
+
+    printf("changing rates: %llu ticks, %llu/%llu/%llu/%llu steps, %s\n", (unsigned long long)ticks,
+           (unsigned long long)emitted[0], (unsigned long long)emitted[1],
+           (unsigned long long)emitted[2], (unsigned long long)emitted[3], errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_ddrive(float rrpm, float lrpm, int calls) {
+    static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+    static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    ddrive_rpm(&ddrive, rrpm, lrpm);
+
+    for (int i = 0; i < calls; i++) ddrive_task(&ddrive);
+
+    int64_t rsteps = llabs(ddrive.rstepper.position);
+    int64_t lsteps = llabs(ddrive.lstepper.position);
+
+    // The faster motor steps every tick. The other at the ratio of the rates,
+    // which are in milli-steps per second.
+    float steps_pr_rev = DEFAULT_DDRIVE_STEPS_PR_SEQ * STEPPER_SEQS_PER_REV;
+    uint64_t rrate = (uint32_t)(steps_pr_rev * fabsf(rrpm) / 60 * 1000);
+    uint64_t lrate = (uint32_t)(steps_pr_rev * fabsf(lrpm) / 60 * 1000);
+    uint64_t major = rrate > lrate ? rrate : lrate;
+    uint64_t ticks = rrate > lrate ? rsteps : lsteps;
+
+    int64_t rexpected = (major / 2 + ticks * rrate) / major;
+    int64_t lexpected = (major / 2 + ticks * lrate) / major;
+
+    int errors = rsteps != rexpected || lsteps != lexpected;
+
+    printf("ddrive %.1f/%.1f rpm: %lld/%lld steps, expected %lld/%lld, %s\n", rrpm, lrpm,
+           (long long)rsteps, (long long)lsteps, (long long)rexpected, (long long)lexpected,
+           errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    uint64_t ticks = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000000;
+
+    int errors = 0;
+    errors += check_constant(ticks);
+    errors += check_changing(ticks);
+    errors += check_ddrive(70.0f, 27.0f, 20000);
+    errors += check_ddrive(27.0f, 70.0f, 20000);
+    errors += check_ddrive(50.0f, 50.0f, 20000);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
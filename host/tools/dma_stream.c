@@ -0,0 +1,182 @@
+/*
+ * Check the register write stream of the DMA stepping backend.
+ *
+ * The compare values the DMA channels stream into the PWM slices are checked
+ * against the values `stepper_step` writes for the same steps. Streaming
+ * must continue when a channel runs out of transfers.
+ *
+ * Usage: dma_stream [steps_pr_seq] [--dump]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hardware/dma.h>
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "stepper.h"
+#include "stepper_dma.h"
+
+#define STEPS 200
+
+static int pins[STEPPER_PINS] = {0, 1, 2, 3};
+
+static bool dump = false;
+
+// Compare values of slice 0 and 1 after each `stepper_step` call
+static uint32_t expected[STEPS][2];
+
+static void record_reference(int steps_pr_seq, bool direction, int reverse_at, uint16_t level) {
+    Stepper stepper;
+    host_reset();
+    stepper_init(&stepper, pins, steps_pr_seq);
+
+    for (int i = 0; i < STEPS; i++) {
+        if (i == reverse_at) direction = !direction;
+        stepper_step(&stepper, direction, level);
+        expected[i][0] = pwm_hw->slice[0].cc;
+        expected[i][1] = pwm_hw->slice[1].cc;
+    }
+
+    stepper_deinit(&stepper);
+}
+
+static int check(const char * name, StepperDma * sd, int from, int to, size_t offset) {
+    const HostWrite * writes = host_writes();
+    uint repeat = sd->repeat;
+    int errors  = 0;
+
+    for (int i = from; i < to; i++) {
+        for (uint r = 0; r < repeat; r++) {
+            for (uint s = 0; s < sd->slice_count; s++) {
+                size_t idx = offset + ((i - from) * repeat + r) * sd->slice_count + s;
+                const HostWrite * w = &writes[idx];
+                uint slice = sd->slices[s];
+
+                if (dump) printf("%s step %d slice %u cc 0x%08x\n", name, i, slice, w->value);
+
+                if (w->reg != &pwm_hw->slice[slice].cc || w->value != expected[i][slice]) {
+                    if (errors++ < 10) {
+                        fprintf(stderr, "%s: step %d slice %u: got 0x%08x, expected 0x%08x\n",
+                                name, i, slice, w->value, expected[i][slice]);
+                    }
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+static void run(StepperDma * sd, int steps) {
+    for (int i = 0; i < steps * (int)sd->repeat; i++) host_dma_timer_tick(sd->timer);
+}
+
+static int check_speed(int steps_pr_seq, float steps_pr_sec) {
+    const uint16_t level = PWM_MAX;
+    const int half = STEPS / 2;
+
+    record_reference(steps_pr_seq, true, half, level);
+
+    host_reset();
+    Stepper stepper;
+    StepperDma sd;
+    stepper_init(&stepper, pins, steps_pr_seq);
+
+    if (!stepper_dma_init(&sd, &stepper)) {
+        fprintf(stderr, "failed to initialize DMA backend\n");
+        return 1;
+    }
+
+    stepper_dma_set_drive(&sd, true, level);
+
+    host_clear_writes();
+    stepper_dma_set_speed(&sd, steps_pr_sec);
+    run(&sd, half);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%.0f steps/s fwd", steps_pr_sec);
+    int errors = check(name, &sd, 0, half, 0);
+
+    // Reverse. Streaming must continue from the current phase.
+    stepper_dma_set_drive(&sd, false, level);
+    size_t offset = host_write_count();
+    run(&sd, STEPS - half);
+
+    snprintf(name, sizeof(name), "%.0f steps/s rev", steps_pr_sec);
+    errors += check(name, &sd, half, STEPS, offset);
+
+    uint16_t num, den;
+    host_dma_timer_fraction(sd.timer, &num, &den);
+    printf("%5.0f steps/s: repeat %3u, timer %5u/%5u, %s\n",
+           steps_pr_sec, sd.repeat, num, den, errors ? "FAIL" : "ok");
+
+    stepper_dma_deinit(&sd);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+// Let the channels run out of transfers mid stream. The control channels
+// must re-arm them without losing a step.
+static int check_rearm(int steps_pr_seq) {
+    const uint16_t level = PWM_MAX;
+
+    record_reference(steps_pr_seq, true, STEPS, level);
+
+    host_reset();
+    Stepper stepper;
+    StepperDma sd;
+    stepper_init(&stepper, pins, steps_pr_seq);
+
+    if (!stepper_dma_init(&sd, &stepper)) {
+        fprintf(stderr, "failed to initialize DMA backend\n");
+        return 1;
+    }
+
+    stepper_dma_set_drive(&sd, true, level);
+    stepper_dma_set_speed(&sd, 20000);
+
+    for (uint s = 0; s < sd.slice_count; s++) {
+        dma_channel_hw_addr(sd.chans[s])->transfer_count = 3;
+    }
+
+    int errors = 0;
+    for (int i = 0; i < STEPS; i++) {
+        run(&sd, 1);
+        for (uint s = 0; s < sd.slice_count; s++) {
+            uint slice = sd.slices[s];
+            if (pwm_hw->slice[slice].cc != expected[i][slice] && errors++ < 10) {
+                fprintf(stderr, "rearm: step %d slice %u: got 0x%08x, expected 0x%08x\n",
+                        i, slice, pwm_hw->slice[slice].cc, expected[i][slice]);
+            }
+        }
+    }
+
+    for (uint s = 0; s < sd.slice_count; s++) {
+        errors += !dma_channel_is_busy(sd.chans[s]);
+    }
+
+    printf("rearm: %d steps past the transfer count, %s\n", STEPS - 3, errors ? "FAIL" : "ok");
+
+    stepper_dma_deinit(&sd);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int steps_pr_seq = 16;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump") == 0) dump = true;
+        else steps_pr_seq = atoi(argv[i]);
+    }
+
+    int errors = 0;
+    errors += check_speed(steps_pr_seq, 20000);
+    errors += check_speed(steps_pr_seq, 1000);
+    errors += check_speed(steps_pr_seq, 60);
+    errors += check_rearm(steps_pr_seq);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
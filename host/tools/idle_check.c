@@ -0,0 +1,188 @@
+/*
+ * Check the idle state of the differential drive.
+ *
+ * Once both motors stop, `ddrive_task` must sleep until a command arrives
+ * instead of polling, and return at least every 10 ms. Stopped motors are
+ * released by default. With a holding level set they are held at their
+ * current step with that level until the release timeout, from the task
+ * loop and from the step timer. `ddrive_stop` releases them at once, and a
+ * command sent while idle is applied right away.
+ *
+ * Usage: idle_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/timer.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+// Calls of `ddrive_task` allowed per second of idling
+#define MAX_IDLE_CALLS 101
+
+static const uint16_t HOLD_LEVEL = PWM_MAX / 4;
+static const uint32_t RELEASE_MS = 200;
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static DiffDrive ddrive;
+
+static void start(bool timer) {
+    host_reset();
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    if (timer && !ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void run_until(uint64_t time_us, bool timer) {
+    if (timer) host_time_advance_to(time_us);
+    else while (time_us_64() < time_us) ddrive_task(&ddrive);
+}
+
+// The pins of a motor are at its current step with the given level
+static bool holds(Stepper * stepper, int * pins, uint16_t level) {
+    uint16_t levels[STEPPER_PINS] = {0};
+    stepper_levels(stepper, stepper->t, level, levels);
+
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        if (host_pin_level(pins[i]) != levels[i]) return false;
+    }
+    return true;
+}
+
+static bool released(void) {
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        if (host_pin_level(rpins[i]) || host_pin_level(lpins[i])) return false;
+    }
+    return true;
+}
+
+// Drive for a while and stop, returning the time the stop was applied
+static uint64_t drive_and_stop(bool timer) {
+    ddrive_rpm(&ddrive, 45, -30);
+    run_until(time_us_64() + 100000, timer);
+    ddrive_rpm(&ddrive, 0, 0);
+
+    // A call of the task applies the stop as it starts, then sleeps
+    uint64_t stopped;
+    do {
+        stopped = time_us_64();
+        run_until(stopped + 1, timer);
+    } while (ddrive.rrpm != 0 || ddrive.lrpm != 0);
+    return stopped;
+}
+
+static int check_sleep(void) {
+    start(false);
+    drive_and_stop(false);
+
+    int calls = 0;
+    uint64_t end = time_us_64() + 1000000;
+    while (time_us_64() < end) {
+        ddrive_task(&ddrive);
+        calls++;
+    }
+
+    int errors = calls > MAX_IDLE_CALLS || !released();
+
+    printf("sleep: %d task calls in 1 s of idling, coils %s, %s\n", calls,
+           released() ? "released" : "energized", errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static int check_hold(bool timer) {
+    start(timer);
+    ddrive_idle(&ddrive, HOLD_LEVEL, RELEASE_MS);
+
+    uint64_t stopped = drive_and_stop(timer);
+    uint32_t bound   = timer ? DDRIVE_CONTROL_US : DDRIVE_CMD_POLL_US;
+    uint64_t release = stopped + RELEASE_MS * 1000;
+    int errors = 0;
+
+    // Held once stopped, and the pins left alone until the release
+    run_until(stopped + bound, timer);
+    errors += !holds(&ddrive.rstepper, rpins, HOLD_LEVEL) || !holds(&ddrive.lstepper, lpins, HOLD_LEVEL);
+
+    host_clear_pin_changes();
+    host_set_pin_trace(true);
+    run_until(release + bound, timer);
+    host_set_pin_trace(false);
+    errors += !released();
+
+    const HostPinChange * changes = host_pin_changes();
+    for (size_t i = 0; i < host_pin_change_count(); i++) {
+        if ((changes[i].time_us < release || changes[i].level) && errors++ < 10) {
+            fprintf(stderr, "gpio %u changed to %u at %llu us, release at %llu us\n", changes[i].gpio,
+                    changes[i].level, (unsigned long long)changes[i].time_us, (unsigned long long)release);
+        }
+    }
+
+    printf("hold %s: held at level %u for %u ms, then %s, %s\n", timer ? "from the timer" : "from the task",
+           HOLD_LEVEL, RELEASE_MS, released() ? "released" : "energized", errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static void send_rpm(uint alarm) {
+    ddrive_rpm(&ddrive, 45, 45);
+}
+
+static int check_wake(void) {
+    start(false);
+    ddrive_idle(&ddrive, HOLD_LEVEL, 0);
+
+    int alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, send_rpm);
+
+    int errors = 0;
+    uint32_t worst = 0;
+
+    for (int i = 0; i < 20; i++) {
+        drive_and_stop(false);
+        ddrive_max_latency(&ddrive, true);
+
+        uint64_t at = time_us_64() + 1000 + rand() % 50000;
+        hardware_alarm_set_target(alarm, from_us_since_boot(at));
+
+        // Held without release until the command, which moves the motors
+        int64_t position = ddrive.rstepper.position;
+        run_until(at - 1, false);
+        errors += !holds(&ddrive.rstepper, rpins, HOLD_LEVEL);
+        run_until(at + 100000, false);
+        errors += ddrive.rstepper.position == position;
+
+        worst = MAX(worst, ddrive_max_latency(&ddrive, true));
+    }
+
+    // No holding from a stop, even if the motors move in between
+    ddrive_stop(&ddrive);
+    run_until(time_us_64() + 1, false);
+    errors += !released();
+    run_until(time_us_64() + 100000, false);
+    errors += !released();
+
+    errors += worst > DDRIVE_CMD_POLL_US;
+
+    printf("wake: worst latency %u us from idle, stop releases, %s\n", worst, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(void) {
+    srand(1);
+
+    int errors = 0;
+
+    errors += check_sleep();
+    errors += check_hold(false);
+    errors += check_hold(true);
+    errors += check_wake();
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
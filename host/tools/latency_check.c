@@ -0,0 +1,178 @@
+/*
+ * Check how fast the differential drive applies commands.
+ *
+ * Commands are sent from a hardware alarm, standing in for the other core,
+ * at random times while the drive steps from `ddrive_task`: setpoints at
+ * speeds where a step takes milliseconds, stops in the middle of moves, and
+ * stops at full speed. Every command must be applied within
+ * `DDRIVE_CMD_POLL_US`, as measured by the drive itself, and no steps may
+ * follow a stop. A new setpoint must keep the pending step's phase,
+ * with the next step one new period after the last one. The step timer must
+ * apply commands as they are sent, without waiting for its control period.
+ *
+ * Usage: latency_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+#include <hardware/timer.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+#define TRIALS 40
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static DiffDrive ddrive;
+
+// The command sent from the alarm
+static enum { SEND_RPM, SEND_STOP } send;
+static float send_rpm;
+static uint64_t sent_at;
+
+static void send_command(uint alarm) {
+    sent_at = time_us_64();
+    if (send == SEND_STOP) ddrive_stop(&ddrive);
+    else                   ddrive_rpm(&ddrive, send_rpm, -send_rpm / 2);
+}
+
+// Time of the first step write of the right motor after `since`, or zero
+static uint64_t step_after(uint64_t since) {
+    const HostWrite * writes = host_writes();
+    for (size_t i = 0; i < host_write_count(); i++) {
+        if (writes[i].reg == &pwm_hw->slice[0].cc && writes[i].time_us > since) return writes[i].time_us;
+    }
+    return 0;
+}
+
+// Time of the last step write of the right motor up to `until`, or zero
+static uint64_t step_before(uint64_t until) {
+    const HostWrite * writes = host_writes();
+    uint64_t time = 0;
+    for (size_t i = 0; i < host_write_count(); i++) {
+        if (writes[i].reg == &pwm_hw->slice[0].cc && writes[i].time_us <= until) time = writes[i].time_us;
+    }
+    return time;
+}
+
+static void run_until(uint64_t time_us, bool timer) {
+    if (timer) host_time_advance_to(time_us);
+    else while (time_us_64() < time_us) ddrive_task(&ddrive);
+}
+
+// Send a command at a random time and run until it should have been applied
+static uint32_t send_at_random(int alarm, bool timer) {
+    uint64_t at = time_us_64() + 1000 + rand() % 20000;
+    hardware_alarm_set_target(alarm, from_us_since_boot(at));
+    run_until(at + 2 * DDRIVE_CONTROL_US, timer);
+    return ddrive_max_latency(&ddrive, true);
+}
+
+static int check_setpoints(float rpm) {
+    host_reset();
+    host_set_write_log(false);
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+
+    int alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, send_command);
+
+    ddrive_rpm(&ddrive, rpm, -rpm / 2);
+    run_until(20000, false);
+    ddrive_max_latency(&ddrive, true);
+
+    int errors = 0;
+    uint32_t worst = 0;
+
+    for (int i = 0; i < TRIALS; i++) {
+        send     = SEND_RPM;
+        send_rpm = i % 2 ? rpm : rpm * 1.25f;
+
+        host_clear_writes();
+        host_set_write_log(true);
+
+        uint32_t latency = send_at_random(alarm, false);
+        worst = MAX(worst, latency);
+
+        // The first step after the command is one new period after the last
+        // step before it, unless that deadline had already passed
+        float steps_pr_sec = ddrive.rstepper.sequence.length * STEPPER_SEQS_PER_REV * send_rpm / 60;
+        uint64_t before    = step_before(sent_at);
+        uint64_t after     = step_after(sent_at);
+        uint64_t expected  = MAX(before + 1e6 / steps_pr_sec, sent_at + latency);
+
+        if (before && after && llabs((int64_t)(after - expected)) > 1 && errors++ < 10) {
+            fprintf(stderr, "%.1f rpm: step at %llu us after the command at %llu us, expected %llu us\n", send_rpm,
+                    (unsigned long long)after, (unsigned long long)sent_at, (unsigned long long)expected);
+        }
+        host_set_write_log(false);
+    }
+
+    errors += worst > DDRIVE_CMD_POLL_US;
+
+    printf("setpoints at %.1f rpm: worst latency %u us, %s\n", rpm, worst, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static int check_stops(bool timer, bool move) {
+    host_reset();
+    host_set_write_log(false);
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    if (timer && !ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        return 1;
+    }
+
+    int alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, send_command);
+
+    int errors = 0;
+    uint32_t worst = 0;
+
+    for (int i = 0; i < TRIALS; i++) {
+        if (move) ddrive_move(&ddrive, 50000, 20000, 30 + i * 5);
+        else      ddrive_rpm(&ddrive, 30 + i * 50, -20 - i * 20);
+        run_until(time_us_64() + 50000, timer);
+        ddrive_max_latency(&ddrive, true);
+
+        send = SEND_STOP;
+        uint32_t latency = send_at_random(alarm, timer);
+        worst = MAX(worst, latency);
+
+        // No more steps once the stop is applied
+        int64_t rposition = ddrive.rstepper.position;
+        int64_t lposition = ddrive.lstepper.position;
+        run_until(time_us_64() + 20000, timer);
+        if ((ddrive.rstepper.position != rposition || ddrive.lstepper.position != lposition) && errors++ < 10) {
+            fprintf(stderr, "steps after a stop at %llu us\n", (unsigned long long)sent_at);
+        }
+    }
+
+    errors += worst > DDRIVE_CMD_POLL_US;
+
+    printf("stops %s %s: worst latency %u us, %s\n", move ? "of moves" : "at speed", timer ? "from the timer" : "from the task",
+           worst, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(void) {
+    srand(1);
+
+    int errors = 0;
+
+    // Down to steps more than 10 ms apart
+    errors += check_setpoints(0.5f);
+    errors += check_setpoints(7.0f);
+    errors += check_setpoints(45.0f);
+    errors += check_stops(false, false);
+    errors += check_stops(false, true);
+    errors += check_stops(true, false);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
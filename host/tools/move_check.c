@@ -0,0 +1,216 @@
+/*
+ * Check position moves of a differential drive.
+ *
+ * A move must make exactly its steps on both motors, ramp within the
+ * acceleration limit from one step to the next, release the coils at the end
+ * and signal completion, also when it is replaced by another command. The
+ * step timer, which can not run moves, must reject them and keep the motors
+ * running.
+ *
+ * Usage: move_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static bool coils_released(void) {
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        if (host_pin_level(rpins[i]) || host_pin_level(lpins[i])) return false;
+    }
+    return true;
+}
+
+// Count the steps of a motor whose change of rate from the step before is
+// beyond the acceleration limit. Steps land on whole microseconds, so each
+// period is only known to within a microsecond either way.
+static int count_jerks(const int * pins, float accel) {
+    const HostWrite * writes = host_writes();
+    volatile uint32_t * cc = &pwm_hw->slice[pwm_gpio_to_slice_num(pins[0])].cc;
+
+    uint64_t times[3] = {0};
+    int count = 0;
+    int jerks = 0;
+
+    for (size_t i = 0; i < host_write_count(); i++) {
+        if (writes[i].reg != cc) continue;
+
+        times[0] = times[1];
+        times[1] = times[2];
+        times[2] = writes[i].time_us;
+
+        // The first period after the move started follows the velocity before it
+        if (++count < 4) continue;
+
+        double first  = times[1] - times[0];
+        double second = times[2] - times[1];
+
+        // Slowest and fastest rates the periods allow, in steps per second
+        double first_lo  = 1e6 / (first + 1),  first_hi  = 1e6 / MAX(first - 1, 1);
+        double second_lo = 1e6 / (second + 1), second_hi = 1e6 / MAX(second - 1, 1);
+
+        // Over one step the squared rate changes by at most twice the acceleration
+        double limit = 2 * accel * 1.05;
+        if (second_lo * second_lo - first_hi * first_hi > limit ||
+                first_lo * first_lo - second_hi * second_hi > limit) {
+            if (jerks++ < 5) {
+                fprintf(stderr, "move: step at %llu us after periods of %.0f and %.0f us\n",
+                        (unsigned long long)times[2], first, second);
+            }
+        }
+    }
+    return jerks;
+}
+
+static int check_move(int32_t rsteps, int32_t lsteps, float rpm, float start_rpm) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+
+    // Moves replace a running velocity
+    ddrive_rpm(&ddrive, start_rpm, start_rpm);
+    ddrive_task(&ddrive);
+
+    int64_t rstart = ddrive.rstepper.position;
+    int64_t lstart = ddrive.lstepper.position;
+    uint64_t start = time_us_64();
+
+    host_clear_writes();
+    host_set_write_log(true);
+    uint32_t id = ddrive_move(&ddrive, rsteps, lsteps, rpm);
+
+    int errors = 0;
+    int calls  = 0;
+    do {
+        ddrive_task(&ddrive);
+        calls++;
+    } while (!ddrive_move_done(&ddrive, id) && calls < 100000);
+    host_set_write_log(false);
+
+    double seconds = (time_us_64() - start) / 1e6;
+    int64_t rmoved = ddrive.rstepper.position - rstart;
+    int64_t lmoved = ddrive.lstepper.position - lstart;
+
+    if (rmoved != rsteps || lmoved != lsteps) {
+        fprintf(stderr, "move: %lld/%lld steps, expected %d/%d\n", (long long)rmoved, (long long)lmoved, rsteps, lsteps);
+        errors++;
+    }
+
+    // Steps of the motor moving the most, at the major axis acceleration
+    float steps_pr_rev = 128 * STEPPER_SEQS_PER_REV;
+    int jerks = count_jerks(abs(rsteps) >= abs(lsteps) ? rpins : lpins, DDRIVE_DEFAULT_ACCEL * steps_pr_rev / 60);
+    errors += jerks != 0;
+
+    // No faster than cruising all the way, no slower than the ramps allow
+    double length  = MAX(abs(rsteps), abs(lsteps)) / steps_pr_rev;
+    double cruise  = length / (rpm / 60);
+    double ramps   = rpm / DDRIVE_DEFAULT_ACCEL;
+    if (seconds < cruise || seconds > cruise + ramps + 0.05) {
+        fprintf(stderr, "move: %.3f s, expected %.3f to %.3f s\n", seconds, cruise, cruise + ramps);
+        errors++;
+    }
+
+    // The coils are released once the drive sees it has stopped
+    ddrive_task(&ddrive);
+    errors += !coils_released();
+    errors += ddrive.rstepper.position - rstart != rsteps;
+
+    printf("move %d/%d steps at %.0f rpm from %.0f rpm: %.3f s, %d steps over the acceleration limit, %s\n",
+           rsteps, lsteps, rpm, start_rpm, seconds, jerks, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static int check_completion(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+
+    int errors = 0;
+
+    // Done once handled when there is nothing to do
+    uint32_t empty = ddrive_move(&ddrive, 0, 0, 60);
+    errors += ddrive_move_done(&ddrive, empty);
+    ddrive_task(&ddrive);
+    errors += !ddrive_move_done(&ddrive, empty);
+
+    // Replaced by the next move, which still makes all of its steps
+    uint32_t first = ddrive_move(&ddrive, 20000, 20000, 60);
+    ddrive_task(&ddrive);
+    errors += ddrive_move_done(&ddrive, first);
+
+    int64_t rstart = ddrive.rstepper.position;
+    uint32_t second = ddrive_move(&ddrive, -1000, 500, 60);
+    ddrive_task(&ddrive);
+    errors += !ddrive_move_done(&ddrive, first);
+    while (!ddrive_move_done(&ddrive, second)) ddrive_task(&ddrive);
+    errors += ddrive.rstepper.position - rstart != -1000;
+
+    // Replaced by a velocity
+    uint32_t third = ddrive_move(&ddrive, 20000, 20000, 60);
+    ddrive_task(&ddrive);
+    ddrive_rpm(&ddrive, 30, 30);
+    errors += ddrive_move_done(&ddrive, third);
+    ddrive_task(&ddrive);
+    errors += !ddrive_move_done(&ddrive, third);
+
+    // A full queue refuses moves
+    while (ddrive_ready(&ddrive)) ddrive_try_rpm(&ddrive, 0, 0);
+    errors += ddrive_try_move(&ddrive, 100, 100, 60) != 0;
+
+    printf("completion: %s\n", errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static int check_timer(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+
+    if (!ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ddrive_rpm(&ddrive, 60, 60);
+    host_time_advance_to(time_us_64() + 100000);
+
+    uint32_t id     = ddrive_move(&ddrive, 20000, 20000, 60);
+    uint32_t try_id = ddrive_try_move(&ddrive, 20000, 20000, 60);
+    host_time_advance_to(time_us_64() + 2 * DDRIVE_CONTROL_US);
+
+    int errors = id || try_id || ddrive.rrpm != 60 || ddrive.lrpm != 60;
+
+    printf("timer: move %s, motors %s, %s\n", id || try_id ? "sent" : "rejected",
+           ddrive.rrpm != 60 || ddrive.lrpm != 60 ? "changed" : "running", errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = 0;
+
+    errors += check_move(3200, -3200, 60, 0);
+    errors += check_move(12800, 4000, 150, 0);
+    errors += check_move(-5000, -7000, 90, 200);
+    errors += check_move(7, 3, 60, 0);
+    errors += check_completion();
+    errors += check_timer();
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * Check coordinated stepping of four steppers with a multi stepper.
+ *
+ * A move must make exactly the requested steps on every axis and finish on
+ * the same tick for all of them. Velocities must keep the rate ratios of
+ * the axes. The steppers use all 8 PWM slices, which must be in phase.
+ *
+ * Usage: multi_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "multi_stepper.h"
+
+#define AXES 4
+
+static int pins[AXES][STEPPER_PINS] = {
+    {0, 1, 2, 3},
+    {4, 5, 6, 7},
+    {8, 9, 10, 11},
+    {12, 13, 14, 15},
+};
+
+static int check_positions(const char * what, MultiStepper * ms, const int32_t * expected, int32_t tolerance) {
+    int errors = 0;
+    for (uint axis = 0; axis < AXES; axis++) {
+        if (abs(ms->position[axis] - expected[axis]) <= tolerance) continue;
+        fprintf(stderr, "%s: axis %u at %d, expected %d\n", what, axis, ms->position[axis], expected[axis]);
+        errors++;
+    }
+    return errors;
+}
+
+// Time of the last level change of any pin of a stepper
+static uint64_t last_change(int stepper_pins[STEPPER_PINS]) {
+    uint64_t last = 0;
+    for (size_t i = 0; i < host_pin_change_count(); i++) {
+        const HostPinChange * c = &host_pin_changes()[i];
+        for (int p = 0; p < STEPPER_PINS; p++) {
+            if (c->gpio == stepper_pins[p]) last = MAX(last, c->time_us);
+        }
+    }
+    return last;
+}
+
+int main(int argc, char ** argv) {
+    host_reset();
+    host_set_write_log(false);
+
+    int errors = 0;
+
+    Stepper steppers[AXES];
+    Stepper * axes[AXES];
+    for (int i = 0; i < AXES; i++) {
+        for (uint s = 0; s < NUM_PWM_SLICES; s++) pwm_hw->slice[s].ctr = 100 + s;
+        stepper_init(&steppers[i], pins[i], 128);
+        axes[i] = &steppers[i];
+    }
+
+    MultiStepper ms;
+    if (!multi_stepper_init(&ms, axes, AXES)) {
+        fprintf(stderr, "multi stepper init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint s = 0; s < NUM_PWM_SLICES; s++) errors += pwm_hw->slice[s].ctr != 0;
+    errors += pwm_hw->en != 0xff;
+
+    // 400 ticks of 500 us
+    int32_t move[AXES] = {400, -300, 100, 0};
+    host_set_pin_trace(true);
+    uint64_t start = time_us_64();
+    multi_stepper_move(&ms, move, 2000, PWM_MAX);
+
+    host_time_advance(199999);
+    if (!multi_stepper_busy(&ms)) {
+        fprintf(stderr, "move: done early\n");
+        errors++;
+    }
+    host_time_advance(1);
+    if (multi_stepper_busy(&ms)) {
+        fprintf(stderr, "move: still busy after 200 ms\n");
+        errors++;
+    }
+    errors += check_positions("move", &ms, move, 0);
+
+    // The slower axes make their last step within their own step period
+    uint64_t end = start + 200000;
+    for (uint axis = 0; axis < 3; axis++) {
+        uint64_t period = 200000 / abs(move[axis]);
+        uint64_t last   = last_change(pins[axis]);
+        if (last + period < end || last > end) {
+            fprintf(stderr, "move: axis %u finished at %llu us, move ends at %llu us\n",
+                    axis, (unsigned long long)(last - start), (unsigned long long)(end - start));
+            errors++;
+        }
+    }
+    errors += last_change(pins[3]) != 0;
+
+    host_time_advance(10000);
+    errors += check_positions("after move", &ms, move, 0);
+
+    // Continuous rates for one second
+    float velocity[AXES] = {1000, -500, 250, 0};
+    multi_stepper_velocity(&ms, velocity, PWM_MAX);
+    host_time_advance(1000000);
+
+    int32_t expected[AXES];
+    for (uint axis = 0; axis < AXES; axis++) expected[axis] = move[axis] + velocity[axis];
+    errors += check_positions("velocity", &ms, expected, 1);
+
+    multi_stepper_stop(&ms);
+    errors += multi_stepper_busy(&ms);
+    host_time_advance(10000);
+    errors += check_positions("stopped", &ms, expected, 1);
+
+    multi_stepper_deinit(&ms);
+    for (int i = 0; i < AXES; i++) stepper_deinit(&steppers[i]);
+
+    printf("multi: %d axes, %s\n", AXES, errors ? "FAIL" : "ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
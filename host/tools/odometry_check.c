@@ -0,0 +1,195 @@
+/*
+ * Check the odometry of a differential drive.
+ *
+ * The pose must follow straight lines exactly, turn on the spot and drive
+ * circles like the exact solution, count steps at the finest resolution
+ * whatever sequence the motors use, and never be read half written from
+ * another core.
+ *
+ * Usage: odometry_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pico/multicore.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "odometry.h"
+#include "core1_runtime.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static const float STEP_LENGTH = 0.05f;
+static const float TRACK_WIDTH = 140.0f;
+
+static double pos(int64_t x) {
+    return (double)x / (1ull << ODOMETRY_POS_SHIFT);
+}
+
+static double theta(uint32_t theta) {
+    return (int32_t)theta * (M_PI / (1u << 31));
+}
+
+static double wrap(double angle) {
+    return remainder(angle, 2 * M_PI);
+}
+
+static int check_straight(void) {
+    Odometry odo;
+    odometry_init(&odo);
+    odometry_configure(&odo, STEP_LENGTH, TRACK_WIDTH);
+
+    for (int i = 1; i <= 1000; i++) odometry_update(&odo, 10 * i, 10 * i);
+
+    OdometryPose pose;
+    odometry_read(&odo, &pose);
+
+    int errors = pose.x != 10000 * odo.step_length || pose.y != 0 || pose.theta != 0;
+    printf("straight: x %.4f y %.4f, %s\n", pos(pose.x), pos(pose.y), errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_spin(void) {
+    Odometry odo;
+    odometry_init(&odo);
+    odometry_configure(&odo, STEP_LENGTH, TRACK_WIDTH);
+
+    int steps = 3000;
+    for (int i = 1; i <= steps; i++) odometry_update(&odo, i, -i);
+
+    OdometryPose pose;
+    odometry_read(&odo, &pose);
+
+    double expected = wrap(2.0 * steps * STEP_LENGTH / TRACK_WIDTH);
+    double error    = fabs(wrap(theta(pose.theta) - expected));
+
+    int errors = pose.x != 0 || pose.y != 0 || error > 1e-6;
+    printf("spin: theta %.6f, expected %.6f, %s\n", theta(pose.theta), expected, errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_circle(void) {
+    Odometry odo;
+    odometry_init(&odo);
+    odometry_configure(&odo, STEP_LENGTH, TRACK_WIDTH);
+
+    // The right wheel travels twice as far, a circle of 1.5 track widths
+    double radius  = 1.5 * TRACK_WIDTH;
+    double heading = 0;
+    double max_error = 0;
+
+    int64_t r = 0;
+    int64_t l = 0;
+    while (heading < 4 * M_PI) {
+        r += 4;
+        l += 2;
+        odometry_update(&odo, r, l);
+
+        OdometryPose pose;
+        odometry_read(&odo, &pose);
+
+        heading = (double)(r - l) * STEP_LENGTH / TRACK_WIDTH;
+        double x = radius * sin(heading);
+        double y = radius * (1 - cos(heading));
+
+        max_error = fmax(max_error, hypot(pos(pose.x) - x, pos(pose.y) - y));
+        max_error = fmax(max_error, fabs(wrap(theta(pose.theta) - heading)) * radius);
+    }
+
+    int errors = max_error > radius * 1e-4;
+    printf("circle: error %.6f over two turns of radius %.1f, %s\n", max_error, radius, errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_ddrive(float rrpm, float lrpm, bool timer) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+    if (timer) ddrive_start_timer(&ddrive);
+    ddrive_odometry(&ddrive, STEP_LENGTH * 128 * STEPPER_SEQS_PER_REV / (2 * M_PI), TRACK_WIDTH);
+    ddrive_rpm(&ddrive, rrpm, lrpm);
+
+    uint64_t start = time_us_64();
+    while (time_us_64() - start < 1000000) {
+        if (timer) host_time_advance(DDRIVE_CONTROL_US);
+        else       ddrive_task(&ddrive);
+    }
+    double seconds = (time_us_64() - start) / 1e6;
+
+    OdometryPose pose;
+    ddrive_pose(&ddrive, &pose);
+
+    int errors = 0;
+
+    // Finest steps, whatever the resolution in use
+    double rexpected = rrpm / 60 * STEPPER_SEQS_PER_REV * 128 * seconds;
+    double lexpected = lrpm / 60 * STEPPER_SEQS_PER_REV * 128 * seconds;
+    if (fabs(pose.rsteps - rexpected) > fabs(rexpected) * 0.01 + 128 ||
+        fabs(pose.lsteps - lexpected) > fabs(lexpected) * 0.01 + 128) {
+        fprintf(stderr, "ddrive: %lld/%lld steps, expected %.0f/%.0f\n",
+                (long long)pose.rsteps, (long long)pose.lsteps, rexpected, lexpected);
+        errors++;
+    }
+    errors += pose.rsteps != ddrive.rstepper.position || pose.lsteps != ddrive.lstepper.position;
+
+    // The heading follows the step counts of the snapshot
+    double heading = (double)(pose.rsteps - pose.lsteps) * STEP_LENGTH / TRACK_WIDTH;
+    if (fabs(wrap(theta(pose.theta) - heading)) > 1e-5) {
+        fprintf(stderr, "ddrive: theta %.6f, expected %.6f\n", theta(pose.theta), wrap(heading));
+        errors++;
+    }
+
+    printf("ddrive %s %.0f/%.0f rpm: %lld/%lld steps, %zu/%zu steps per sequence, %s\n",
+           timer ? "timer" : "task", rrpm, lrpm, (long long)pose.rsteps, (long long)pose.lsteps,
+           ddrive.rstepper.sequence.length, ddrive.lstepper.sequence.length, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+// Drive straight on core 1, where every snapshot has x matching the steps
+static Odometry shared;
+
+static void drive_straight(void * ctx) {
+    int64_t steps = shared.rlast + 1;
+    odometry_update(&shared, steps, steps);
+}
+
+static int check_snapshots(void) {
+    odometry_init(&shared);
+    odometry_configure(&shared, STEP_LENGTH, TRACK_WIDTH);
+
+    core1_runtime_start(drive_straight, NULL);
+
+    int torn = 0;
+    OdometryPose pose = {0};
+    for (int i = 0; i < 1000000 || pose.rsteps < 1000; i++) {
+        odometry_read(&shared, &pose);
+        torn += pose.rsteps != pose.lsteps || pose.x != pose.rsteps * shared.step_length;
+    }
+
+    core1_runtime_stop();
+
+    printf("snapshots: %d torn reads up to %lld steps, %s\n", torn, (long long)pose.rsteps, torn ? "FAIL" : "ok");
+    return torn != 0;
+}
+
+int main(int argc, char ** argv) {
+    int errors = 0;
+
+    errors += check_straight();
+    errors += check_spin();
+    errors += check_circle();
+    errors += check_ddrive(150, 130, false);
+    errors += check_ddrive(-200, 100, false);
+    errors += check_ddrive(60, 30, true);
+    errors += check_ddrive(600, -250, true);
+    errors += check_snapshots();
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+/*
+ * Check the lookahead planner.
+ *
+ * Every segment must make exactly its number of steps on each axis, the
+ * rate must never change faster than the acceleration limit allows, and
+ * collinear segments must run through their junctions without slowing down.
+ * A right angle corner must slow down to the jump rate. Segments waiting for
+ * room in the planner must not hold up a stop queued behind them, and the
+ * step timer, which has no planner, must reject and drop segments.
+ *
+ * Usage: planner_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "planner.h"
+#include "ddrive.h"
+
+#define ACCEL     20000.0f
+#define JUMP_RATE 200.0f
+#define MAX_SEGS  4
+
+typedef struct {
+    int32_t steps[MAX_SEGS][PLANNER_AXES];
+    float rate;
+    uint count;
+} Path;
+
+typedef struct {
+    int64_t steps[MAX_SEGS][PLANNER_AXES];
+    float junction_rate[MAX_SEGS];
+    float min_rate;
+    double time;
+} Run;
+
+static int run_path(const char * name, const Path * path, Run * run) {
+    Planner planner;
+    planner_init(&planner, ACCEL, JUMP_RATE);
+
+    for (uint i = 0; i < path->count; i++) planner_add(&planner, path->steps[i], path->rate);
+
+    *run = (Run){ .min_rate = INFINITY };
+    float last_rate = 0;
+    int errors = 0;
+
+    while (planner_active(&planner)) {
+        uint seg  = path->count - planner.count;
+        bool first = planner.done == 0;
+        float rate = planner_rate(&planner);
+
+        // Within a segment, v^2 may change by at most 2a per step
+        if (last_rate && !first && fabsf(rate * rate - last_rate * last_rate) > 2 * ACCEL * 1.01f + 1) {
+            if (errors++ < 10) fprintf(stderr, "%s: segment %u: rate %.1f -> %.1f\n", name, seg, last_rate, rate);
+        }
+        if (first) run->junction_rate[seg] = rate;
+
+        bool forward[PLANNER_AXES];
+        uint32_t mask = planner_step(&planner, forward);
+        for (int axis = 0; axis < PLANNER_AXES; axis++) {
+            if (mask & (1u << axis)) run->steps[seg][axis] += forward[axis] ? 1 : -1;
+        }
+
+        run->min_rate = MIN(run->min_rate, rate);
+        run->time    += 1.0 / rate;
+        last_rate     = rate;
+    }
+
+    for (uint i = 0; i < path->count; i++) {
+        for (int axis = 0; axis < PLANNER_AXES; axis++) {
+            if (run->steps[i][axis] != path->steps[i][axis] && errors++ < 10) {
+                fprintf(stderr, "%s: segment %u axis %d: %lld steps, expected %d\n", name, i, axis,
+                        (long long)run->steps[i][axis], path->steps[i][axis]);
+            }
+        }
+    }
+
+    return errors;
+}
+
+static int check_collinear(void) {
+    const Path path = {
+        .steps = {{3000, 1500}, {6000, 3000}, {1500, 750}},
+        .rate  = 5000,
+        .count = 3,
+    };
+
+    Run run;
+    int errors = run_path("collinear", &path, &run);
+
+    // The junctions are far from both ends, so the rate must be at cruise
+    for (uint i = 1; i < path.count; i++) {
+        if (run.junction_rate[i] < path.rate * 0.99f) {
+            fprintf(stderr, "collinear: slowed down to %.1f at junction %u\n", run.junction_rate[i], i);
+            errors++;
+        }
+    }
+
+    printf("collinear: %.3f s, junctions %.0f/%.0f steps/s, %s\n", run.time,
+           run.junction_rate[1], run.junction_rate[2], errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_corner(void) {
+    const Path path = {
+        .steps = {{4000, 0}, {0, -4000}},
+        .rate  = 5000,
+        .count = 2,
+    };
+
+    Run run;
+    int errors = run_path("corner", &path, &run);
+
+    // A jump from one axis to the other limits the junction to the jump rate
+    if (fabsf(run.junction_rate[1] - JUMP_RATE) > 1) {
+        fprintf(stderr, "corner: junction rate %.1f, expected %.1f\n", run.junction_rate[1], JUMP_RATE);
+        errors++;
+    }
+
+    printf("corner: %.3f s, junction %.0f steps/s, %s\n", run.time, run.junction_rate[1], errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_ddrive(void) {
+    static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+    static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    ddrive_accel(&ddrive, 300);
+    ddrive_segment(&ddrive, 1, 0.5, 60);
+    ddrive_segment(&ddrive, 1, 0.5, 60);
+    ddrive_segment(&ddrive, -0.5, 0.5, 30);
+
+    uint64_t start = time_us_64();
+    float max_rpm  = 0;
+    int errors     = 0;
+
+    do {
+        ddrive_task(&ddrive);
+        max_rpm = MAX(max_rpm, fabsf(ddrive.rrpm));
+    } while (planner_active(&ddrive.planner) && time_us_64() - start < 60000000);
+
+    double secs = (time_us_64() - start) / 1e6;
+
+    if (planner_active(&ddrive.planner) || ddrive.rrpm || ddrive.lrpm) {
+        fprintf(stderr, "ddrive: segments did not finish\n");
+        errors++;
+    }
+    if (max_rpm > 60 * 1.01f) {
+        fprintf(stderr, "ddrive: %.1f rpm exceeds the nominal 60 rpm\n", max_rpm);
+        errors++;
+    }
+
+    printf("ddrive: %.3f s, max %.1f rpm, %s\n", secs, max_rpm, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static bool queue_empty(DiffDrive * ddrive) {
+    return ddrive->cmds.head == ddrive->cmds.tail;
+}
+
+static int check_waiting(void) {
+    static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+    static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+
+    // Fill the planner, then queue segments waiting for it behind
+    for (int i = 0; i < PLANNER_QUEUE_LEN; i++) ddrive_try_segment(&ddrive, 10, 10, 60);
+    ddrive_task(&ddrive);
+    while (ddrive.cmds.head - ddrive.cmds.tail < DDRIVE_CMD_QUEUE_LEN - 1) ddrive_try_segment(&ddrive, 10, 10, 60);
+
+    ddrive_task(&ddrive);
+    int errors = queue_empty(&ddrive);
+
+    ddrive_max_latency(&ddrive, true);
+    errors += !ddrive_try_send(&ddrive, DDRIVE_CMD_STOP);
+    ddrive_task(&ddrive);
+    uint32_t stop_us = ddrive_max_latency(&ddrive, true);
+
+    errors += !queue_empty(&ddrive) || planner_active(&ddrive.planner) || ddrive.rrpm || ddrive.lrpm;
+    errors += stop_us > DDRIVE_CMD_POLL_US;
+    ddrive_deinit(&ddrive);
+
+    // Segments queued before the step timer started are dropped by it
+    host_reset();
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    for (int i = 0; i < 3; i++) ddrive_try_segment(&ddrive, 10, 10, 60);
+
+    if (!ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    errors += ddrive_segment(&ddrive, 1, 1, 60) || ddrive_try_segment(&ddrive, 1, 1, 60);
+
+    host_time_advance_to(time_us_64() + 2 * DDRIVE_CONTROL_US);
+    errors += !queue_empty(&ddrive) || planner_active(&ddrive.planner);
+
+    printf("waiting segments: stop applied after %u us, timer drops segments, %s\n",
+           stop_us, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = check_collinear() + check_corner() + check_ddrive() + check_waiting();
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
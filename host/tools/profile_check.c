@@ -0,0 +1,130 @@
+/*
+ * Check the jerk limited S-curve ramp.
+ *
+ * Without jerk phases the ramp must match the linear `Interp`. With them,
+ * the ramp must reach its end points exactly, never overshoot, and its rate
+ * of change must be continuous, changing by at most the jerk limit between
+ * ticks. The differential drive must finish S-curve ramps at their targets,
+ * from the task loop and from the step timer, and mark them done once
+ * finished or replaced.
+ *
+ * Usage: profile_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "scurve.h"
+#include "ddrive.h"
+
+#define TICKS 1000
+
+static int check_linear(void) {
+    const InterpCounter tend = 1234567;
+
+    Interp linear;
+    SCurve scurve;
+    interp_start(&linear, -30, 80, tend);
+    scurve_start(&scurve, -30, 80, tend, 0);
+
+    float max_error = 0;
+    do {
+        max_error = MAX(max_error, fabsf(interp_value(&linear) - scurve_value(&scurve)));
+        interp_tick(&linear, tend / TICKS);
+    } while (scurve_tick(&scurve, tend / TICKS));
+
+    int errors = max_error > 0.01f;
+    printf("linear: max difference %.5f, %s\n", max_error, errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_scurve(float start, float end, InterpCounter tend, InterpCounter tjerk) {
+    SCurve s;
+    scurve_start(&s, start, end, tend, tjerk);
+
+    const InterpCounter dt = tend / TICKS;
+    const float range      = end - start;
+    const float peak_rate  = range / (tend - s.tjerk);
+    const float jerk       = peak_rate / s.tjerk;
+
+    // A tick is rounded to the Q16 time resolution at both ends
+    const float tolerance  = 2.0f * tend / ((float)dt * SCURVE_ONE) + 0.005f;
+
+    float value = scurve_value(&s), last_rate = 0, max_rate = 0, max_jerk_error = 0;
+    int errors = value != start;
+
+    while (scurve_tick(&s, dt)) {
+        float next = scurve_value(&s);
+        float rate = (next - value) / dt;
+
+        float jerk_error = fabsf(rate - last_rate) - fabsf(jerk) * dt;
+        max_jerk_error   = MAX(max_jerk_error, jerk_error / fabsf(peak_rate));
+        max_rate         = MAX(max_rate, fabsf(rate));
+
+        if ((next - start) / range < -1e-4f || (next - start) / range > 1 + 1e-4f) errors++;
+
+        value     = next;
+        last_rate = rate;
+    }
+
+    errors += value != end;
+    errors += max_jerk_error > tolerance;
+    errors += fabsf(max_rate - fabsf(peak_rate)) > tolerance * fabsf(peak_rate);
+
+    printf("scurve %.0f -> %.0f, jerk %llu/%llu us: end %.3f, peak rate %.3g (%.3g), jerk error %.4f, %s\n",
+           start, end, (unsigned long long)s.tjerk, (unsigned long long)tend, value,
+           max_rate, fabsf(peak_rate), max_jerk_error, errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static int check_ddrive(bool timer) {
+    static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+    static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    if (timer && !ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        return 1;
+    }
+
+    uint32_t id = ddrive_scurve_rpm(&ddrive, 60, -40, 1.0, 0.3);
+    int errors  = ddrive_move_done(&ddrive, id);
+
+    uint64_t start = time_us_64();
+    while (!ddrive_move_done(&ddrive, id) && time_us_64() - start < 5000000) {
+        if (timer) host_time_advance(1000);
+        else       ddrive_task(&ddrive);
+    }
+
+    double secs = (time_us_64() - start) / 1e6;
+    float rrpm  = ddrive.rrpm, lrpm = ddrive.lrpm;
+    errors += !ddrive_move_done(&ddrive, id) || rrpm != 60 || lrpm != -40;
+
+    // A ramp replaced by another command is done too
+    uint32_t replaced = ddrive_trap_rpm(&ddrive, 0, 0, 10.0);
+    ddrive_rpm(&ddrive, 30, 30);
+    if (timer) host_time_advance(2 * DDRIVE_CONTROL_US);
+    else       ddrive_task(&ddrive);
+    errors += replaced == id || !ddrive_move_done(&ddrive, replaced) || ddrive.rrpm != 30;
+
+    printf("ddrive %s: %.1f/%.1f rpm after %.3f s, %s\n", timer ? "timer" : "task", rrpm, lrpm, secs,
+           errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = check_linear();
+    errors += check_scurve(0, 100, 1000000, 250000);
+    errors += check_scurve(80, -20, 700000, 350000);
+    errors += check_scurve(10, 500, 3000000, 100000);
+    errors += check_ddrive(false);
+    errors += check_ddrive(true);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/*
+ * Check the batched PWM writes of a stepper.
+ *
+ * A stepper on two full slices must update its coils with one CC store per
+ * slice, a stepper sharing a slice with another pin must leave that pin
+ * alone, and synced slices must be restarted in phase. A stepper with a
+ * level cache the size of its quarter wave must drive its pins like one
+ * without a cache.
+ *
+ * Usage: pwm_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "seq_registry.h"
+
+static int pins[STEPPER_PINS]   = {0, 1, 2, 3};
+static int split[STEPPER_PINS]  = {9, 4, 5, 6};
+static int lpins[STEPPER_PINS]  = {10, 11, 12, 13};
+
+// Count the recorded stores to CC registers
+static size_t cc_writes(void) {
+    size_t count = 0;
+    for (size_t i = 0; i < host_write_count(); i++) {
+        volatile uint32_t * reg = host_writes()[i].reg;
+        for (uint s = 0; s < NUM_PWM_SLICES; s++) count += reg == &pwm_hw->slice[s].cc;
+    }
+    return count;
+}
+
+// Compare the pin levels with the levels of the current step
+static int check_levels(const char * what, Stepper * stepper, uint16_t level) {
+    uint16_t levels[STEPPER_PINS];
+    stepper_levels(stepper, stepper->t, level, levels);
+
+    int errors = 0;
+    for (int i = 0; i < STEPPER_PINS; i++) errors += host_pin_level(stepper->pins[i]) != levels[i];
+    if (errors) fprintf(stderr, "%s: %d pins at the wrong level\n", what, errors);
+    return errors;
+}
+
+// Step a stepper with a level cache and one without side by side, at a
+// steady level that gets cached and at levels changing every few steps
+static int check_cache(void) {
+    host_reset();
+
+    PWMSequence seq = seq_registry_acquire(128, SEQ_WAVE_HALF_SINE);
+    seq_registry_acquire(128, SEQ_WAVE_HALF_SINE);
+
+    Stepper cached, plain;
+    stepper_init_with_seq(&cached, pins, seq);
+    stepper_init_with_seq(&plain, lpins, seq);
+
+    uint16_t * cache = malloc(sizeof(uint16_t) * stepper_level_cache_len(seq));
+    stepper_use_level_cache(&cached, cache);
+
+    int errors = stepper_level_cache_len(seq) != STEPPER_QUARTER_LEN(128);
+    int wrong  = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        uint16_t level = i < 500 ? PWM_MAX / 3 : PWM_MAX - (i / 4 % 16) * 1000;
+        bool forward   = i % 300 < 200;
+        stepper_step(&cached, forward, level);
+        stepper_step(&plain, forward, level);
+
+        for (int p = 0; p < STEPPER_PINS; p++) wrong += host_pin_level(pins[p]) != host_pin_level(lpins[p]);
+    }
+    if (wrong) fprintf(stderr, "cache: %d pins differ from the uncached stepper\n", wrong);
+    errors += wrong != 0;
+
+    printf("cache: %zu levels for %u steps, %s\n", stepper_level_cache_len(seq), (uint)seq.length,
+           errors ? "FAIL" : "ok");
+
+    stepper_deinit(&plain);
+    stepper_deinit(&cached);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    host_reset();
+
+    int errors = 0;
+
+    Stepper stepper;
+    stepper_init(&stepper, pins, 128);
+    errors += stepper.slice_count != 2;
+
+    host_clear_writes();
+    for (int i = 0; i < 100; i++) stepper_step(&stepper, true, PWM_MAX);
+    size_t writes = cc_writes();
+    if (writes != 200) {
+        fprintf(stderr, "two slices: %zu CC writes for 100 steps, expected 200\n", writes);
+        errors++;
+    }
+    errors += check_levels("two slices", &stepper, PWM_MAX);
+
+    // GPIO 8 shares slice 4 with GPIO 9 of the split stepper
+    gpio_set_function(8, GPIO_FUNC_PWM);
+    pwm_set_chan_level(4, PWM_CHAN_A, 1234);
+
+    Stepper other;
+    stepper_init(&other, split, 128);
+    errors += other.slice_count != 3;
+
+    for (int i = 0; i < 100; i++) stepper_step(&other, false, PWM_MIN);
+    errors += check_levels("split slices", &other, PWM_MIN);
+    if (host_pin_level(8) != 1234) {
+        fprintf(stderr, "split slices: GPIO 8 changed to %u\n", host_pin_level(8));
+        errors++;
+    }
+
+    // Restart the slices of a diff drive in phase
+    for (uint s = 0; s < NUM_PWM_SLICES; s++) pwm_hw->slice[s].ctr = 100 + s;
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, pins, 128);
+
+    uint32_t mask = stepper_slice_mask(&ddrive.lstepper) | stepper_slice_mask(&ddrive.rstepper);
+    errors += mask != 0x63;
+    for (uint s = 0; s < NUM_PWM_SLICES; s++) {
+        uint32_t expected = (mask & (1u << s)) ? 0 : 100 + s;
+        if (pwm_hw->slice[s].ctr != expected) {
+            fprintf(stderr, "sync: slice %u counter %u, expected %u\n", s, pwm_hw->slice[s].ctr, expected);
+            errors++;
+        }
+    }
+    if ((pwm_hw->en & mask) != mask) {
+        fprintf(stderr, "sync: slices %#x not enabled\n", mask & ~pwm_hw->en);
+        errors++;
+    }
+
+    ddrive_deinit(&ddrive);
+    stepper_deinit(&other);
+    stepper_deinit(&stepper);
+
+    errors += check_cache();
+
+    printf("pwm: %zu CC writes per 100 steps, %s\n", writes, errors ? "FAIL" : "ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ * Check the long-run step rates of the differential drive.
+ *
+ * Both wheels run at unrelated rpms across the whole speed range, from the
+ * task loop and from the step timer, while every register write costs CPU
+ * time on the virtual clock. After tens of thousands of steps, the steps
+ * made must match the commanded rates within 0.01%. Neither the truncation
+ * of periods to whole microseconds nor the time spent stepping may add up.
+ *
+ * Usage: rate_check [write_cost_ns]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+#define MIN_STEPS   20000
+#define MIN_SECONDS 20 // Coarser sequences make steps of several base steps
+#define MAX_ERROR   1e-4
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static uint32_t write_cost_ns = 1500;
+
+// Base steps per second of a wheel, counted at the finest resolution
+static double steps_pr_sec(float rpm) {
+    return (double)DEFAULT_DDRIVE_STEPS_PR_SEQ * STEPPER_SEQS_PER_REV * fabsf(rpm) / 60;
+}
+
+static int check_rate(bool timer, float rrpm, float lrpm) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    if (timer && !ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        return 1;
+    }
+
+    ddrive_rpm(&ddrive, rrpm, lrpm);
+
+    // Measure from the first step of each wheel, once the command is in
+    while (!ddrive.rstepper.position || !ddrive.lstepper.position) {
+        if (timer) host_time_advance(1);
+        else       ddrive_task(&ddrive);
+    }
+
+    host_set_write_cost(write_cost_ns);
+
+    uint64_t start = time_us_64();
+    int64_t rstart = ddrive.rstepper.position;
+    int64_t lstart = ddrive.lstepper.position;
+
+    double rrate = steps_pr_sec(rrpm);
+    double lrate = steps_pr_sec(lrpm);
+    uint64_t duration = ceil(fmax(MIN_STEPS / fmin(rrate, lrate), MIN_SECONDS) * 1e6);
+
+    if (timer) host_time_advance(duration);
+    else while (time_us_64() - start < duration) ddrive_task(&ddrive);
+
+    double secs = (time_us_64() - start) / 1e6;
+    double rerror = (llabs(ddrive.rstepper.position - rstart) - rrate * secs) / (rrate * secs);
+    double lerror = (llabs(ddrive.lstepper.position - lstart) - lrate * secs) / (lrate * secs);
+
+    int errors = fabs(rerror) > MAX_ERROR || fabs(lerror) > MAX_ERROR;
+
+    printf("%s %.2f/%.2f rpm: %+.4f%%/%+.4f%% over %.1f s, %s\n", timer ? "timer" : "task ", rrpm, lrpm,
+           rerror * 100, lerror * 100, secs, errors ? "FAIL" : "ok");
+
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    if (argc > 1) write_cost_ns = strtoul(argv[1], NULL, 10);
+
+    // From crawling to full steps at the highest step rate
+    const float rpms[] = {0.7f, 3.3f, 27.1f, 60.0f, 113.7f, 233.3f, 600.0f, 1450.0f};
+
+    int errors = 0;
+    for (size_t i = 0; i < sizeof(rpms) / sizeof(rpms[0]); i++) {
+        errors += check_rate(false, rpms[i], -0.61f * rpms[i]);
+        errors += check_rate(true,  rpms[i], -0.61f * rpms[i]);
+    }
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ * Check the shared PWM sequence registry.
+ *
+ * Common sequences must come from the constant tables, and their quarter
+ * waves, like the allocated compact sequences, must unfold to the same
+ * levels as fully generated sequences. Ten steppers with the same stepping mode must share one
+ * table, a differential drive must share one table between its steppers,
+ * and every allocated table must be freed exactly once when its last user
+ * is deinitialized.
+ *
+ * Usage: registry_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "seq_registry.h"
+#include "seq_tables.h"
+
+#define MOTORS 10
+
+// Steps per sequence without a constant table
+#define ODD_STEPS 100
+
+static int pins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static int expect(const char * what, uint count, uint expected) {
+    if (count == expected) return 0;
+    fprintf(stderr, "%s: %u sequences, expected %u\n", what, count, expected);
+    return 1;
+}
+
+// Compare a sequence with a freshly generated one
+static int check_table(const PWMSequence * table) {
+    PWMSequence seq = stepper_generate_seq(table->length, malloc(table->length * STEPPER_PINS * sizeof(float)));
+    stepper_seq_to_fixed(&seq, malloc(table->length * STEPPER_PINS * sizeof(StepperQ15)));
+
+    int errors = 0;
+    for (size_t t = 0; t < table->length; t++) {
+        StepperQ15 duty[STEPPER_PINS];
+        stepper_seq_duty(table, t, duty);
+        for (int i = 0; i < STEPPER_PINS; i++) {
+            if (abs((int)duty[i] - (int)seq.fixed[t * STEPPER_PINS + i]) > 1) errors++;
+        }
+    }
+    if (errors) fprintf(stderr, "table of %zu steps: %d mismatches\n", table->length, errors);
+
+    free((float *)seq.items);
+    free((StepperQ15 *)seq.fixed);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    host_reset();
+    host_set_write_log(false);
+
+    int errors = 0;
+
+    size_t table_bytes = 0;
+    for (size_t i = 0; i < seq_table_count; i++) {
+        errors += check_table(&seq_tables[i]);
+        table_bytes += STEPPER_QUARTER_LEN(seq_tables[i].length) * sizeof(StepperQ15);
+    }
+
+    // Common stepping modes are not allocated
+    Stepper flash;
+    stepper_init(&flash, pins, 128);
+    errors += expect("constant table", seq_registry_count(), 0);
+    errors += !seq_registry_release(flash.sequence);
+    stepper_deinit(&flash);
+
+    Stepper steppers[MOTORS];
+    for (int i = 0; i < MOTORS; i++) stepper_init(&steppers[i], pins, ODD_STEPS);
+
+    errors += expect("ten steppers", seq_registry_count(), 1);
+    errors += !steppers[0].sequence.quarter || check_table(&steppers[0].sequence);
+    for (int i = 1; i < MOTORS; i++) {
+        errors += stepper_seq_table(steppers[i].sequence) != stepper_seq_table(steppers[0].sequence);
+    }
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, pins, ODD_STEPS);
+    errors += stepper_seq_table(ddrive.rstepper.sequence) != stepper_seq_table(steppers[0].sequence);
+    errors += stepper_seq_table(ddrive.lstepper.sequence) != stepper_seq_table(steppers[0].sequence);
+
+    // Not a multiple of 4 steps, so not folded into a quarter wave
+    Stepper half;
+    stepper_init(&half, pins, ODD_STEPS / 2);
+    errors += expect("second stepping mode", seq_registry_count(), 2);
+    errors += !half.sequence.fixed || check_table(&half.sequence);
+
+    for (int i = 0; i < MOTORS; i++) stepper_deinit(&steppers[i]);
+    errors += expect("steppers deinitialized", seq_registry_count(), 2);
+
+    ddrive_deinit(&ddrive);
+    errors += expect("diff drive deinitialized", seq_registry_count(), 1);
+
+    stepper_deinit(&half);
+    errors += expect("all deinitialized", seq_registry_count(), 0);
+
+    // Sequences from elsewhere are not the registry's to free
+    float items[FULL_STEP * STEPPER_PINS];
+    errors += seq_registry_release(stepper_generate_seq(FULL_STEP, items));
+
+    printf("registry: %zu constant tables in %zu bytes, %d motors on one table, %s\n",
+           seq_table_count, table_bytes, MOTORS + 2, errors ? "FAIL" : "ok");
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
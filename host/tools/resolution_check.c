@@ -0,0 +1,171 @@
+/*
+ * Check speed dependent switching of the microstep resolution.
+ *
+ * Switching must keep the phase of the coils, switch with hysteresis, bound
+ * the step rate of a fast differential drive and keep its speed, both from
+ * the task loop and from the step timer.
+ *
+ * Usage: resolution_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+// Electrical phase of a stepper in sequences
+static float phase(Stepper * stepper) {
+    return (float)stepper->t / stepper->sequence.length;
+}
+
+// The coils must be driven at the levels of the current step
+static int check_pins(const char * what, Stepper * stepper, uint16_t level) {
+    uint16_t levels[STEPPER_PINS];
+    stepper_levels(stepper, stepper->t, level, levels);
+
+    int errors = 0;
+    for (int i = 0; i < STEPPER_PINS; i++) errors += host_pin_level(stepper->pins[i]) != levels[i];
+    if (errors) fprintf(stderr, "%s: coils not at the levels of step %d\n", what, stepper->t);
+    return errors;
+}
+
+static int check_switching(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    int errors = 0;
+
+    // Lengths of zero are skipped
+    static const uint ladder[] = {0, 32, 8, FULL_STEP};
+
+    Stepper stepper;
+    stepper_init(&stepper, rpins, 128);
+    errors += !stepper_use_resolutions(&stepper, ladder, 4);
+    errors += stepper.resolution_count != 4;
+
+    // A coarser sequence waits for a step on its grid
+    for (int i = 0; i < 5; i++) stepper_step(&stepper, true, PWM_MAX);
+    stepper_set_resolution(&stepper, 1);
+    errors += stepper.sequence.length != 128 || stepper.pending_resolution != 1;
+
+    for (int i = 0; i < 3; i++) stepper_step(&stepper, true, PWM_MAX);
+    if (stepper.sequence.length != 32 || stepper.t != 2) {
+        fprintf(stderr, "switch: step %d of %zu, expected step 2 of 32\n", stepper.t, stepper.sequence.length);
+        errors++;
+    }
+    errors += check_pins("coarser", &stepper, PWM_MAX);
+
+    // A finer one is switched to right away, at the same phase
+    float before = phase(&stepper);
+    stepper_set_resolution(&stepper, 0);
+    errors += stepper.sequence.length != 128 || phase(&stepper) != before;
+    stepper_step(&stepper, false, PWM_MAX);
+    errors += check_pins("finer", &stepper, PWM_MAX);
+
+    // Hysteresis between 128 and 32 steps per sequence
+    float up   = STEPPER_MAX_STEP_RATE / 128;
+    float down = STEPPER_MAX_STEP_RATE * STEPPER_RESOLUTION_HYSTERESIS / 128;
+
+    while (stepper.t % 4) stepper_step(&stepper, true, PWM_MAX);
+    stepper_update_resolution(&stepper, up * 0.99f);
+    errors += stepper.resolution != 0;
+    stepper_update_resolution(&stepper, up * 1.01f);
+    errors += stepper.resolution != 1;
+    stepper_update_resolution(&stepper, down * 1.01f);
+    errors += stepper.resolution != 1;
+    stepper_update_resolution(&stepper, down * 0.99f);
+    errors += stepper.resolution != 0;
+
+    // Very fast goes all the way to full steps
+    stepper_update_resolution(&stepper, STEPPER_MAX_STEP_RATE);
+    for (int i = 0; i < 128; i++) stepper_step(&stepper, true, PWM_MAX);
+    errors += stepper.sequence.length != FULL_STEP;
+
+    stepper_deinit(&stepper);
+
+    printf("switching: %s\n", errors ? "FAIL" : "ok");
+    return errors;
+}
+
+// Count the steps of a stepper in the write log, one CC write per slice
+static size_t steps_written(Stepper * stepper) {
+    size_t writes = 0;
+    for (size_t i = 0; i < host_write_count(); i++) {
+        for (uint k = 0; k < stepper->slice_count; k++) {
+            writes += host_writes()[i].reg == &pwm_hw->slice[stepper->slices[k].slice].cc;
+        }
+    }
+    host_clear_writes();
+    return writes / stepper->slice_count;
+}
+
+static int check_ddrive(float rpm, bool timer) {
+    host_reset();
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+    if (timer) ddrive_start_timer(&ddrive);
+    ddrive_rpm(&ddrive, rpm, rpm / 2);
+
+    // Settle on a resolution
+    host_set_write_log(false);
+    uint64_t start = time_us_64();
+    while (time_us_64() - start < 200000) {
+        if (timer) host_time_advance(DDRIVE_CONTROL_US);
+        else       ddrive_task(&ddrive);
+    }
+
+    // Count the steps of the right motor over a second
+    host_set_write_log(true);
+    host_clear_writes();
+
+    start = time_us_64();
+    double sequences = 0;
+    size_t steps     = 0;
+    while (time_us_64() - start < 1000000) {
+        if (timer) host_time_advance(DDRIVE_CONTROL_US);
+        else       ddrive_task(&ddrive);
+
+        size_t written = steps_written(&ddrive.rstepper);
+        sequences += (double)written / ddrive.rstepper.sequence.length;
+        steps     += written;
+    }
+
+    double seconds  = (time_us_64() - start) / 1e6;
+    double expected = rpm / 60 * STEPPER_SEQS_PER_REV * seconds;
+    double rate     = steps / seconds;
+
+    int errors = 0;
+    if (fabs(sequences - expected) > expected * 0.01) {
+        fprintf(stderr, "ddrive: %.1f sequences, expected %.1f\n", sequences, expected);
+        errors++;
+    }
+    if (rate > STEPPER_MAX_STEP_RATE) {
+        fprintf(stderr, "ddrive: %.0f steps per second\n", rate);
+        errors++;
+    }
+
+    printf("ddrive %s %.0f rpm: %zu steps per sequence, %.0f steps/s, %s\n", timer ? "timer" : "task",
+           rpm, ddrive.rstepper.sequence.length, rate, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = 0;
+
+    errors += check_switching();
+    errors += check_ddrive(200, false);
+    errors += check_ddrive(600, false);
+    errors += check_ddrive(200, true);
+    errors += check_ddrive(600, true);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
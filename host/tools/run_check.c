@@ -0,0 +1,220 @@
+/*
+ * Check runs of a given number of steps and step profiles of the step timer.
+ *
+ * A run must make exactly its steps, each on its deadline, and then stop
+ * with the coils energized. A profile must step after each of its periods in
+ * the direction of its sign. The steps left must count down while running,
+ * and stopping must cancel a run.
+ *
+ * Usage: run_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "step_timer.h"
+
+#define PROFILE_STEPS 400
+
+static int pins[STEPPER_PINS] = {0, 1, 2, 3};
+
+// Times of the step writes to the first slice of the stepper
+static size_t step_times(uint64_t * times, size_t max) {
+    const HostWrite * writes = host_writes();
+    size_t count = 0;
+
+    for (size_t i = 0; i < host_write_count(); i++) {
+        if (writes[i].reg != &pwm_hw->slice[0].cc) continue;
+
+        // Each step writes both pins of the slice
+        if (i > 0 && writes[i - 1].reg == writes[i].reg) continue;
+
+        if (count < max) times[count] = writes[i].time_us;
+        count++;
+    }
+    return count;
+}
+
+// Compare step times against the expected ones
+static int check_times(const char * name, const uint64_t * times, const uint64_t * expected, size_t count) {
+    int errors = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (times[i] != expected[i] && errors++ < 10) {
+            fprintf(stderr, "%s: step %zu at %llu us, expected %llu us\n", name, i,
+                    (unsigned long long)times[i], (unsigned long long)expected[i]);
+        }
+    }
+    return errors;
+}
+
+static int check_run(int32_t steps, uint32_t period_us) {
+    static uint64_t times[2000], expected[2000];
+
+    host_reset();
+
+    Stepper stepper;
+    stepper_init(&stepper, pins, 16);
+
+    StepTimer timer;
+    if (!step_timer_init(&timer)) {
+        fprintf(stderr, "failed to claim alarm\n");
+        return 1;
+    }
+    int ch = step_timer_add(&timer, &stepper);
+    step_timer_start(&timer);
+
+    host_clear_writes();
+    uint64_t start = time_us_64();
+    step_timer_run(&timer, ch, steps, period_us, PWM_MAX);
+
+    uint32_t count = abs(steps);
+    int errors = 0;
+
+    // Halfway through, half the steps are left
+    host_time_advance(count / 2 * period_us + period_us / 2);
+    uint32_t remaining = step_timer_remaining(&timer, ch);
+    if (remaining != count - count / 2) {
+        fprintf(stderr, "run %d: %u steps left halfway, expected %u\n", steps, remaining, count - count / 2);
+        errors++;
+    }
+
+    // Well past the end of the run
+    host_time_advance((count + 10) * period_us);
+
+    size_t stepped = step_times(times, 2000);
+    for (size_t i = 0; i < count; i++) expected[i] = start + (i + 1) * period_us;
+    errors += check_times("run", times, expected, MIN(stepped, count));
+
+    if (stepped != count || stepper.position != steps || step_timer_remaining(&timer, ch)) {
+        fprintf(stderr, "run %d: %zu steps to position %lld, %u left\n", steps, stepped,
+                (long long)stepper.position, step_timer_remaining(&timer, ch));
+        errors++;
+    }
+
+    // The coils are left energized
+    bool energized = false;
+    for (int i = 0; i < STEPPER_PINS; i++) energized |= host_pin_level(pins[i]) != 0;
+    errors += !energized;
+
+    printf("run %d steps every %u us: %zu steps on their deadlines, %s\n", steps, period_us, stepped,
+           errors ? "FAIL" : "ok");
+
+    step_timer_deinit(&timer);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+static int check_profile(void) {
+    static int32_t periods[PROFILE_STEPS];
+    static uint64_t times[PROFILE_STEPS + 10], expected[PROFILE_STEPS];
+
+    // Accelerate forward, then reverse and slow down
+    int64_t target = 0;
+    for (int i = 0; i < PROFILE_STEPS; i++) {
+        int32_t period = i < PROFILE_STEPS / 2 ? 2000 - 9 * i : 300 + 7 * (i - PROFILE_STEPS / 2);
+        periods[i] = i < PROFILE_STEPS * 3 / 4 ? period : -period;
+        target += periods[i] > 0 ? 1 : -1;
+    }
+
+    host_reset();
+
+    Stepper stepper;
+    stepper_init(&stepper, pins, 16);
+
+    StepTimer timer;
+    if (!step_timer_init(&timer)) {
+        fprintf(stderr, "failed to claim alarm\n");
+        return 1;
+    }
+    int ch = step_timer_add(&timer, &stepper);
+    step_timer_start(&timer);
+
+    host_clear_writes();
+    uint64_t start = time_us_64();
+    step_timer_run_profile(&timer, ch, periods, PROFILE_STEPS, PWM_MAX);
+
+    uint64_t t = start;
+    for (int i = 0; i < PROFILE_STEPS; i++) {
+        t += abs(periods[i]);
+        expected[i] = t;
+    }
+
+    int errors = 0;
+
+    // The steps left count down with the profile
+    uint32_t last = PROFILE_STEPS;
+    for (int i = 0; i < PROFILE_STEPS; i += 50) {
+        host_time_advance_to(expected[i] + 1);
+        uint32_t remaining = step_timer_remaining(&timer, ch);
+        if (remaining != PROFILE_STEPS - i - 1 || remaining > last) {
+            fprintf(stderr, "profile: %u steps left after step %d\n", remaining, i);
+            errors++;
+        }
+        last = remaining;
+    }
+
+    host_time_advance_to(t + 10000);
+
+    size_t stepped = step_times(times, PROFILE_STEPS + 10);
+    errors += check_times("profile", times, expected, MIN(stepped, PROFILE_STEPS));
+
+    if (stepped != PROFILE_STEPS || stepper.position != target || step_timer_remaining(&timer, ch)) {
+        fprintf(stderr, "profile: %zu steps to position %lld, expected %d to %lld\n", stepped,
+                (long long)stepper.position, PROFILE_STEPS, (long long)target);
+        errors++;
+    }
+
+    printf("profile of %d steps: %zu steps to position %lld, %s\n", PROFILE_STEPS, stepped,
+           (long long)stepper.position, errors ? "FAIL" : "ok");
+
+    step_timer_deinit(&timer);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+static int check_stop(void) {
+    const uint32_t period_us = 500;
+
+    host_reset();
+
+    Stepper stepper;
+    stepper_init(&stepper, pins, 16);
+
+    StepTimer timer;
+    if (!step_timer_init(&timer)) {
+        fprintf(stderr, "failed to claim alarm\n");
+        return 1;
+    }
+    int ch = step_timer_add(&timer, &stepper);
+    step_timer_start(&timer);
+
+    step_timer_run(&timer, ch, 1000, period_us, PWM_MAX);
+    host_time_advance(100 * period_us + period_us / 2);
+    step_timer_set(&timer, ch, 0, true, 0);
+
+    host_clear_writes();
+    host_time_advance(1000 * period_us);
+
+    size_t stepped = step_times(NULL, 0);
+    int errors = stepped || stepper.position != 100 || step_timer_remaining(&timer, ch);
+
+    printf("stop: run cancelled at position %lld, %zu steps after, %s\n", (long long)stepper.position,
+           stepped, errors ? "FAIL" : "ok");
+
+    step_timer_deinit(&timer);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+int main(void) {
+    int errors = 0;
+    errors += check_run(1000, 347);
+    errors += check_run(-333, 1000);
+    errors += check_run(1, 50);
+    errors += check_profile();
+    errors += check_stop();
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
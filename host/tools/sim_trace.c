@@ -0,0 +1,120 @@
+/*
+ * Run stepperlib on the virtual clock and dump the pin trace.
+ *
+ * Every change of the PWM level of a stepper pin is written as a
+ * `time_us gpio level` line, so motion can be plotted, profiled and diffed
+ * against a previous run without a PICO. The right stepper (and the single
+ * stepper) uses GPIO 0-3, the left stepper GPIO 4-7.
+ *
+ * Usage: sim_trace [-o FILE] stepper STEPS_PR_SEQ US_PR_STEP COUNT
+ *        sim_trace [-o FILE] ddrive RRPM LRPM SECONDS
+ *        sim_trace [-o FILE] ddrive-timer RRPM LRPM SECONDS
+ *        sim_trace [-o FILE] scurve RRPM LRPM SECONDS JERK_SECONDS
+ *
+ * The trace is written to `trace.txt` by default, or stdout for `-o -`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static int usage(void) {
+    fprintf(stderr,
+            "usage: sim_trace [-o FILE] stepper STEPS_PR_SEQ US_PR_STEP COUNT\n"
+            "       sim_trace [-o FILE] ddrive RRPM LRPM SECONDS\n"
+            "       sim_trace [-o FILE] ddrive-timer RRPM LRPM SECONDS\n"
+            "       sim_trace [-o FILE] scurve RRPM LRPM SECONDS JERK_SECONDS\n");
+    return EXIT_FAILURE;
+}
+
+static void run_stepper(int steps_pr_seq, int us_pr_step, int count) {
+    Stepper stepper;
+    stepper_init(&stepper, rpins, steps_pr_seq);
+
+    for (int i = 0; i < count; i++) {
+        stepper_step(&stepper, true, PWM_MAX);
+        sleep_us(us_pr_step);
+    }
+
+    stepper_stop(&stepper);
+    stepper_deinit(&stepper);
+}
+
+static void run_ddrive(float rrpm, float lrpm, float secs, bool timer) {
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    ddrive_rpm(&ddrive, rrpm, lrpm);
+
+    uint64_t end = time_us_64() + secs * 1e6;
+
+    if (timer) {
+        ddrive_start_timer(&ddrive);
+        host_time_advance_to(end);
+        ddrive_stop_timer(&ddrive);
+    } else {
+        while (time_us_64() < end) ddrive_task(&ddrive);
+    }
+
+    ddrive_stop(&ddrive);
+    ddrive_task(&ddrive);
+    ddrive_deinit(&ddrive);
+}
+
+static void run_scurve(float rrpm, float lrpm, float secs, float jerk) {
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+
+    uint32_t id = ddrive_scurve_rpm(&ddrive, rrpm, lrpm, secs, jerk);
+    while (!ddrive_move_done(&ddrive, id)) ddrive_task(&ddrive);
+
+    ddrive_stop(&ddrive);
+    ddrive_task(&ddrive);
+    ddrive_deinit(&ddrive);
+}
+
+int main(int argc, char ** argv) {
+    const char * path = "trace.txt";
+
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        path  = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2) return usage();
+
+    host_reset();
+    host_set_write_log(false);
+    host_set_pin_trace(true);
+
+    const char * mode = argv[1];
+
+    if (strcmp(mode, "stepper") == 0 && argc == 5) {
+        run_stepper(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+    } else if (strcmp(mode, "ddrive") == 0 && argc == 5) {
+        run_ddrive(atof(argv[2]), atof(argv[3]), atof(argv[4]), false);
+    } else if (strcmp(mode, "ddrive-timer") == 0 && argc == 5) {
+        run_ddrive(atof(argv[2]), atof(argv[3]), atof(argv[4]), true);
+    } else if (strcmp(mode, "scurve") == 0 && argc == 6) {
+        run_scurve(atof(argv[2]), atof(argv[3]), atof(argv[4]), atof(argv[5]));
+    } else {
+        return usage();
+    }
+
+    FILE * file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    host_write_pin_trace(file);
+    if (file != stdout) fclose(file);
+
+    fprintf(stderr, "%zu pin changes over %llu us\n", host_pin_change_count(), (unsigned long long)time_us_64());
+    return EXIT_SUCCESS;
+}
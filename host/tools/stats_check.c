@@ -0,0 +1,107 @@
+/*
+ * Check the step timing instrumentation.
+ *
+ * Steps of the interrupt driven step timer land on their deadlines, so they
+ * must be recorded without error. Steps made by hand with a late step must
+ * count a missed deadline in the right histogram bin. The differential
+ * drive task loop must report the DDA jitter of the slower wheel around a
+ * mean error close to zero.
+ *
+ * Usage: stats_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "step_timer.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+static float mean_error(const StepStats * stats) {
+    return stats->periods ? (float)stats->sum_error_us / stats->periods : 0;
+}
+
+static void print_stats(const char * name, const StepStats * stats, int errors) {
+    printf("%s: %lu periods, error %ld..%ld us, mean %.2f us, %lu missed, %s\n", name,
+           (unsigned long)stats->periods, (long)stats->min_error_us, (long)stats->max_error_us,
+           mean_error(stats), (unsigned long)stats->missed, errors ? "FAIL" : "ok");
+}
+
+static int check_timer(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    Stepper stepper;
+    stepper_init(&stepper, rpins, 32);
+
+    StepTimer timer;
+    step_timer_init(&timer);
+    step_timer_add(&timer, &stepper);
+    step_timer_set(&timer, 0, 473, true, PWM_MAX);
+    step_timer_start(&timer);
+
+    host_time_advance(1000000);
+    step_timer_deinit(&timer);
+
+    const StepStats * stats = &stepper.stats;
+    int errors = stats->periods < 2000 || stats->min_error_us || stats->max_error_us || stats->missed;
+
+    print_stats("step timer", stats, errors);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+static int check_late(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    Stepper stepper;
+    stepper_init(&stepper, rpins, 32);
+    STEP_STATS_EXPECT(&stepper, 1000);
+
+    const uint32_t gaps[] = {0, 1000, 1000, 2600, 1000, 900};
+    for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++) {
+        sleep_us(gaps[i]);
+        stepper_step(&stepper, true, PWM_MAX);
+    }
+
+    const StepStats * stats = &stepper.stats;
+    int errors = stats->periods != 5 || stats->missed != 1 || stats->max_error_us != 1600
+              || stats->min_error_us != -100 || stats->histogram[step_stats_bin(1600)] != 1
+              || stats->histogram[0] != 3;
+
+    print_stats("late step", stats, errors);
+    stepper_deinit(&stepper);
+    return errors;
+}
+
+static int check_ddrive(void) {
+    host_reset();
+    host_set_write_log(false);
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+    ddrive_rpm(&ddrive, 60, -25);
+
+    while (time_us_64() < 2000000) ddrive_task(&ddrive);
+
+    const StepStats * fast = &ddrive.rstepper.stats;
+    const StepStats * slow = &ddrive.lstepper.stats;
+
+    int fast_errors = abs(fast->min_error_us) > 1 || abs(fast->max_error_us) > 1 || fast->missed;
+    int slow_errors = fabsf(mean_error(slow)) > 1 || slow->missed;
+
+    print_stats("ddrive fast wheel", fast, fast_errors);
+    print_stats("ddrive slow wheel", slow, slow_errors);
+    ddrive_deinit(&ddrive);
+    return fast_errors + slow_errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = check_timer() + check_late() + check_ddrive();
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*
+ * Run the stepperlib microbenchmarks on the host.
+ *
+ * Prints the cost of every benchmarked path per sequence length, and writes
+ * the full report as JSON for tracking regressions.
+ *
+ * The host has an FPU, so the float numbers are optimistic compared to the
+ * RP2040, where every float multiply and conversion is a software routine.
+ * Run `stepper.bench()` on a PICO for cycle counts.
+ *
+ * Usage: step_bench [-o FILE] [calls]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_sdk.h"
+#include "bench.h"
+
+int main(int argc, char ** argv) {
+    const char * path = "bench.json";
+
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        path  = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    long calls = argc > 1 ? atol(argv[1]) : 1000000;
+
+    host_reset();
+    host_set_write_log(false);
+
+    static BenchReport report;
+    bench_run(&report, calls);
+
+    printf("%-24s %6s %12s %12s\n", "name", "seq", "ns", "cycles");
+    for (uint i = 0; i < report.result_count; i++) {
+        const BenchResult * r = &report.results[i];
+        printf("%-24s %6u %12.2f %12.1f\n", r->name, r->steps_pr_seq, r->ns, r->cycles);
+    }
+
+    printf("\n%6s %16s %16s\n", "seq", "1 motor steps/s", "2 motors steps/s");
+    for (uint i = 0; i < report.rate_count; i++) {
+        const BenchRate * r = &report.rates[i];
+        printf("%6u %16.0f %16.0f\n", r->steps_pr_seq, r->one_motor, r->two_motors);
+    }
+
+    size_t len = bench_format_json(&report, NULL, 0) + 1;
+    char * json = malloc(len);
+    bench_format_json(&report, json, len);
+
+    FILE * file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    fputs(json, file);
+    fclose(file);
+    free(json);
+
+    return EXIT_SUCCESS;
+}
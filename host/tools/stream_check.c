@@ -0,0 +1,172 @@
+/*
+ * Check streaming of rpm setpoints to a differential drive.
+ *
+ * Every sample must be played at its time, from the task loop and from the
+ * step timer, running seamlessly from one buffer into the next. Buffers must
+ * be read in place and handed back once played, the motors must stop when
+ * the stream runs dry, and commands must only take over from buffers
+ * streamed before them.
+ *
+ * Usage: stream_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+#define SAMPLES 100
+#define DT_US   2000
+
+static int16_t bufs[2][2 * SAMPLES];
+
+// Right setpoint of sample `i` of the whole stream, in rpm. The left motor
+// runs backwards at 90% of it.
+static float right_rpm(uint i) {
+    return 20 + i * 0.5f;
+}
+
+static void fill(void) {
+    for (uint b = 0; b < 2; b++) {
+        for (uint i = 0; i < SAMPLES; i++) {
+            float rpm = right_rpm(b * SAMPLES + i);
+            bufs[b][2 * i]     = rpm * DDRIVE_STREAM_RPM_SCALE;
+            bufs[b][2 * i + 1] = -rpm * 0.9f * DDRIVE_STREAM_RPM_SCALE;
+        }
+    }
+}
+
+static void update(DiffDrive * ddrive, bool timer) {
+    if (timer) host_time_advance(DDRIVE_CONTROL_US);
+    else       ddrive_task(ddrive);
+}
+
+static int check_playback(bool timer) {
+    host_reset();
+    host_set_write_log(false);
+    fill();
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+    if (timer) ddrive_start_timer(&ddrive);
+
+    int errors = 0;
+
+    errors += !ddrive_stream(&ddrive, bufs[0], SAMPLES, DT_US);
+    errors += !ddrive_stream(&ddrive, bufs[1], SAMPLES, DT_US);
+    errors += ddrive_stream(&ddrive, bufs[0], SAMPLES, DT_US);
+    errors += ddrive_stream_free(&ddrive) != 0;
+
+    // Read in place, so a change before playing is picked up
+    bufs[1][2 * 10] = 7 * DDRIVE_STREAM_RPM_SCALE;
+
+    // The stream starts with the first update. The step timer makes one as
+    // the stream is sent.
+    uint64_t start    = time_us_64();
+    uint64_t end      = start + 2 * SAMPLES * DT_US;
+    int64_t rposition = ddrive.rstepper.position;
+    double rexpected  = 0;
+
+    int wrong     = 0;
+    int late      = 0;
+    uint64_t last = time_us_64();
+    bool handed_back = false;
+
+    while (time_us_64() < end) {
+        // The task loop picks up the setpoints at its start
+        uint64_t now = timer ? time_us_64() + DDRIVE_CONTROL_US : time_us_64();
+        update(&ddrive, timer);
+
+        uint sample    = (now - start) / DT_US;
+        float expected = sample == SAMPLES + 10 ? 7 : right_rpm(sample);
+        if (now < end && ddrive.rrpm != expected) {
+            if (wrong++ < 5) fprintf(stderr, "sample %u: %.2f rpm, expected %.2f\n", sample, ddrive.rrpm, expected);
+        }
+
+        // Task loops end within a step after the next sample
+        uint64_t next = start + (uint64_t)(sample + 1) * DT_US;
+        if (!timer && now < end && time_us_64() > next + 300) late++;
+
+        if (sample >= SAMPLES && ddrive_stream_free(&ddrive) == 1) handed_back = true;
+
+        rexpected += (double)ddrive.rrpm / 60 * STEPPER_SEQS_PER_REV * 128 * (time_us_64() - last) / 1e6;
+        last = time_us_64();
+    }
+
+    // Runs dry and stops
+    update(&ddrive, timer);
+    update(&ddrive, timer);
+    errors += ddrive.rrpm != 0 || ddrive.lrpm != 0;
+    errors += ddrive_stream_free(&ddrive) != DDRIVE_STREAM_BUFS;
+    errors += !handed_back;
+
+    int64_t rsteps = ddrive.rstepper.position - rposition;
+    if (fabs(rsteps - rexpected) > rexpected * 0.02) {
+        fprintf(stderr, "steps: %lld, expected %.0f\n", (long long)rsteps, rexpected);
+        errors++;
+    }
+
+    errors += wrong != 0;
+    errors += late != 0;
+    printf("playback %s: %d wrong samples, %d late loops, %lld steps, %s\n", timer ? "timer" : "task",
+           wrong, late, (long long)rsteps, errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+static int check_commands(void) {
+    host_reset();
+    host_set_write_log(false);
+    fill();
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, 128);
+
+    int errors = 0;
+
+    // A command sent before the stream does not drop it
+    ddrive_rpm(&ddrive, 10, 10);
+    ddrive_stream(&ddrive, bufs[0], SAMPLES, DT_US);
+    ddrive_task(&ddrive);
+    errors += ddrive.rrpm != right_rpm(0);
+
+    // One sent after it takes over
+    ddrive_rpm(&ddrive, 30, 30);
+    ddrive_task(&ddrive);
+    errors += ddrive.rrpm != 30;
+    errors += ddrive_stream_free(&ddrive) != DDRIVE_STREAM_BUFS;
+
+    // Settings leave it playing
+    ddrive_stream(&ddrive, bufs[0], SAMPLES, DT_US);
+    ddrive_accel(&ddrive, 300);
+    ddrive_task(&ddrive);
+    errors += ddrive.rrpm != right_rpm(0);
+
+    // Streams take over from moves
+    uint32_t id = ddrive_move(&ddrive, 100000, 100000, 60);
+    ddrive_task(&ddrive);
+    errors += ddrive_move_done(&ddrive, id);
+    ddrive_stream(&ddrive, bufs[1], SAMPLES, DT_US);
+    ddrive_task(&ddrive);
+    errors += !ddrive_move_done(&ddrive, id);
+    errors += ddrive.rrpm != right_rpm(SAMPLES);
+
+    printf("commands: %s\n", errors ? "FAIL" : "ok");
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(int argc, char ** argv) {
+    int errors = 0;
+
+    errors += check_playback(false);
+    errors += check_playback(true);
+    errors += check_commands();
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*
+ * Check the deadlines kept by the interrupt driven step timer.
+ *
+ * Two steppers with unrelated periods are stepped from one hardware alarm on
+ * the virtual clock. Every step must land exactly on its deadline. The
+ * differential drive is then run from the step timer and must step both
+ * wheels at their commanded rates.
+ *
+ * Usage: timer_check
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hardware/pwm.h>
+
+#include "host_sdk.h"
+#include "ddrive.h"
+#include "step_timer.h"
+
+static int apins[STEPPER_PINS] = {0, 1, 2, 3};
+static int bpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+// Count step writes to the first slice of a stepper and check their times
+static int check_deadlines(const char * name, uint slice, uint64_t start, uint32_t period_us, size_t * count) {
+    const HostWrite * writes = host_writes();
+    int errors = 0;
+    *count = 0;
+
+    for (size_t i = 0; i < host_write_count(); i++) {
+        if (writes[i].reg != &pwm_hw->slice[slice].cc) continue;
+
+        // Each step writes both pins of the slice
+        if (i > 0 && writes[i - 1].reg == writes[i].reg) continue;
+
+        uint64_t expected = start + (*count + 1) * period_us;
+        if (writes[i].time_us != expected && errors++ < 10) {
+            fprintf(stderr, "%s: step %zu at %llu us, expected %llu us\n", name, *count,
+                    (unsigned long long)writes[i].time_us, (unsigned long long)expected);
+        }
+        (*count)++;
+    }
+    return errors;
+}
+
+static int check_two_steppers(void) {
+    const uint64_t duration = 1000000;
+    const uint32_t aperiod  = 300;
+    const uint32_t bperiod  = 473;
+
+    host_reset();
+
+    Stepper a, b;
+    stepper_init(&a, apins, 16);
+    stepper_init(&b, bpins, 16);
+
+    StepTimer timer;
+    if (!step_timer_init(&timer)) {
+        fprintf(stderr, "failed to claim alarm\n");
+        return 1;
+    }
+
+    int ach = step_timer_add(&timer, &a);
+    int bch = step_timer_add(&timer, &b);
+    step_timer_set(&timer, ach, aperiod, true,  PWM_MAX);
+    step_timer_set(&timer, bch, bperiod, false, PWM_MAX);
+
+    host_clear_writes();
+    step_timer_start(&timer);
+    host_time_advance(duration);
+    step_timer_stop(&timer);
+
+    size_t acount, bcount;
+    int errors = check_deadlines("a", 0, 0, aperiod, &acount)
+               + check_deadlines("b", 2, 0, bperiod, &bcount);
+
+    if (acount != duration / aperiod || bcount != duration / bperiod) {
+        fprintf(stderr, "step counts %zu and %zu, expected %llu and %llu\n", acount, bcount,
+                (unsigned long long)(duration / aperiod), (unsigned long long)(duration / bperiod));
+        errors++;
+    }
+
+    printf("step timer: %zu and %zu steps on their deadlines, %s\n", acount, bcount, errors ? "FAIL" : "ok");
+
+    step_timer_deinit(&timer);
+    stepper_deinit(&a);
+    stepper_deinit(&b);
+    return errors;
+}
+
+static int check_ddrive(void) {
+    const float rrpm = 60;
+    const float lrpm = -25;
+
+    host_reset();
+
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, bpins, apins, DEFAULT_DDRIVE_STEPS_PR_SEQ);
+
+    if (!ddrive_start_timer(&ddrive)) {
+        fprintf(stderr, "failed to start ddrive timer\n");
+        return 1;
+    }
+
+    ddrive_rpm(&ddrive, rrpm, lrpm);
+
+    // Let the command be picked up by the control interrupt
+    host_time_advance(DDRIVE_CONTROL_US);
+    int rt = ddrive.rstepper.t, lt = ddrive.lstepper.t;
+    int rsteps = 0, lsteps = 0;
+
+    const int seconds = 2;
+    for (int ms = 0; ms < seconds * 1000; ms++) {
+        host_time_advance(1000);
+
+        int len = DEFAULT_DDRIVE_STEPS_PR_SEQ;
+        rsteps += ((ddrive.rstepper.t - rt) % len + len + len / 2) % len - len / 2;
+        lsteps += ((ddrive.lstepper.t - lt) % len + len + len / 2) % len - len / 2;
+        rt = ddrive.rstepper.t;
+        lt = ddrive.lstepper.t;
+    }
+
+    ddrive_stop_timer(&ddrive);
+
+    float steps_pr_rev = DEFAULT_DDRIVE_STEPS_PR_SEQ * STEPPER_SEQS_PER_REV;
+    float rmeasured = rsteps / steps_pr_rev * 60 / seconds;
+    float lmeasured = lsteps / steps_pr_rev * 60 / seconds;
+
+    // Periods are whole microseconds, allow for the truncation
+    int errors = fabsf(rmeasured - rrpm) > 0.01f * fabsf(rrpm)
+              || fabsf(lmeasured - lrpm) > 0.01f * fabsf(lrpm);
+
+    printf("ddrive timer: %.2f/%.2f rpm commanded, %.2f/%.2f rpm stepped, %s\n",
+           rrpm, lrpm, rmeasured, lmeasured, errors ? "FAIL" : "ok");
+
+    ddrive_deinit(&ddrive);
+    return errors;
+}
+
+int main(void) {
+    int errors = 0;
+    errors += check_two_steppers();
+    errors += check_ddrive();
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,13 +1,100 @@
+from array import array
+
 class Stepper:
     def __init__(self, pins: list[int], steps: int) -> None: ...
     def step(self, direction: bool, level: float) -> int: ...
+    def spin(self, direction: bool, level: float, period_us: int) -> None: ...
+    def run(self, steps: int, period_us: int, level: float = 1.0, block: bool = True) -> None:
+        """Make `steps` steps, backward if negative, one every `period_us`. Stops with the coils energized."""
+        ...
+    def run_profile(self, periods_us: array, level: float = 1.0, block: bool = True) -> None:
+        """Make a step after each period of an `array('i')`, backward for negative periods. Read in place."""
+        ...
+    def remaining(self) -> int: ...
+    def busy(self) -> bool: ...
     def stop(self) -> None: ...
+    def stats(self, reset: bool = False) -> dict:
+        """Only available in firmware built with `./build.py --stats`."""
+        ...
     def __del__(self) -> None: ...
 
+class Motion:
+    """Handle of a move or ramp. Done once it has finished or was replaced by another command."""
+    def done(self) -> bool: ...
+    def wait(self) -> None: ...
+    def __await__(self):
+        """Sleep the awaiting `asyncio` task until done. One task at a time may await a motion."""
+        ...
+
 class DiffDrive:
     def __init__(self, rpins: list[int], lpins: list[int], steps: int) -> None: ...
     def task_loop(self) -> None: ...
+    def start(self) -> None: ...
+    def start_core1(self) -> None:
+        """Run the task loop in C on core 1. Do not use `_thread` at the same time."""
+        ...
+    def stop_core1(self) -> None: ...
     def stop(self) -> None: ...
     def set_rpm(self, rrpm: float, lrpm: float) -> None: ...
     def set_trans_rot(self, trans: float, rot: float) -> None: ...
+    def try_set_rpm(self, rrpm: float, lrpm: float) -> bool: ...
+    def try_set_trans_rot(self, trans: float, rot: float) -> bool: ...
+    def add_segment(self, rrev: float, lrev: float, rpm: float) -> None: ...
+    def move(self, rsteps: int, lsteps: int, rpm: float) -> Motion:
+        """Move each motor its steps with acceleration, the one moving the most at `rpm`. Run by `task_loop`."""
+        ...
+    def try_move(self, rsteps: int, lsteps: int, rpm: float) -> Motion | None: ...
+    def ramp_rpm(self, rrpm: float, lrpm: float, time: float, jerk: float = 0.0) -> Motion:
+        """Ramp to the rpms over `time` seconds, with `jerk` seconds of S-curve at each end."""
+        ...
+    def ramp_trans_rot(self, trans: float, rot: float, time: float, jerk: float = 0.0) -> Motion: ...
+    def moving(self) -> bool:
+        """True until the last move or ramp has finished or was replaced by another command."""
+        ...
+    def stream(self, buf: array | memoryview, dt_us: int) -> None:
+        """Queue (right, left) rpm setpoints in 1/16 rpm, each lasting `dt_us`. Read in place, double buffered."""
+        ...
+    def stream_free(self) -> int:
+        """Number of buffers that can be streamed. Refill a buffer once it has been handed back."""
+        ...
+    def set_accel(self, rpm_per_s: float) -> None: ...
+    def set_idle(self, hold: float, release_ms: int = 0) -> None:
+        """Hold stopped motors at `hold` power (0.0 to 1.0), releasing them after `release_ms`. 0 never releases."""
+        ...
+    def set_odometry(self, wheel_radius: float, track_width: float) -> None:
+        """Start integrating the pose from the origin. Both lengths in the same unit."""
+        ...
+    def pose(self) -> tuple[float, float, float]:
+        """(x, y, theta) in the unit of `set_odometry` and radians, counter-clockwise."""
+        ...
+    def steps(self) -> tuple[int, int]:
+        """Signed steps of the (right, left) wheels since the drive was created."""
+        ...
+    def latency(self, reset: bool = False) -> int:
+        """Longest time in µs from sending a command until the stepping applied it."""
+        ...
+    def stats(self, reset: bool = False) -> dict:
+        """Stats of the `right` and `left` motor. Only with `./build.py --stats`."""
+        ...
     def __del__(self) -> None: ...
+
+class MultiStepper:
+    def __init__(self, steppers: list[Stepper]) -> None:
+        """Coordinated stepping of up to 4 steppers from one step timer."""
+        ...
+    def set_velocity(self, steps_per_sec: list[float], level: float = 1.0) -> None: ...
+    def move(self, steps: list[int], steps_per_sec: float, level: float = 1.0) -> None:
+        """Move every axis its steps, the one moving the most at `steps_per_sec`. All axes finish together."""
+        ...
+    def busy(self) -> bool: ...
+    def positions(self) -> list[int]: ...
+    def stop(self) -> None: ...
+    def __del__(self) -> None: ...
+
+def sync(*motors: Stepper | DiffDrive) -> None:
+    """Restart the PWM slices of the motors in phase, so their steps take effect on the same PWM wrap."""
+    ...
+
+def bench(calls: int = 10000) -> str:
+    """Only available in firmware built with `./build.py --bench`."""
+    ...
@@ -7,6 +7,8 @@
 
 #include "py/obj.h"
 #include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mperrno.h"
 
 #include "ddrive.h"
 
@@ -17,6 +19,7 @@
 typedef struct _mp_obj_DiffDrive_t {
     mp_obj_base_t base; // For MicroPython object system
     DiffDrive ddrive;
+    mp_obj_t stream_bufs[DDRIVE_STREAM_BUFS]; // Keeps streamed buffers alive while they are read
 } mp_obj_DiffDrive;
 
 static mp_obj_t DiffDrive_make_new(const mp_obj_type_t *type,
@@ -57,21 +60,47 @@ static mp_obj_t DiffDrive_make_new(const mp_obj_type_t *type,
     }
 
     size_t steps = mp_obj_get_int(steps_obj);
-    float * buf = m_new(float, steps* STEPPER_PINS);
-    PWMSequence seq = stepper_generate_seq(steps, buf);
 
-    mp_obj_DiffDrive *self = mp_obj_malloc(mp_obj_DiffDrive, type);
+    // The finaliser releases the sequence when the object is collected
+    mp_obj_DiffDrive *self = mp_obj_malloc_with_finaliser(mp_obj_DiffDrive, type);
+    self->ddrive = (DiffDrive){0};
+    for (size_t i = 0; i < DDRIVE_STREAM_BUFS; i++) self->stream_bufs[i] = mp_const_none;
+
+    // One reference for each stepper
+    PWMSequence seq = seq_registry_acquire(steps, SEQ_WAVE_HALF_SINE);
+    if (!seq.length) {
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Failed to allocate the PWM sequence"));
+    }
+    if (!seq_registry_acquire(steps, SEQ_WAVE_HALF_SINE).length) {
+        seq_registry_release(seq);
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Failed to allocate the PWM sequence"));
+    }
 
     ddrive_init_with_seq(&self->ddrive, rpins, lpins, seq);
 
+    stepper_use_level_cache(&self->ddrive.rstepper, m_new(uint16_t, stepper_level_cache_len(seq)));
+    stepper_use_level_cache(&self->ddrive.lstepper, m_new(uint16_t, stepper_level_cache_len(seq)));
+
     return MP_OBJ_FROM_PTR(self);
 }
 
 static mp_obj_t DiffDrive_deinit(mp_obj_t self_in) {
     mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
 
-    Stepper_deinit(&self->ddrive.rstepper);
-    Stepper_deinit(&self->ddrive.lstepper);
+    ddrive_stop_core1(&self->ddrive);
+    ddrive_stop_timer(&self->ddrive);
+
+    // The steppers are embedded in the diff drive, not `Stepper` objects.
+    // Their pins and level caches live on the GC heap and are collected with
+    // this object. The shared sequence is released once for each.
+    Stepper * steppers[] = { &self->ddrive.rstepper, &self->ddrive.lstepper };
+    for (size_t i = 0; i < 2; i++) {
+        if (!steppers[i]->sequence.length) continue;
+        stepper_stop(steppers[i]);
+        stepper_release_resolutions(steppers[i]);
+        seq_registry_release(steppers[i]->sequence);
+        steppers[i]->sequence = (PWMSequence){0};
+    }
 
     return mp_const_none;
 }
@@ -88,10 +117,134 @@ static mp_obj_t DiffDrive_task_loop(mp_obj_t self) {
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_task_loop_method, DiffDrive_task_loop);
 
+// Step from a hardware alarm interrupt instead of `task_loop`
+static mp_obj_t DiffDrive_start(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    if (!ddrive_start_timer(&self->ddrive)) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("No hardware alarm available"));
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_start_method, DiffDrive_start);
+
+// Run the task loop in C on core 1, outside of the MicroPython VM
+static mp_obj_t DiffDrive_start_core1(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    if (!ddrive_start_core1(&self->ddrive)) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("Core 1 or the step timer is in use"));
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_start_core1_method, DiffDrive_start_core1);
+
+static mp_obj_t DiffDrive_stop_core1(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+    ddrive_stop_core1(&self->ddrive);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_stop_core1_method, DiffDrive_stop_core1);
+
+// ==================== MOTIONS ====================
+
+// Handle of a move or ramp, done once it has finished or was replaced
+typedef struct _mp_obj_Motion_t {
+    mp_obj_base_t base;
+    mp_obj_DiffDrive * ddrive;
+    uint32_t id;
+} mp_obj_Motion;
+
+static const mp_obj_type_t type_Motion;
+
+static mp_obj_t new_motion(mp_obj_DiffDrive * ddrive, uint32_t id) {
+    mp_obj_Motion *motion = mp_obj_malloc(mp_obj_Motion, &type_Motion);
+    motion->ddrive = ddrive;
+    motion->id     = id;
+    return MP_OBJ_FROM_PTR(motion);
+}
+
+static bool motion_done(mp_obj_Motion * motion) {
+    return ddrive_move_done(&motion->ddrive->ddrive, motion->id);
+}
+
+static mp_obj_t Motion_done(mp_obj_t self_in) {
+    return mp_obj_new_bool(motion_done(MP_OBJ_TO_PTR(self_in)));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(Motion_done_method, Motion_done);
+
+// Block until done, still serving interrupts and other threads
+static mp_obj_t Motion_wait(mp_obj_t self_in) {
+    mp_obj_Motion *self = MP_OBJ_TO_PTR(self_in);
+    while (!motion_done(self)) {
+        mp_handle_pending(true);
+        MICROPY_THREAD_YIELD();
+    }
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(Motion_wait_method, Motion_wait);
+
+// `await motion` iterates the handle itself
+static mp_obj_t Motion_await(mp_obj_t self_in) {
+    return self_in;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(Motion_await_method, Motion_await);
+
+// Like `asyncio.ThreadSafeFlag.wait`: park the awaiting task on the asyncio
+// IO queue, which polls the handle with `Motion_ioctl` and sleeps in between.
+// The stepping wakes the sleeping core with an event when a motion is done.
+static mp_obj_t Motion_iternext(mp_obj_t self_in) {
+    mp_obj_Motion *self = MP_OBJ_TO_PTR(self_in);
+    if (motion_done(self)) return MP_OBJ_STOP_ITERATION;
+
+    mp_obj_t fromlist[] = { MP_OBJ_NEW_QSTR(MP_QSTR_core) };
+    mp_obj_t asyncio    = mp_import_name(MP_QSTR_asyncio, mp_obj_new_tuple(1, fromlist), MP_OBJ_NEW_SMALL_INT(0));
+    mp_obj_t core       = mp_import_from(asyncio, MP_QSTR_core);
+    mp_obj_t io_queue   = mp_load_attr(core, MP_QSTR__io_queue);
+
+    mp_obj_t dest[3];
+    mp_load_method(io_queue, MP_QSTR_queue_read, dest);
+    dest[2] = self_in;
+    return mp_call_method_n_kw(1, 0, dest);
+}
+
+static mp_uint_t Motion_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    mp_obj_Motion *self = MP_OBJ_TO_PTR(self_in);
+
+    if (request == MP_STREAM_POLL) {
+        return motion_done(self) ? arg & MP_STREAM_POLL_RD : 0;
+    }
+
+    *errcode = MP_EINVAL;
+    return MP_STREAM_ERROR;
+}
+
+static const mp_stream_p_t Motion_stream_p = {
+    .ioctl = Motion_ioctl,
+};
+
+static const mp_rom_map_elem_t Motion_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_done),      MP_ROM_PTR(&Motion_done_method)  },
+    { MP_ROM_QSTR(MP_QSTR_wait),      MP_ROM_PTR(&Motion_wait_method)  },
+    { MP_ROM_QSTR(MP_QSTR___await__), MP_ROM_PTR(&Motion_await_method) },
+};
+static MP_DEFINE_CONST_DICT(Motion_locals_dict, Motion_locals_dict_table);
+
+static MP_DEFINE_CONST_OBJ_TYPE(
+    type_Motion,
+    MP_QSTR_Motion,
+    MP_TYPE_FLAG_ITER_IS_ITERNEXT,
+    iter, Motion_iternext,
+    protocol, &Motion_stream_p,
+    locals_dict, &Motion_locals_dict
+);
+
 // ==================== METHODS ====================
 
 static void wait_until_ready(DiffDrive * ddrive) {
-    while (ddrive->new_cmd_available) {
+    while (!ddrive_ready(ddrive)) {
         mp_handle_pending(true);
         MICROPY_THREAD_YIELD();
     }
@@ -133,13 +286,281 @@ static mp_obj_t DiffDrive_trans_rot(mp_obj_t self_in, mp_obj_t trans_obj, mp_obj
 }
 static MP_DEFINE_CONST_FUN_OBJ_3(DiffDrive_set_trans_rot_method, DiffDrive_trans_rot);
 
+// bool ddrive_try_rpm(DiffDrive * ddrive, float rrpm, float lrpm);
+static mp_obj_t DiffDrive_try_rpm(mp_obj_t self_in, mp_obj_t rrpm_obj, mp_obj_t lrpm_obj) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    float rrpm = mp_obj_get_float(rrpm_obj);
+    float lrpm = mp_obj_get_float(lrpm_obj);
+
+    return mp_obj_new_bool(ddrive_try_rpm(&self->ddrive, rrpm, lrpm));
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(DiffDrive_try_set_rpm_method, DiffDrive_try_rpm);
+
+// bool ddrive_try_trans_rot(DiffDrive * ddrive, float trans, float rot);
+static mp_obj_t DiffDrive_try_trans_rot(mp_obj_t self_in, mp_obj_t trans_obj, mp_obj_t rot_obj) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    float trans = mp_obj_get_float(trans_obj);
+    float rot = mp_obj_get_float(rot_obj);
+
+    return mp_obj_new_bool(ddrive_try_trans_rot(&self->ddrive, trans, rot));
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(DiffDrive_try_set_trans_rot_method, DiffDrive_try_trans_rot);
+
+// bool ddrive_segment(DiffDrive * ddrive, float rrev, float lrev, float rpm);
+static mp_obj_t DiffDrive_segment(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    float rrev = mp_obj_get_float(args[1]);
+    float lrev = mp_obj_get_float(args[2]);
+    float rpm  = mp_obj_get_float(args[3]);
+
+    if (self->ddrive.timer_active) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("Segments do not run from the step timer"));
+    }
+
+    wait_until_ready(&self->ddrive);
+    ddrive_segment(&self->ddrive, rrev, lrev, rpm);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_add_segment_method, 4, 4, DiffDrive_segment);
+
+// uint32_t ddrive_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm);
+static mp_obj_t DiffDrive_move(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    int32_t rsteps = mp_obj_get_int(args[1]);
+    int32_t lsteps = mp_obj_get_int(args[2]);
+    float rpm      = mp_obj_get_float(args[3]);
+
+    if (rpm <= 0) mp_raise_ValueError(MP_ERROR_TEXT("rpm must be positive"));
+    if (self->ddrive.timer_active) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("Moves do not run from the step timer"));
+    }
+
+    wait_until_ready(&self->ddrive);
+    return new_motion(self, ddrive_move(&self->ddrive, rsteps, lsteps, rpm));
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_move_method, 4, 4, DiffDrive_move);
+
+// uint32_t ddrive_try_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm);
+static mp_obj_t DiffDrive_try_move(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    int32_t rsteps = mp_obj_get_int(args[1]);
+    int32_t lsteps = mp_obj_get_int(args[2]);
+    float rpm      = mp_obj_get_float(args[3]);
+
+    if (rpm <= 0) mp_raise_ValueError(MP_ERROR_TEXT("rpm must be positive"));
+    if (self->ddrive.timer_active) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("Moves do not run from the step timer"));
+    }
+
+    uint32_t id = ddrive_try_move(&self->ddrive, rsteps, lsteps, rpm);
+    return id ? new_motion(self, id) : mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_try_move_method, 4, 4, DiffDrive_try_move);
+
+// uint32_t ddrive_scurve_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time, float jerk);
+static mp_obj_t DiffDrive_ramp_rpm(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    float rrpm = mp_obj_get_float(args[1]);
+    float lrpm = mp_obj_get_float(args[2]);
+    float time = mp_obj_get_float(args[3]);
+    float jerk = n_args > 4 ? mp_obj_get_float(args[4]) : 0;
+
+    if (time < 0 || jerk < 0) mp_raise_ValueError(MP_ERROR_TEXT("time and jerk must not be negative"));
+
+    wait_until_ready(&self->ddrive);
+    return new_motion(self, ddrive_scurve_rpm(&self->ddrive, rrpm, lrpm, time, jerk));
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_ramp_rpm_method, 4, 5, DiffDrive_ramp_rpm);
+
+// uint32_t ddrive_scurve_trans_rot(DiffDrive * ddrive, float trans, float rot, float time, float jerk);
+static mp_obj_t DiffDrive_ramp_trans_rot(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    float trans = mp_obj_get_float(args[1]);
+    float rot   = mp_obj_get_float(args[2]);
+    float time  = mp_obj_get_float(args[3]);
+    float jerk  = n_args > 4 ? mp_obj_get_float(args[4]) : 0;
+
+    if (time < 0 || jerk < 0) mp_raise_ValueError(MP_ERROR_TEXT("time and jerk must not be negative"));
+
+    wait_until_ready(&self->ddrive);
+    return new_motion(self, ddrive_scurve_trans_rot(&self->ddrive, trans, rot, time, jerk));
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_ramp_trans_rot_method, 4, 5, DiffDrive_ramp_trans_rot);
+
+// True until the last move or ramp sent has finished or was replaced
+static mp_obj_t DiffDrive_moving(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(!ddrive_move_done(&self->ddrive, self->ddrive.moves_sent));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_moving_method, DiffDrive_moving);
+
+// bool ddrive_stream(DiffDrive * ddrive, const int16_t * samples, uint32_t count, uint32_t dt_us);
+static mp_obj_t DiffDrive_stream(mp_obj_t self_in, mp_obj_t buf_obj, mp_obj_t dt_obj) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_obj, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.typecode != 'h') {
+        mp_raise_TypeError(MP_ERROR_TEXT("buf must hold signed 16 bit setpoints, like array('h')"));
+    }
+    if (bufinfo.len % (2 * sizeof(int16_t))) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buf must hold a right and left setpoint for each sample"));
+    }
+
+    mp_int_t dt_us = mp_obj_get_int(dt_obj);
+    if (dt_us <= 0) mp_raise_ValueError(MP_ERROR_TEXT("dt_us must be positive"));
+
+    // Wait for a buffer to be handed back before replacing its reference
+    while (!ddrive_stream_free(&self->ddrive)) {
+        mp_handle_pending(true);
+        MICROPY_THREAD_YIELD();
+    }
+    self->stream_bufs[self->ddrive.stream.head % DDRIVE_STREAM_BUFS] = buf_obj;
+
+    ddrive_stream(&self->ddrive, bufinfo.buf, bufinfo.len / (2 * sizeof(int16_t)), dt_us);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(DiffDrive_stream_method, DiffDrive_stream);
+
+// uint ddrive_stream_free(DiffDrive * ddrive);
+static mp_obj_t DiffDrive_stream_free(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_int(ddrive_stream_free(&self->ddrive));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_stream_free_method, DiffDrive_stream_free);
+
+// void ddrive_accel(DiffDrive * ddrive, float accel);
+static mp_obj_t DiffDrive_accel(mp_obj_t self_in, mp_obj_t accel_obj) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    float accel = mp_obj_get_float(accel_obj);
+
+    wait_until_ready(&self->ddrive);
+    ddrive_accel(&self->ddrive, accel);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(DiffDrive_set_accel_method, DiffDrive_accel);
+
+// void ddrive_idle(DiffDrive * ddrive, uint16_t hold_level, uint32_t release_ms);
+static mp_obj_t DiffDrive_idle(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+
+    uint16_t hold_level = level_from_obj(args[1]);
+    mp_int_t release_ms = n_args > 2 ? mp_obj_get_int(args[2]) : 0;
+
+    if (release_ms < 0) mp_raise_ValueError(MP_ERROR_TEXT("release_ms must not be negative"));
+
+    wait_until_ready(&self->ddrive);
+    ddrive_idle(&self->ddrive, hold_level, release_ms);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_set_idle_method, 2, 3, DiffDrive_idle);
+
+// void ddrive_odometry(DiffDrive * ddrive, float wheel_radius, float track_width);
+static mp_obj_t DiffDrive_odometry(mp_obj_t self_in, mp_obj_t radius_obj, mp_obj_t track_obj) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    float wheel_radius = mp_obj_get_float(radius_obj);
+    float track_width  = mp_obj_get_float(track_obj);
+
+    if (wheel_radius <= 0 || track_width <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("wheel_radius and track_width must be positive"));
+    }
+
+    wait_until_ready(&self->ddrive);
+    ddrive_odometry(&self->ddrive, wheel_radius, track_width);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(DiffDrive_set_odometry_method, DiffDrive_odometry);
+
+// Pose as (x, y, theta), read from a snapshot without locking
+static mp_obj_t DiffDrive_pose(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    OdometryPose pose;
+    ddrive_pose(&self->ddrive, &pose);
+
+    mp_obj_t items[] = {
+        mp_obj_new_float(odometry_pos_to_float(pose.x)),
+        mp_obj_new_float(odometry_pos_to_float(pose.y)),
+        mp_obj_new_float(odometry_theta_to_float(pose.theta)),
+    };
+    return mp_obj_new_tuple(3, items);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_pose_method, DiffDrive_pose);
+
+// Step counts as (right, left), from the same kind of snapshot as `pose`
+static mp_obj_t DiffDrive_steps(mp_obj_t self_in) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(self_in);
+
+    OdometryPose pose;
+    ddrive_pose(&self->ddrive, &pose);
+
+    mp_obj_t items[] = {
+        mp_obj_new_int_from_ll(pose.rsteps),
+        mp_obj_new_int_from_ll(pose.lsteps),
+    };
+    return mp_obj_new_tuple(2, items);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(DiffDrive_steps_method, DiffDrive_steps);
+
+// uint32_t ddrive_max_latency(DiffDrive * ddrive, bool reset);
+static mp_obj_t DiffDrive_latency(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+    bool reset = n_args > 1 && mp_obj_is_true(args[1]);
+    return mp_obj_new_int_from_uint(ddrive_max_latency(&self->ddrive, reset));
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_latency_method, 1, 2, DiffDrive_latency);
+
+#if STEPPER_STATS
+static mp_obj_t DiffDrive_stats(size_t n_args, const mp_obj_t *args) {
+    mp_obj_DiffDrive *self = MP_OBJ_TO_PTR(args[0]);
+    bool reset = n_args > 1 && mp_obj_is_true(args[1]);
+
+    mp_obj_t dict = mp_obj_new_dict(2);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_right), stats_to_dict(&self->ddrive.rstepper.stats, reset));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_left),  stats_to_dict(&self->ddrive.lstepper.stats, reset));
+    return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(DiffDrive_stats_method, 1, 2, DiffDrive_stats);
+#endif
+
 
 static const mp_rom_map_elem_t DiffDrive_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR___del__),                MP_ROM_PTR(&DiffDrive_deinit_method)             },
     { MP_ROM_QSTR(MP_QSTR_task_loop),              MP_ROM_PTR(&DiffDrive_task_loop_method)          },
+    { MP_ROM_QSTR(MP_QSTR_start),                  MP_ROM_PTR(&DiffDrive_start_method)              },
+    { MP_ROM_QSTR(MP_QSTR_start_core1),            MP_ROM_PTR(&DiffDrive_start_core1_method)        },
+    { MP_ROM_QSTR(MP_QSTR_stop_core1),             MP_ROM_PTR(&DiffDrive_stop_core1_method)         },
     { MP_ROM_QSTR(MP_QSTR_stop),                   MP_ROM_PTR(&DiffDrive_stop_method)               },
     { MP_ROM_QSTR(MP_QSTR_set_rpm),                MP_ROM_PTR(&DiffDrive_set_rpm_method)            },
     { MP_ROM_QSTR(MP_QSTR_set_trans_rot),          MP_ROM_PTR(&DiffDrive_set_trans_rot_method)      },
+    { MP_ROM_QSTR(MP_QSTR_try_set_rpm),            MP_ROM_PTR(&DiffDrive_try_set_rpm_method)        },
+    { MP_ROM_QSTR(MP_QSTR_try_set_trans_rot),      MP_ROM_PTR(&DiffDrive_try_set_trans_rot_method)  },
+    { MP_ROM_QSTR(MP_QSTR_add_segment),            MP_ROM_PTR(&DiffDrive_add_segment_method)        },
+    { MP_ROM_QSTR(MP_QSTR_move),                   MP_ROM_PTR(&DiffDrive_move_method)               },
+    { MP_ROM_QSTR(MP_QSTR_try_move),               MP_ROM_PTR(&DiffDrive_try_move_method)           },
+    { MP_ROM_QSTR(MP_QSTR_ramp_rpm),               MP_ROM_PTR(&DiffDrive_ramp_rpm_method)           },
+    { MP_ROM_QSTR(MP_QSTR_ramp_trans_rot),         MP_ROM_PTR(&DiffDrive_ramp_trans_rot_method)     },
+    { MP_ROM_QSTR(MP_QSTR_moving),                 MP_ROM_PTR(&DiffDrive_moving_method)             },
+    { MP_ROM_QSTR(MP_QSTR_stream),                 MP_ROM_PTR(&DiffDrive_stream_method)             },
+    { MP_ROM_QSTR(MP_QSTR_stream_free),            MP_ROM_PTR(&DiffDrive_stream_free_method)        },
+    { MP_ROM_QSTR(MP_QSTR_set_accel),              MP_ROM_PTR(&DiffDrive_set_accel_method)          },
+    { MP_ROM_QSTR(MP_QSTR_set_idle),               MP_ROM_PTR(&DiffDrive_set_idle_method)           },
+    { MP_ROM_QSTR(MP_QSTR_set_odometry),           MP_ROM_PTR(&DiffDrive_set_odometry_method)       },
+    { MP_ROM_QSTR(MP_QSTR_pose),                   MP_ROM_PTR(&DiffDrive_pose_method)               },
+    { MP_ROM_QSTR(MP_QSTR_steps),                  MP_ROM_PTR(&DiffDrive_steps_method)              },
+    { MP_ROM_QSTR(MP_QSTR_latency),                MP_ROM_PTR(&DiffDrive_latency_method)            },
+#if STEPPER_STATS
+    { MP_ROM_QSTR(MP_QSTR_stats),                  MP_ROM_PTR(&DiffDrive_stats_method)              },
+#endif
 };
 
 static MP_DEFINE_CONST_DICT(DiffDrive_locals_dict, DiffDrive_locals_dict_table);
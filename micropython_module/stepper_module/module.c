@@ -4,11 +4,61 @@
 
 #include "stepper_class.h"
 #include "ddrive_class.h"
+#include "multi_stepper_class.h"
+
+// Restart the PWM slices of the given motors in phase. A `MultiStepper` syncs
+// its steppers on its own.
+static mp_obj_t stepper_sync(size_t n_args, const mp_obj_t *args) {
+    uint32_t mask = 0;
+
+    for (size_t i = 0; i < n_args; i++) {
+        if (mp_obj_is_type(args[i], &type_Stepper)) {
+            mp_obj_Stepper *motor = MP_OBJ_TO_PTR(args[i]);
+            mask |= stepper_slice_mask(&motor->stepper);
+        } else if (mp_obj_is_type(args[i], &type_DiffDrive)) {
+            mp_obj_DiffDrive *ddrive = MP_OBJ_TO_PTR(args[i]);
+            mask |= stepper_slice_mask(&ddrive->ddrive.lstepper);
+            mask |= stepper_slice_mask(&ddrive->ddrive.rstepper);
+        } else {
+            mp_raise_TypeError(MP_ERROR_TEXT("expected Stepper or DiffDrive"));
+        }
+    }
+
+    stepper_sync_slices(mask);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR(stepper_sync_obj, 0, stepper_sync);
+
+#if STEPPER_BENCH
+#include "bench.h"
+
+// Run the stepperlib microbenchmarks and return the report as JSON
+static mp_obj_t stepper_bench(size_t n_args, const mp_obj_t *args) {
+    uint32_t calls = n_args > 0 ? mp_obj_get_int(args[0]) : 10000;
+
+    BenchReport * report = m_new_obj(BenchReport);
+    bench_run(report, calls);
+
+    size_t len = bench_format_json(report, NULL, 0);
+    vstr_t vstr;
+    vstr_init_len(&vstr, len);
+    bench_format_json(report, vstr.buf, len + 1);
+
+    m_del_obj(BenchReport, report);
+    return mp_obj_new_str_from_vstr(&vstr);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(stepper_bench_obj, 0, 1, stepper_bench);
+#endif
 
 static const mp_rom_map_elem_t module_globals_table[] = {
-    { MP_ROM_QSTR(MP_QSTR___name__),  MP_ROM_QSTR(MP_QSTR_stepper) },
-    { MP_ROM_QSTR(MP_QSTR_Stepper),   MP_ROM_PTR(&type_Stepper)   },
-    { MP_ROM_QSTR(MP_QSTR_DiffDrive), MP_ROM_PTR(&type_DiffDrive) },
+    { MP_ROM_QSTR(MP_QSTR___name__),     MP_ROM_QSTR(MP_QSTR_stepper)    },
+    { MP_ROM_QSTR(MP_QSTR_Stepper),      MP_ROM_PTR(&type_Stepper)       },
+    { MP_ROM_QSTR(MP_QSTR_DiffDrive),    MP_ROM_PTR(&type_DiffDrive)     },
+    { MP_ROM_QSTR(MP_QSTR_MultiStepper), MP_ROM_PTR(&type_MultiStepper)  },
+    { MP_ROM_QSTR(MP_QSTR_sync),         MP_ROM_PTR(&stepper_sync_obj)   },
+#if STEPPER_BENCH
+    { MP_ROM_QSTR(MP_QSTR_bench),        MP_ROM_PTR(&stepper_bench_obj)  },
+#endif
 };
 static MP_DEFINE_CONST_DICT(module_globals, module_globals_table);
 
@@ -0,0 +1,144 @@
+#ifndef MULTI_STEPPER_CLASS_H
+#define MULTI_STEPPER_CLASS_H
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include <pico/stdlib.h>
+
+#include "multi_stepper.h"
+#include "stepper_class.h"
+
+typedef struct _mp_obj_MultiStepper_t {
+    mp_obj_base_t base; // For MicroPython object system
+    MultiStepper ms;
+    mp_obj_t motors[MULTI_STEPPER_MAX_AXES]; // Keeps the `Stepper` objects alive
+} mp_obj_MultiStepper;
+
+// `MultiStepper` class
+static mp_obj_t MultiStepper_make_new(const mp_obj_type_t *type, size_t n_args,
+        size_t n_kw, const mp_obj_t *args) {
+
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+
+    size_t len;
+    mp_obj_t *items;
+    mp_obj_get_array(args[0], &len, &items);
+
+    if (len == 0 || len > MULTI_STEPPER_MAX_AXES) {
+        mp_raise_ValueError(MP_ERROR_TEXT("steppers must have 1 to 4 items"));
+    }
+
+    Stepper * steppers[MULTI_STEPPER_MAX_AXES];
+    for (size_t i = 0; i < len; i++) {
+        if (!mp_obj_is_type(items[i], &type_Stepper)) {
+            mp_raise_TypeError(MP_ERROR_TEXT("steppers must be Stepper objects"));
+        }
+        mp_obj_Stepper *motor = MP_OBJ_TO_PTR(items[i]);
+        steppers[i] = &motor->stepper;
+    }
+
+    // The finaliser releases the hardware alarm when the object is collected
+    mp_obj_MultiStepper *self = mp_obj_malloc_with_finaliser(mp_obj_MultiStepper, type);
+    for (size_t i = 0; i < MULTI_STEPPER_MAX_AXES; i++) {
+        self->motors[i] = i < len ? items[i] : mp_const_none;
+    }
+
+    if (!multi_stepper_init(&self->ms, steppers, len)) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("No hardware alarm available"));
+    }
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+static mp_obj_t MultiStepper_deinit(mp_obj_t self_in) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(self_in);
+    multi_stepper_deinit(&self->ms);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(MultiStepper_deinit_method, MultiStepper_deinit);
+
+// Get one value per axis from a list or tuple
+static void axis_values(mp_obj_MultiStepper *self, mp_obj_t values_obj, mp_obj_t **items) {
+    size_t len;
+    mp_obj_get_array(values_obj, &len, items);
+    if (len != self->ms.axes) {
+        mp_raise_ValueError(MP_ERROR_TEXT("expected one value per stepper"));
+    }
+}
+
+static mp_obj_t MultiStepper_set_velocity(size_t n_args, const mp_obj_t *args) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(args[0]);
+
+    mp_obj_t *items;
+    axis_values(self, args[1], &items);
+    uint16_t level = n_args > 2 ? level_from_obj(args[2]) : PWM_MAX;
+
+    float steps_pr_sec[MULTI_STEPPER_MAX_AXES];
+    for (size_t i = 0; i < self->ms.axes; i++) steps_pr_sec[i] = mp_obj_get_float(items[i]);
+
+    multi_stepper_velocity(&self->ms, steps_pr_sec, level);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(MultiStepper_set_velocity_method, 2, 3, MultiStepper_set_velocity);
+
+static mp_obj_t MultiStepper_move(size_t n_args, const mp_obj_t *args) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(args[0]);
+
+    mp_obj_t *items;
+    axis_values(self, args[1], &items);
+    float steps_pr_sec = mp_obj_get_float(args[2]);
+    uint16_t level     = n_args > 3 ? level_from_obj(args[3]) : PWM_MAX;
+
+    if (steps_pr_sec <= 0) mp_raise_ValueError(MP_ERROR_TEXT("steps_per_sec must be positive"));
+
+    int32_t steps[MULTI_STEPPER_MAX_AXES];
+    for (size_t i = 0; i < self->ms.axes; i++) steps[i] = mp_obj_get_int(items[i]);
+
+    multi_stepper_move(&self->ms, steps, steps_pr_sec, level);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(MultiStepper_move_method, 3, 4, MultiStepper_move);
+
+static mp_obj_t MultiStepper_busy(mp_obj_t self_in) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(multi_stepper_busy(&self->ms));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(MultiStepper_busy_method, MultiStepper_busy);
+
+static mp_obj_t MultiStepper_positions(mp_obj_t self_in) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(self_in);
+
+    mp_obj_t positions[MULTI_STEPPER_MAX_AXES];
+    for (size_t i = 0; i < self->ms.axes; i++) positions[i] = mp_obj_new_int(self->ms.position[i]);
+
+    return mp_obj_new_list(self->ms.axes, positions);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(MultiStepper_positions_method, MultiStepper_positions);
+
+static mp_obj_t MultiStepper_stop(mp_obj_t self_in) {
+    mp_obj_MultiStepper *self = MP_OBJ_TO_PTR(self_in);
+    multi_stepper_stop(&self->ms);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(MultiStepper_stop_method, MultiStepper_stop);
+
+static const mp_rom_map_elem_t MultiStepper_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_set_velocity), MP_ROM_PTR(&MultiStepper_set_velocity_method) },
+    { MP_ROM_QSTR(MP_QSTR_move),         MP_ROM_PTR(&MultiStepper_move_method)         },
+    { MP_ROM_QSTR(MP_QSTR_busy),         MP_ROM_PTR(&MultiStepper_busy_method)         },
+    { MP_ROM_QSTR(MP_QSTR_positions),    MP_ROM_PTR(&MultiStepper_positions_method)    },
+    { MP_ROM_QSTR(MP_QSTR_stop),         MP_ROM_PTR(&MultiStepper_stop_method)         },
+    { MP_ROM_QSTR(MP_QSTR___del__),      MP_ROM_PTR(&MultiStepper_deinit_method)       },
+};
+static MP_DEFINE_CONST_DICT(MultiStepper_locals_dict, MultiStepper_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    type_MultiStepper,
+    MP_QSTR_MultiStepper,
+    MP_TYPE_FLAG_NONE,
+    make_new, MultiStepper_make_new,
+    locals_dict, &MultiStepper_locals_dict
+);
+
+#endif // MULTI_STEPPER_CLASS_H
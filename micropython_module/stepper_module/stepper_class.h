@@ -3,17 +3,23 @@
 
 #include "py/obj.h"
 #include "py/runtime.h"
+#include "py/binary.h"
 
 #include <pico/stdlib.h>
 #include <stdlib.h>
 
 #include "stepper.h"
+#include "step_timer.h"
+#include "seq_registry.h"
 
 #define CLAMP(x, lower, upper) ((x) < (lower) ? (lower) : ((x) > (upper) ? (upper) : (x)))
 
 typedef struct _mp_obj_Stepper_t {
     mp_obj_base_t base; // For MicroPython object system
     Stepper stepper;
+    StepTimer timer;    // Used by `spin`, `run` and `run_profile`
+    bool timer_active;
+    mp_obj_t profile;   // Buffer read by a running profile
 } mp_obj_Stepper;
 
 // `Stepper` class
@@ -44,14 +50,21 @@ static mp_obj_t Stepper_make_new(const mp_obj_type_t *type, size_t n_args,
     }
 
     int steps = mp_obj_get_int(steps_obj);
-    (void)steps;  // Suppress unused variable warning.
 
-    mp_obj_Stepper *self = mp_obj_malloc(mp_obj_Stepper, type);
+    // The finaliser releases the sequence when the object is collected
+    mp_obj_Stepper *self = mp_obj_malloc_with_finaliser(mp_obj_Stepper, type);
+    self->timer_active = false;
+    self->profile      = mp_const_none;
+    self->stepper      = (Stepper){0};
 
-    float * buf = m_new(float, steps* STEPPER_PINS);
-    PWMSequence seq = stepper_generate_seq(steps, buf);
+    // Shared with every other motor of the same stepping mode
+    PWMSequence seq = seq_registry_acquire(steps, SEQ_WAVE_HALF_SINE);
+    if (!seq.length) {
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Failed to allocate the PWM sequence"));
+    }
 
     stepper_init_with_seq(&self->stepper, pins, seq);
+    stepper_use_level_cache(&self->stepper, m_new(uint16_t, stepper_level_cache_len(seq)));
 
     return MP_OBJ_FROM_PTR(self);
 }
@@ -61,30 +74,42 @@ static mp_obj_t Stepper_deinit(mp_obj_t self_in) {
 
     if (!self) return mp_const_none;
 
+    if (self->timer_active) {
+        step_timer_deinit(&self->timer);
+        self->timer_active = false;
+    }
+
     if (self->stepper.pins) {
         m_del(int, self->stepper.pins, STEPPER_PINS);
         self->stepper.pins = NULL;
     }
 
-    if (self->stepper.sequence.items) {
-        m_del(float, self->stepper.sequence.items, self->stepper.sequence.length * STEPPER_PINS);
-        self->stepper.sequence.items = NULL;
-        self->stepper.sequence.length = 0;
+    if (self->stepper.level_cache) {
+        m_del(uint16_t, self->stepper.level_cache, self->stepper.level_cache_len);
+        self->stepper.level_cache = NULL;
+    }
+
+    if (self->stepper.sequence.length) {
+        stepper_release_resolutions(&self->stepper);
+        seq_registry_release(self->stepper.sequence);
+        self->stepper.sequence = (PWMSequence){0};
     }
 
     return mp_const_none;
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(Stepper_deinit_method, Stepper_deinit);
 
+static uint16_t level_from_obj(mp_obj_t level_obj) {
+    float flevel = mp_obj_get_float(level_obj);
+    flevel = CLAMP(flevel, 0.0f, 1.0f);
+    return (uint16_t)(flevel * PWM_MAX);
+}
+
 mp_obj_t Stepper_step(mp_obj_t self_in, mp_obj_t direction_obj, mp_obj_t level_obj) {
     mp_obj_Stepper *self = MP_OBJ_TO_PTR(self_in);
 
     bool direction = mp_obj_is_true(direction_obj);
-    float flevel    = mp_obj_get_float(level_obj);
-
-    flevel = CLAMP(flevel, 0.0f, 1.0f);
-
-    uint16_t level = (uint16_t)(flevel * PWM_MAX);
+    uint16_t level = level_from_obj(level_obj);
 
     // Call the C function
     stepper_step(&self->stepper, direction, level);
@@ -93,17 +118,167 @@ mp_obj_t Stepper_step(mp_obj_t self_in, mp_obj_t direction_obj, mp_obj_t level_o
 }
 MP_DEFINE_CONST_FUN_OBJ_3(Stepper_step_method, Stepper_step);
 
+// Claim a hardware alarm for the stepper the first time it is needed
+static void start_timer(mp_obj_Stepper * self) {
+    if (self->timer_active) return;
+
+    if (!step_timer_init(&self->timer)) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("No hardware alarm available"));
+    }
+    step_timer_add(&self->timer, &self->stepper);
+    step_timer_start(&self->timer);
+    self->timer_active = true;
+}
+
+// Wait for a run to finish, still serving interrupts and other threads
+static void wait_for_run(mp_obj_Stepper * self) {
+    while (step_timer_remaining(&self->timer, 0)) {
+        mp_handle_pending(true);
+        MICROPY_THREAD_YIELD();
+    }
+}
+
+// Step continuously from a hardware alarm interrupt
+mp_obj_t Stepper_spin(size_t n_args, const mp_obj_t *args) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(args[0]);
+
+    bool direction     = mp_obj_is_true(args[1]);
+    uint16_t level     = level_from_obj(args[2]);
+    mp_int_t period_us = mp_obj_get_int(args[3]);
+
+    if (period_us <= 0) mp_raise_ValueError(MP_ERROR_TEXT("period_us must be positive"));
+
+    start_timer(self);
+    step_timer_set(&self->timer, 0, period_us, direction, level);
+    self->profile = mp_const_none;
+
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(Stepper_spin_method, 4, 4, Stepper_spin);
+
+// void step_timer_run(StepTimer * timer, uint channel, int32_t steps, uint32_t period_us, uint16_t level);
+static mp_obj_t Stepper_run(size_t n_args, const mp_obj_t *args) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(args[0]);
+
+    mp_int_t steps     = mp_obj_get_int(args[1]);
+    mp_int_t period_us = mp_obj_get_int(args[2]);
+    uint16_t level     = n_args > 3 ? level_from_obj(args[3]) : PWM_MAX;
+    bool block         = n_args > 4 ? mp_obj_is_true(args[4]) : true;
+
+    if (period_us <= 0) mp_raise_ValueError(MP_ERROR_TEXT("period_us must be positive"));
+
+    start_timer(self);
+    step_timer_run(&self->timer, 0, steps, period_us, level);
+    self->profile = mp_const_none;
+
+    if (block) wait_for_run(self);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(Stepper_run_method, 3, 5, Stepper_run);
+
+// void step_timer_run_profile(StepTimer * timer, uint channel, const int32_t * periods_us, uint32_t count, uint16_t level);
+static mp_obj_t Stepper_run_profile(size_t n_args, const mp_obj_t *args) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(args[0]);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[1], &bufinfo, MP_BUFFER_READ);
+    if ((bufinfo.typecode != 'i' && bufinfo.typecode != 'l')
+            || mp_binary_get_size('@', bufinfo.typecode, NULL) != sizeof(int32_t)) {
+        mp_raise_TypeError(MP_ERROR_TEXT("buf must hold signed 32 bit periods, like array('i')"));
+    }
+
+    uint16_t level = n_args > 2 ? level_from_obj(args[2]) : PWM_MAX;
+    bool block     = n_args > 3 ? mp_obj_is_true(args[3]) : true;
+
+    start_timer(self);
+
+    // Keep the buffer alive while the interrupt reads it
+    self->profile = args[1];
+    step_timer_run_profile(&self->timer, 0, bufinfo.buf, bufinfo.len / sizeof(int32_t), level);
+
+    if (block) wait_for_run(self);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(Stepper_run_profile_method, 2, 4, Stepper_run_profile);
+
+// uint32_t step_timer_remaining(StepTimer * timer, uint channel);
+static mp_obj_t Stepper_remaining(mp_obj_t self_in) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(self_in);
+    uint32_t remaining = self->timer_active ? step_timer_remaining(&self->timer, 0) : 0;
+    return mp_obj_new_int_from_uint(remaining);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(Stepper_remaining_method, Stepper_remaining);
+
+// True while a run or profile has steps left
+static mp_obj_t Stepper_busy(mp_obj_t self_in) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(self->timer_active && step_timer_remaining(&self->timer, 0));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(Stepper_busy_method, Stepper_busy);
+
 mp_obj_t Stepper_stop(mp_obj_t self_in) {
     mp_obj_Stepper *self = MP_OBJ_TO_PTR(self_in);
+    if (self->timer_active) step_timer_set(&self->timer, 0, 0, true, 0);
+    self->profile = mp_const_none;
     stepper_stop(&self->stepper);
     return mp_const_none;
 }
 
 MP_DEFINE_CONST_FUN_OBJ_1(Stepper_stop_method, Stepper_stop);
 
+#if STEPPER_STATS
+static mp_obj_t stats_to_dict(StepStats * live, bool reset) {
+    // Snapshot first, the stats may be updated from an interrupt
+    StepStats stats = *live;
+    if (reset) step_stats_reset(live);
+
+    mp_obj_t times[STEP_STATS_RING];
+    size_t count = MIN(stats.steps, STEP_STATS_RING);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t t = stats.times[(stats.steps - count + i) & (STEP_STATS_RING - 1)];
+        times[i] = mp_obj_new_int_from_uint(t);
+    }
+
+    mp_obj_t histogram[STEP_STATS_BINS];
+    for (size_t i = 0; i < STEP_STATS_BINS; i++) {
+        histogram[i] = mp_obj_new_int_from_uint(stats.histogram[i]);
+    }
+
+    float mean = stats.periods ? (float)stats.sum_error_us / stats.periods : 0.0f;
+
+    mp_obj_t dict = mp_obj_new_dict(8);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_steps),        mp_obj_new_int_from_uint(stats.steps));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_periods),      mp_obj_new_int_from_uint(stats.periods));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_min_error_us), mp_obj_new_int(stats.min_error_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_max_error_us), mp_obj_new_int(stats.max_error_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_mean_error_us), mp_obj_new_float(mean));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_missed),       mp_obj_new_int_from_uint(stats.missed));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_histogram),    mp_obj_new_list(STEP_STATS_BINS, histogram));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_times),        mp_obj_new_list(count, times));
+    return dict;
+}
+
+static mp_obj_t Stepper_stats(size_t n_args, const mp_obj_t *args) {
+    mp_obj_Stepper *self = MP_OBJ_TO_PTR(args[0]);
+    bool reset = n_args > 1 && mp_obj_is_true(args[1]);
+    return stats_to_dict(&self->stepper.stats, reset);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(Stepper_stats_method, 1, 2, Stepper_stats);
+#endif
+
 static const mp_rom_map_elem_t Stepper_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_step),    MP_ROM_PTR(&Stepper_step_method)   },
+    { MP_ROM_QSTR(MP_QSTR_spin),    MP_ROM_PTR(&Stepper_spin_method)   },
+    { MP_ROM_QSTR(MP_QSTR_run),     MP_ROM_PTR(&Stepper_run_method)    },
+    { MP_ROM_QSTR(MP_QSTR_run_profile), MP_ROM_PTR(&Stepper_run_profile_method) },
+    { MP_ROM_QSTR(MP_QSTR_remaining), MP_ROM_PTR(&Stepper_remaining_method) },
+    { MP_ROM_QSTR(MP_QSTR_busy),    MP_ROM_PTR(&Stepper_busy_method)   },
     { MP_ROM_QSTR(MP_QSTR_stop),    MP_ROM_PTR(&Stepper_stop_method)   },
+#if STEPPER_STATS
+    { MP_ROM_QSTR(MP_QSTR_stats),   MP_ROM_PTR(&Stepper_stats_method)  },
+#endif
     { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&Stepper_deinit_method) },
 };
 static MP_DEFINE_CONST_DICT(Stepper_locals_dict, Stepper_locals_dict_table);
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pico/stdlib.h>
+#include <hardware/clocks.h>
+
+#include "bench.h"
+#include "ddrive.h"
+#include "stepper.h"
+
+#if PICO_ON_DEVICE
+#include <hardware/structs/systick.h>
+#else
+#include <time.h>
+#endif
+
+// Longest benchmarked sequence
+#define BENCH_MAX_SEQ 256
+
+// Step period of the benchmarked `ddrive_task`. Sleeping is not counted.
+#define BENCH_DDRIVE_STEP_US 20
+
+static int rpins[STEPPER_PINS] = {0, 1, 2, 3};
+static int lpins[STEPPER_PINS] = {4, 5, 6, 7};
+
+// ==================== CLOCK ====================
+
+#if PICO_ON_DEVICE
+
+// SysTick counts clk_sys cycles down from 2^24 - 1. A single measurement
+// must therefore stay below 2^24 cycles, 134 ms at 125 MHz.
+static void clock_start(void) {
+    systick_hw->rvr = 0xffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // Enabled, clocked by the processor
+}
+
+static uint32_t clock_now(void) {
+    return systick_hw->cvr;
+}
+
+static uint64_t clock_cycles(uint32_t start) {
+    return (start - systick_hw->cvr) & 0xffffff;
+}
+
+#else
+
+static void clock_start(void) {}
+
+static uint32_t clock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+// Host time, modelled as cycles at clk_sys
+static uint64_t clock_cycles(uint32_t start) {
+    uint32_t ns = clock_now() - start;
+    return (uint64_t)ns * clock_get_hz(clk_sys) / 1000000000ull;
+}
+
+#endif
+
+// ==================== RESULTS ====================
+
+static BenchResult * add_result(BenchReport * report, const char * name, uint steps_pr_seq, uint32_t calls, uint64_t cycles) {
+    if (report->result_count >= BENCH_MAX_RESULTS) return NULL;
+
+    BenchResult * r = &report->results[report->result_count++];
+    r->name         = name;
+    r->steps_pr_seq = steps_pr_seq;
+    r->calls        = calls;
+    r->cycles       = (float)cycles / calls;
+    r->ns           = r->cycles * 1e9f / report->clk_hz;
+    return r;
+}
+
+// ==================== BENCHMARKS ====================
+
+// Calls per measurement, keeping every measurement well below 2^24 cycles
+#define BATCH 64
+
+static uint64_t time_steps(Stepper * stepper, uint32_t calls) {
+    uint64_t cycles = 0;
+    for (uint32_t done = 0; done < calls; done += BATCH) {
+        uint32_t start = clock_now();
+        for (uint i = 0; i < BATCH; i++) stepper_step(stepper, true, PWM_MAX);
+        cycles += clock_cycles(start);
+    }
+    return cycles;
+}
+
+// Steps with a level changing every 8 steps, like ramps
+static uint64_t time_ramp_steps(Stepper * stepper, uint32_t calls) {
+    uint64_t cycles = 0;
+    for (uint32_t done = 0; done < calls; done += BATCH) {
+        uint32_t start = clock_now();
+        for (uint i = 0; i < BATCH; i++) {
+            uint16_t level = PWM_MAX - ((done + i) / 8 % 64) * 256;
+            stepper_step(stepper, true, level);
+        }
+        cycles += clock_cycles(start);
+    }
+    return cycles;
+}
+
+static uint64_t time_levels(Stepper * stepper, uint32_t calls) {
+    uint16_t levels[STEPPER_PINS];
+    volatile uint16_t sink = 0;
+    uint64_t cycles = 0;
+
+    for (uint32_t done = 0; done < calls; done += BATCH) {
+        uint32_t start = clock_now();
+        for (uint i = 0; i < BATCH; i++) {
+            stepper_levels(stepper, (done + i) % stepper->sequence.length, PWM_MAX, levels);
+            sink += levels[0];
+        }
+        cycles += clock_cycles(start);
+    }
+    return cycles;
+}
+
+static uint64_t time_set_pins(Stepper * stepper, uint32_t calls) {
+    uint16_t levels[STEPPER_PINS] = {PWM_MIN, PWM_MAX, PWM_MIN, PWM_MAX};
+    uint64_t cycles = 0;
+
+    for (uint32_t done = 0; done < calls; done += BATCH) {
+        uint32_t start = clock_now();
+        for (uint i = 0; i < BATCH; i++) stepper_set_pins(stepper, levels);
+        cycles += clock_cycles(start);
+    }
+    return cycles;
+}
+
+static uint64_t time_generate(uint len, float * table, uint32_t calls) {
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < calls; i++) {
+        uint32_t start = clock_now();
+        stepper_generate_seq(len, table);
+        cycles += clock_cycles(start);
+    }
+    return cycles;
+}
+
+// One `ddrive_task` call steps both motors through a full sequence. The
+// time slept between steps is subtracted on the PICO, and is free on the
+// host where `sleep_us` only advances the virtual clock.
+static uint64_t time_ddrive(BenchReport * report, uint len, uint32_t calls) {
+    DiffDrive ddrive;
+    ddrive_init(&ddrive, lpins, rpins, len);
+
+    float rpm = 1e6f / BENCH_DDRIVE_STEP_US * 60 / (len * STEPPER_SEQS_PER_REV);
+    ddrive_rpm(&ddrive, rpm, rpm);
+    ddrive_task(&ddrive);
+
+    uint64_t slept  = report->on_device ? (uint64_t)len * BENCH_DDRIVE_STEP_US * (report->clk_hz / 1000000) : 0;
+    uint64_t cycles = 0;
+
+    for (uint32_t i = 0; i < calls; i++) {
+        uint32_t start = clock_now();
+        ddrive_task(&ddrive);
+        uint64_t c = clock_cycles(start);
+        cycles += c > slept ? c - slept : 0;
+    }
+
+    ddrive_deinit(&ddrive);
+
+    return cycles;
+}
+
+static void bench_seq(BenchReport * report, uint len, uint32_t calls) {
+    float      * items   = malloc(sizeof(float) * len * STEPPER_PINS);
+    StepperQ15 * fixed   = malloc(sizeof(StepperQ15) * len * STEPPER_PINS);
+    StepperQ15 * quarter = malloc(sizeof(StepperQ15) * STEPPER_QUARTER_LEN(len));
+    uint16_t   * cache   = malloc(sizeof(uint16_t) * len * STEPPER_PINS);
+    if (!items || !fixed || !quarter || !cache) panic("bench: out of memory");
+
+    PWMSequence float_seq = stepper_generate_seq(len, items);
+    PWMSequence fixed_seq = float_seq;
+    stepper_seq_to_fixed(&fixed_seq, fixed);
+    PWMSequence quarter_seq = stepper_generate_quarter_seq(len, quarter);
+
+    Stepper float_stepper, fixed_stepper, quarter_stepper, cached_stepper;
+    stepper_init_with_seq(&float_stepper, rpins, float_seq);
+    stepper_init_with_seq(&fixed_stepper, rpins, fixed_seq);
+    stepper_init_with_seq(&quarter_stepper, rpins, quarter_seq);
+    stepper_init_with_seq(&cached_stepper, rpins, fixed_seq);
+    stepper_use_level_cache(&cached_stepper, cache);
+
+    add_result(report, "stepper_step/float", len, calls, time_steps(&float_stepper, calls));
+    add_result(report, "stepper_step/fixed", len, calls, time_steps(&fixed_stepper, calls));
+    add_result(report, "stepper_step/quarter", len, calls, time_steps(&quarter_stepper, calls));
+    BenchResult * step = add_result(report, "stepper_step/cached", len, calls, time_steps(&cached_stepper, calls));
+    add_result(report, "stepper_step/cached_ramp", len, calls, time_ramp_steps(&cached_stepper, calls));
+
+    // `stepper_levels` of a float table is `state_to_levels` plus clamping
+    add_result(report, "state_to_levels", len, calls, time_levels(&float_stepper, calls));
+    add_result(report, "stepper_set_pins", len, calls, time_set_pins(&cached_stepper, calls));
+
+    uint32_t slow_calls = MAX(calls / 1000, 4);
+    add_result(report, "stepper_generate_seq", len, slow_calls, time_generate(len, items, slow_calls));
+
+    BenchResult * task = add_result(report, "ddrive_task", len, slow_calls, time_ddrive(report, len, slow_calls));
+
+    stepper_stop(&float_stepper);
+    free(items);
+    free(fixed);
+    free(quarter);
+    free(cache);
+
+    if (step && task && report->rate_count < BENCH_MAX_RESULTS) {
+        BenchRate * rate    = &report->rates[report->rate_count++];
+        rate->steps_pr_seq  = len;
+        rate->one_motor     = 1e9f / step->ns;
+        rate->two_motors    = 1e9f * len / task->ns;
+    }
+}
+
+void bench_run(BenchReport * report, uint32_t calls) {
+    *report = (BenchReport){0};
+    report->on_device = PICO_ON_DEVICE;
+    report->clk_hz    = clock_get_hz(clk_sys);
+
+    calls = MAX(calls / BATCH, 1) * BATCH;
+
+    clock_start();
+
+    for (uint len = FULL_STEP; len <= BENCH_MAX_SEQ; len *= 2) {
+        bench_seq(report, len, calls);
+    }
+}
+
+// ==================== OUTPUT ====================
+
+size_t bench_format_json(const BenchReport * report, char * buf, size_t len) {
+    size_t n = 0;
+
+#define APPEND(...) n += snprintf(buf + MIN(n, len), len - MIN(n, len), __VA_ARGS__)
+
+    APPEND("{\"target\": \"%s\", \"clk_hz\": %lu, \"results\": [",
+           report->on_device ? "rp2040" : "host", (unsigned long)report->clk_hz);
+
+    for (uint i = 0; i < report->result_count; i++) {
+        const BenchResult * r = &report->results[i];
+        APPEND("%s\n  {\"name\": \"%s\", \"steps_pr_seq\": %u, \"calls\": %lu, \"ns\": %.1f, \"cycles\": %.1f}",
+               i ? "," : "", r->name, r->steps_pr_seq, (unsigned long)r->calls, r->ns, r->cycles);
+    }
+
+    APPEND("\n], \"max_steps_pr_sec\": [");
+
+    for (uint i = 0; i < report->rate_count; i++) {
+        const BenchRate * r = &report->rates[i];
+        APPEND("%s\n  {\"steps_pr_seq\": %u, \"one_motor\": %.0f, \"two_motors\": %.0f}",
+               i ? "," : "", r->steps_pr_seq, r->one_motor, r->two_motors);
+    }
+
+    APPEND("\n]}\n");
+
+#undef APPEND
+
+    return n;
+}
@@ -0,0 +1,67 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <pico/stdlib.h>
+
+/*
+ * Microbenchmarks of the stepper hot paths.
+ *
+ * Only built with the `STEPPER_BENCH` CMake option. On the PICO the cost is
+ * measured in clk_sys cycles with the SysTick counter. On the host it is
+ * measured in ns and modelled as cycles at the RP2040 clk_sys, which only
+ * tells how the paths compare, not what they cost on the PICO.
+ */
+
+/*
+ * Maximum number of results of a benchmark run.
+ */
+#define BENCH_MAX_RESULTS 64
+
+/*
+ * Cost of a single call of a benchmarked function.
+ */
+typedef struct {
+    const char * name;
+    uint steps_pr_seq;
+    uint32_t calls;
+    float ns;     // Per call
+    float cycles; // Per call, at clk_sys
+} BenchResult;
+
+/*
+ * Sustainable step rates of a sequence length, derived from the results.
+ */
+typedef struct {
+    uint steps_pr_seq;
+    float one_motor; // Steps/s of `stepper_step` with a cached level table
+    float two_motors; // Steps/s of each motor in `ddrive_task`
+} BenchRate;
+
+typedef struct {
+    bool on_device;
+    uint32_t clk_hz;
+
+    BenchResult results[BENCH_MAX_RESULTS];
+    uint result_count;
+
+    BenchRate rates[BENCH_MAX_RESULTS];
+    uint rate_count;
+} BenchReport;
+
+/*
+ * Run all benchmarks for every `StepperStepping` mode and longer sequences
+ * up to 256 steps. Cheap paths are called `calls` times per sequence length.
+ *
+ * Uses the PWM slices of GPIO 0-7, which must not drive anything.
+ */
+void bench_run(BenchReport * report, uint32_t calls);
+
+/*
+ * Format a report as JSON.
+ *
+ * Returns the length of the full output, which is truncated if it does not
+ * fit in `len`, like `snprintf`.
+ */
+size_t bench_format_json(const BenchReport * report, char * buf, size_t len);
+
+#endif // BENCH_H
@@ -0,0 +1,72 @@
+#include <pico/stdlib.h>
+#include <pico/multicore.h>
+#include <hardware/sync.h>
+
+#include "core1_runtime.h"
+
+// Words pushed by core 1 through the inter-core FIFO
+#define CORE1_STARTED 0x53544152u
+#define CORE1_STOPPED 0x53544f50u
+
+static Core1Task task;
+static void * task_ctx;
+
+static volatile bool active;
+static volatile bool stop_requested;
+static volatile uint32_t loops;
+
+static void core1_main(void) {
+    // Let core 0 pause this core while it writes to flash. From here on the
+    // FIFO from core 0 belongs to the lockout handler, so only push.
+    multicore_lockout_victim_init();
+    multicore_fifo_push_blocking(CORE1_STARTED);
+
+    while (!stop_requested) {
+        task(task_ctx);
+        loops = loops + 1;
+    }
+
+    multicore_fifo_push_blocking(CORE1_STOPPED);
+}
+
+// Wait for a word from core 1, dropping anything else left in the FIFO
+static void wait_for(uint32_t word) {
+    while (multicore_fifo_pop_blocking() != word);
+}
+
+bool core1_runtime_start(Core1Task core1_task, void * ctx) {
+    if (active) return false;
+
+    task           = core1_task;
+    task_ctx       = ctx;
+    loops          = 0;
+    stop_requested = false;
+
+    multicore_reset_core1();
+    multicore_launch_core1(core1_main);
+    wait_for(CORE1_STARTED);
+
+    active = true;
+    return true;
+}
+
+void core1_runtime_stop(void) {
+    if (!active) return;
+
+    stop_requested = true;
+
+    // Wake the task if it sleeps in `__wfe`
+    __sev();
+    wait_for(CORE1_STOPPED);
+    multicore_reset_core1();
+
+    active = false;
+}
+
+bool core1_runtime_active(void) {
+    return active;
+}
+
+uint32_t core1_runtime_loops(void) {
+    return loops;
+}
@@ -0,0 +1,44 @@
+#ifndef CORE1_RUNTIME_H
+#define CORE1_RUNTIME_H
+
+#include <pico/stdlib.h>
+
+/*
+ * Called in a loop on core 1 by the runtime. Must return regularly so the
+ * runtime can be stopped.
+ */
+typedef void (*Core1Task)(void * ctx);
+
+/*
+ * Run `task` in a loop on core 1, launched with `multicore_launch_core1`.
+ *
+ * Core 1 runs plain C only, so a task is never paused by an interpreter or
+ * garbage collector on core 0. Data is shared with core 0 through memory,
+ * for example the command queue of a differential drive, and core 1 reports
+ * starting and stopping through the inter-core FIFO.
+ *
+ * Core 1 is set up as a `multicore_lockout` victim, so core 0 can pause it
+ * while writing to flash.
+ *
+ * Core 1 must not be used by anything else, such as MicroPython threads.
+ * Returns false if the runtime is already running.
+ */
+bool core1_runtime_start(Core1Task task, void * ctx);
+
+/*
+ * Stop the runtime after the current task call and reset core 1. Blocks
+ * until core 1 has stopped.
+ */
+void core1_runtime_stop(void);
+
+/*
+ * Returns true while the runtime is running.
+ */
+bool core1_runtime_active(void);
+
+/*
+ * Number of task calls since the runtime was started.
+ */
+uint32_t core1_runtime_loops(void);
+
+#endif // CORE1_RUNTIME_H
@@ -0,0 +1,83 @@
+#ifndef DDA_H
+#define DDA_H
+
+#include <pico/stdlib.h>
+
+/*
+ * Maximum number of axes of a DDA.
+ */
+#define DDA_MAX_AXES 8
+
+/*
+ * Integer digital differential analyzer (Bresenham) step distributor.
+ *
+ * Every tick, each axis adds its rate to an accumulator and steps when the
+ * accumulator reaches `major`, the largest rate. The fastest axis therefore
+ * steps every tick, and over `n` ticks an axis with rate `r` steps exactly
+ * `floor((acc0 + n * r) / major)` times. The error never exceeds one step,
+ * no matter how long the DDA runs.
+ *
+ * Rates must be below 2^31.
+ */
+typedef struct {
+    uint axes;
+    uint32_t rates[DDA_MAX_AXES];
+    uint32_t acc[DDA_MAX_AXES];
+    uint32_t major;
+} Dda;
+
+static inline void dda_init(Dda * dda, uint axes) {
+    *dda = (Dda){0};
+    dda->axes = MIN(axes, DDA_MAX_AXES);
+}
+
+/*
+ * Set the relative step rates of all axes.
+ *
+ * The fractional step progress of each axis is kept. If the largest rate
+ * changes, the accumulators are rescaled to it, rounding to the nearest
+ * `1 / major` of a step.
+ */
+static inline void dda_set_rates(Dda * dda, const uint32_t * rates) {
+    uint32_t major = 0;
+    for (uint i = 0; i < dda->axes; i++) major = MAX(major, rates[i]);
+
+    for (uint i = 0; i < dda->axes; i++) {
+        dda->rates[i] = rates[i];
+
+        if (!major) continue;
+
+        if (dda->major == 0) {
+            // Start half way, centering the steps of the slower axes
+            dda->acc[i] = major / 2;
+        } else if (major != dda->major) {
+            dda->acc[i] = ((uint64_t)dda->acc[i] * major + dda->major / 2) / dda->major;
+            if (dda->acc[i] >= major) dda->acc[i] = major - 1;
+        }
+    }
+
+    // Keep the progress while stopped, so a restart continues from it
+    if (major) dda->major = major;
+}
+
+/*
+ * Advance the DDA by one tick.
+ *
+ * Returns a bit mask of the axes that should step.
+ */
+static inline uint32_t dda_tick(Dda * dda) {
+    uint32_t mask = 0;
+    if (!dda->major) return mask;
+
+    for (uint i = 0; i < dda->axes; i++) {
+        dda->acc[i] += dda->rates[i];
+        if (dda->acc[i] >= dda->major) {
+            dda->acc[i] -= dda->major;
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+}
+
+#endif // DDA_H
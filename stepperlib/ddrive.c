@@ -1,4 +1,5 @@
 #include <hardware/gpio.h>
+#include <hardware/sync.h>
 #include <pico/time.h>
 #include <math.h>
 #include <pico/stdlib.h>
@@ -7,32 +8,246 @@
 #include "ddrive.h"
 #include "interp.h"
 #include "stepper.h"
+#include "seq_registry.h"
+#include "core1_runtime.h"
 
 #define CLAMP(x, lower, upper) ((x) < (lower) ? (lower) : ((x) > (upper) ? (upper) : (x)))
 
-void ddrive_init(DiffDrive * ddrive, int * lpins, int * rpins, size_t steps_pr_seq) {
-    float * buf = malloc(sizeof(float) * steps_pr_seq * STEPPER_PINS);
-    PWMSequence seq = stepper_generate_seq(steps_pr_seq, buf);
+// DDA axes and step timer channels of the motors
+#define RAXIS 0
+#define LAXIS 1
+
+bool ddrive_init(DiffDrive * ddrive, int * lpins, int * rpins, size_t steps_pr_seq) {
+    // One reference for each stepper
+    PWMSequence seq = seq_registry_acquire(steps_pr_seq, SEQ_WAVE_HALF_SINE);
+    if (!seq.length) return false;
+    if (!seq_registry_acquire(steps_pr_seq, SEQ_WAVE_HALF_SINE).length) {
+        seq_registry_release(seq);
+        return false;
+    }
+
     ddrive_init_with_seq(ddrive, lpins, rpins, seq);
+
+    // The caches are optional, a stepper without one computes every step
+    uint16_t * lcache = malloc(sizeof(uint16_t) * stepper_level_cache_len(seq));
+    uint16_t * rcache = malloc(sizeof(uint16_t) * stepper_level_cache_len(seq));
+    if (lcache) stepper_use_level_cache(&ddrive->lstepper, lcache);
+    if (rcache) stepper_use_level_cache(&ddrive->rstepper, rcache);
+    return true;
 }
 
 void ddrive_init_with_seq(DiffDrive * ddrive, int * lpins, int * rpins, PWMSequence seq) {
     stepper_init_with_seq(&ddrive->lstepper ,lpins, seq);
     stepper_init_with_seq(&ddrive->rstepper, rpins, seq);
 
+    // Coarser sequences for high speeds. The constant tables are not allocated.
+    uint count = sizeof(DDRIVE_RESOLUTIONS) / sizeof(DDRIVE_RESOLUTIONS[0]);
+    stepper_use_resolutions(&ddrive->lstepper, DDRIVE_RESOLUTIONS, count);
+    stepper_use_resolutions(&ddrive->rstepper, DDRIVE_RESOLUTIONS, count);
+
+    // Steps of both motors take effect on the same PWM wrap
+    stepper_sync_slices(stepper_slice_mask(&ddrive->lstepper) | stepper_slice_mask(&ddrive->rstepper));
+
     ddrive->lrpm     = 0;
     ddrive->rrpm     = 0;
 
-    ddrive->linterp   = (Interp){0};
-    ddrive->rinterp   = (Interp){0};
+    ddrive->linterp   = (SCurve){0};
+    ddrive->rinterp   = (SCurve){0};
+
+    dda_init(&ddrive->dda, DDRIVE_AXES);
+    ddrive->tick_time = 0;
+
+    float steps_pr_rev = seq.length * STEPPER_SEQS_PER_REV;
+    planner_init(&ddrive->planner,
+            DDRIVE_DEFAULT_ACCEL * steps_pr_rev / 60,
+            DDRIVE_JUMP_RPM * steps_pr_rev / 60);
+
+    ddrive->cmds.head = 0;
+    ddrive->cmds.tail = 0;
+    ddrive->max_latency_us = 0;
+
+    ddrive->stream = (DiffDriveStream){0};
+
+    ddrive->hold_level = 0;
+    ddrive->release_ms = 0;
+    ddrive->idle       = false;
+    ddrive->released   = true;
+    ddrive->idle_since = 0;
+
+    ddrive->timer_active = false;
+    ddrive->control_us   = 0;
+    ddrive->core1_active = false;
+
+    ddrive->moves_sent = 0;
+    ddrive->moves_done = 0;
+    ddrive->move_id    = 0;
+
+    odometry_init(&ddrive->odometry);
+}
+
+void ddrive_deinit(DiffDrive * ddrive) {
+    ddrive_stop_core1(ddrive);
+    ddrive_stop_timer(ddrive);
+    stepper_deinit(&ddrive->rstepper);
+    stepper_deinit(&ddrive->lstepper);
+}
+
+// ==================== COMMAND QUEUE ====================
+
+static bool queue_push(DiffDriveCmdQueue * q, DiffDriveCmd * cmd) {
+    uint32_t head = q->head;
+    if (head - q->tail >= DDRIVE_CMD_QUEUE_LEN) return false;
+
+    q->items[head % DDRIVE_CMD_QUEUE_LEN] = *cmd;
+
+    // Publish the item before the new head
+    __dmb();
+    q->head = head + 1;
+    return true;
+}
+
+static bool queue_peek(DiffDriveCmdQueue * q, DiffDriveCmd * cmd) {
+    uint32_t tail = q->tail;
+    if (tail == q->head) return false;
+
+    // Read the item only after observing the head that published it
+    __dmb();
+    *cmd = q->items[tail % DDRIVE_CMD_QUEUE_LEN];
+    return true;
+}
+
+static void queue_drop(DiffDriveCmdQueue * q) {
+    // Finish reading the item before handing the slot back
+    __dmb();
+    q->tail = q->tail + 1;
+}
+
+// Settings change how the drive moves, and leave the motion alone
+static bool is_setting(DiffDriveCmdType type) {
+    return type == DDRIVE_ACCEL || type == DDRIVE_ODOMETRY || type == DDRIVE_IDLE;
+}
+
+// A motion command other than a segment is queued behind the head
+static bool motion_queued(DiffDriveCmdQueue * q) {
+    uint32_t head = q->head;
+
+    // Read the items only after observing the head that published them
+    __dmb();
+    for (uint32_t i = q->tail + 1; i != head; i++) {
+        DiffDriveCmdType type = q->items[i % DDRIVE_CMD_QUEUE_LEN].type;
+        if (type != DDRIVE_SEGMENT && !is_setting(type)) return true;
+    }
+    return false;
+}
+
+// The step timer has no planner to run the segment at the head of the queue,
+// and a motion command queued behind it drops it anyway
+static bool drop_segment(DiffDrive * ddrive) {
+    return ddrive->timer_active || motion_queued(&ddrive->cmds);
+}
+
+static void handle_queued_commands(DiffDrive * ddrive) {
+    DiffDriveCmd cmd;
+    while (queue_peek(&ddrive->cmds, &cmd)) {
+        if (cmd.type == DDRIVE_SEGMENT && drop_segment(ddrive)) {
+            queue_drop(&ddrive->cmds);
+            continue;
+        }
+
+        // Leave segments queued until the planner has room
+        if (cmd.type == DDRIVE_SEGMENT && !planner_ready(&ddrive->planner)) break;
+
+        ddrive_handle_command(ddrive, &cmd);
+        queue_drop(&ddrive->cmds);
+
+        if (cmd.type == DDRIVE_SEGMENT) continue;
+        uint32_t latency = time_us_32() - cmd.sent_us;
+        if (latency > ddrive->max_latency_us) ddrive->max_latency_us = latency;
+    }
+}
+
+// A command can be applied, or a stream was started. Segments wait for room
+// in the planner, unless they are dropped.
+static bool command_pending(DiffDrive * ddrive) {
+    DiffDriveCmdQueue * q = &ddrive->cmds;
+    uint32_t tail = q->tail;
+
+    if (tail == q->head) return ddrive->stream.tail != ddrive->stream.head && !ddrive->stream.running;
+
+    __dmb();
+    return q->items[tail % DDRIVE_CMD_QUEUE_LEN].type != DDRIVE_SEGMENT ||
+           planner_ready(&ddrive->planner) || drop_segment(ddrive);
+}
+
+// Have the stepping pick up a command or stream now. The task loop sleeps
+// while idle until an event, and the step timer would wait for its next
+// control period.
+static void wake(DiffDrive * ddrive) {
+    __sev();
+    if (ddrive->timer_active) step_timer_request_control(&ddrive->timer);
+}
+
+bool ddrive_try_send(DiffDrive * ddrive, DiffDriveCmd cmd) {
+    cmd.stream_head = ddrive->stream.head;
+    cmd.sent_us     = time_us_32();
+    if (!queue_push(&ddrive->cmds, &cmd)) return false;
+
+    wake(ddrive);
+    return true;
+}
+
+bool ddrive_ready(DiffDrive * ddrive) {
+    return ddrive->cmds.head - ddrive->cmds.tail < DDRIVE_CMD_QUEUE_LEN;
+}
+
+uint32_t ddrive_max_latency(DiffDrive * ddrive, bool reset) {
+    uint32_t latency = ddrive->max_latency_us;
+    if (reset) ddrive->max_latency_us = 0;
+    return latency;
+}
+
+// ==================== STREAM ====================
+
+bool ddrive_stream(DiffDrive * ddrive, const int16_t * samples, uint32_t count, uint32_t dt_us) {
+    DiffDriveStream * stream = &ddrive->stream;
+
+    uint32_t head = stream->head;
+    if (head - stream->tail >= DDRIVE_STREAM_BUFS) return false;
+    if (!count || !dt_us) return true;
+
+    stream->bufs[head % DDRIVE_STREAM_BUFS] = (DiffDriveStreamBuf){
+        .samples = samples,
+        .count   = count,
+        .dt_us   = dt_us,
+    };
+
+    // Publish the buffer before the new head
+    __dmb();
+    stream->head = head + 1;
+    wake(ddrive);
+    return true;
+}
+
+uint ddrive_stream_free(DiffDrive * ddrive) {
+    return DDRIVE_STREAM_BUFS - (ddrive->stream.head - ddrive->stream.tail);
+}
+
+// Hand back the buffers before `head`, stopping if one of them was playing
+static void stream_drop(DiffDriveStream * stream, uint32_t head) {
+    if ((int32_t)(head - stream->tail) <= 0) return;
 
-    ddrive->new_cmd_available = false;
-    ddrive->next_cmd = DDRIVE_CMD_STOP;
+    // Finish reading the samples before handing the buffers back
+    __dmb();
+    stream->tail    = head;
+    stream->running = false;
 }
 
+// ==================== CONTROL ====================
+
 static void stop_interpolators(DiffDrive * ddrive) {
-    ddrive->rinterp.running = false;
-    ddrive->linterp.running = false;
+    ddrive->rinterp.interp.running = false;
+    ddrive->linterp.interp.running = false;
+    ddrive->interp_active = false;
 }
 
 static void trans_rot_to_rpm(float trans, float rot, float * lrpm, float * rrpm) {
@@ -49,7 +264,41 @@ static void trans_rot_to_rpm(float trans, float rot, float * lrpm, float * rrpm)
     *lrpm += trans;
 }
 
+// Steps per revolution of planned segments, which run at the finest resolution
+static float steps_pr_rev(DiffDrive * ddrive) {
+    return ddrive->rstepper.resolutions[0].length * STEPPER_SEQS_PER_REV;
+}
+
+// The running move or ramp, if any, has reached its target or was dropped
+static void finish_move(DiffDrive * ddrive) {
+    if (ddrive->moves_done == ddrive->move_id) return;
+
+    // Publish the id before waking whoever waits for it
+    ddrive->moves_done = ddrive->move_id;
+    __dmb();
+    __sev();
+}
+
+// Advance the ramps by `us`, finishing the ramp once both are done
+static void tick_interpolators(DiffDrive * ddrive, uint64_t us) {
+    bool rrunning = scurve_tick(&ddrive->rinterp, us);
+    bool lrunning = scurve_tick(&ddrive->linterp, us);
+    if (ddrive->interp_active && !rrunning && !lrunning) finish_move(ddrive);
+    ddrive->interp_active = rrunning || lrunning;
+}
+
 void ddrive_handle_command(DiffDrive * ddrive, DiffDriveCmd * cmd) {
+    // Planned segments only continue with more segments
+    if (cmd->type != DDRIVE_SEGMENT && !is_setting(cmd->type)) {
+        planner_clear(&ddrive->planner);
+        finish_move(ddrive);
+    }
+
+    // Commands take over from the buffers streamed before them
+    if (!is_setting(cmd->type)) {
+        stream_drop(&ddrive->stream, cmd->stream_head);
+    }
+
     switch (cmd->type) {
         case DDRIVE_LEFT_RIGHT:
             stop_interpolators(ddrive);
@@ -62,167 +311,608 @@ void ddrive_handle_command(DiffDrive * ddrive, DiffDriveCmd * cmd) {
             break;
         case DDRIVE_TRAPEZOID: {
             uint64_t time_us = cmd->time * 1e6;
-            interp_start(&ddrive->rinterp, ddrive->rrpm, cmd->rtarget, time_us);
-            interp_start(&ddrive->linterp, ddrive->lrpm, cmd->ltarget, time_us);
+            uint64_t jerk_us = cmd->jerk * 1e6;
+            scurve_start(&ddrive->rinterp, ddrive->rrpm, cmd->rtarget, time_us, jerk_us);
+            scurve_start(&ddrive->linterp, ddrive->lrpm, cmd->ltarget, time_us, jerk_us);
+            ddrive->interp_active = true;
+            ddrive->move_id       = cmd->ramp_id;
         } break;
         case DDRIVE_STOP:
             stop_interpolators(ddrive);
-            ddrive->rrpm = 0;
-            ddrive->lrpm = 0;
+            ddrive->rrpm     = 0;
+            ddrive->lrpm     = 0;
+            ddrive->released = true;
             stepper_stop(&ddrive->rstepper);
             stepper_stop(&ddrive->lstepper);
             break;
+        case DDRIVE_SEGMENT: {
+            stop_interpolators(ddrive);
+            int32_t steps[PLANNER_AXES];
+            steps[RAXIS] = lroundf(cmd->rrev * steps_pr_rev(ddrive));
+            steps[LAXIS] = lroundf(cmd->lrev * steps_pr_rev(ddrive));
+            planner_add(&ddrive->planner, steps, cmd->seg_rpm * steps_pr_rev(ddrive) / 60);
+        } break;
+        case DDRIVE_ACCEL:
+            planner_set_accel(&ddrive->planner, cmd->accel * steps_pr_rev(ddrive) / 60);
+            break;
+        case DDRIVE_MOVE: {
+            stop_interpolators(ddrive);
+            int32_t steps[PLANNER_AXES];
+            steps[RAXIS] = cmd->rsteps;
+            steps[LAXIS] = cmd->lsteps;
+
+            // A move without steps is done right away
+            ddrive->move_id = cmd->move_id;
+            if (!planner_add(&ddrive->planner, steps, cmd->move_rpm * steps_pr_rev(ddrive) / 60)) finish_move(ddrive);
+        } break;
+        case DDRIVE_ODOMETRY: {
+            float step_length = 2 * M_PI * cmd->wheel_radius / steps_pr_rev(ddrive);
+            odometry_configure(&ddrive->odometry, step_length, cmd->track_width);
+        } break;
+        case DDRIVE_IDLE:
+            ddrive->hold_level = MIN(cmd->hold_level, PWM_MAX);
+            ddrive->release_ms = cmd->release_ms;
+            break;
+    }
+}
+
+// ==================== IDLE ====================
+
+// Hold a stopped motor at its current step, or release it
+static void stop_wheel(DiffDrive * ddrive, Stepper * stepper) {
+    stepper_hold(stepper, ddrive->released ? 0 : ddrive->hold_level);
+}
+
+// A motor moves, so stopped motors are held again
+static void leave_idle(DiffDrive * ddrive) {
+    ddrive->idle     = false;
+    ddrive->released = false;
+}
+
+// Both motors are stopped at `now`. Releases the coils once they have been
+// held for `release_ms`. Returns the time they are to be released at, or
+// zero if they are released or held until the next command.
+static uint64_t update_idle(DiffDrive * ddrive, uint64_t now) {
+    if (!ddrive->idle) {
+        ddrive->idle       = true;
+        ddrive->idle_since = now;
+    }
+
+    if (ddrive->released || !ddrive->hold_level || !ddrive->release_ms) return 0;
+
+    uint64_t release = ddrive->idle_since + (uint64_t)ddrive->release_ms * 1000;
+    if (now < release) return release;
+
+    ddrive->released = true;
+    stepper_stop(&ddrive->rstepper);
+    stepper_stop(&ddrive->lstepper);
+    return 0;
+}
+
+// The stream ran dry, stop the motors
+static void stream_stop(DiffDrive * ddrive) {
+    ddrive->stream.running = false;
+    ddrive->rrpm = 0;
+    ddrive->lrpm = 0;
+}
+
+// Pick up the setpoints of the current sample of the stream. Returns the
+// time left of the sample, or zero if there is nothing streaming.
+static uint32_t stream_update(DiffDrive * ddrive) {
+    DiffDriveStream * stream = &ddrive->stream;
+
+    if (stream->tail == stream->head) {
+        if (stream->running) stream_stop(ddrive);
+        return 0;
+    }
+
+    // Read the buffer only after observing the head that published it
+    __dmb();
+    uint64_t now = time_us_64();
+
+    if (!stream->running) {
+        planner_clear(&ddrive->planner);
+        finish_move(ddrive);
+        stop_interpolators(ddrive);
+        stream->running  = true;
+        stream->start_us = now;
     }
+
+    const DiffDriveStreamBuf * buf = &stream->bufs[stream->tail % DDRIVE_STREAM_BUFS];
+    uint64_t end = stream->start_us + (uint64_t)buf->count * buf->dt_us;
+
+    // Hand back played buffers, the next one starting where they end
+    while (now >= end) {
+        __dmb();
+        stream->tail     = stream->tail + 1;
+        stream->start_us = end;
+
+        if (stream->tail == stream->head) {
+            stream_stop(ddrive);
+            return 0;
+        }
+
+        __dmb();
+        buf = &stream->bufs[stream->tail % DDRIVE_STREAM_BUFS];
+        end = stream->start_us + (uint64_t)buf->count * buf->dt_us;
+    }
+
+    uint32_t index = (now - stream->start_us) / buf->dt_us;
+    ddrive->rrpm = buf->samples[2 * index]     / DDRIVE_STREAM_RPM_SCALE;
+    ddrive->lrpm = buf->samples[2 * index + 1] / DDRIVE_STREAM_RPM_SCALE;
+
+    return stream->start_us + (uint64_t)(index + 1) * buf->dt_us - now;
 }
 
+// Longest time `ddrive_task` steps before handling commands again
 const uint MAX_SEQ_US  = 10000;
 const uint ZERO_STEP_US = 100;
 
-void ddrive_task(DiffDrive * ddrive) {
+// One microsecond in the fixed-point time of the step clock
+#define TICK_US (1ull << STEP_TIMER_FRAC_BITS)
+
+static uint64_t fine_now(void) {
+    return time_us_64() << STEP_TIMER_FRAC_BITS;
+}
+
+// Fixed-point period of a step rate. Float keeps the rate to 24 bits.
+static uint64_t steps_to_period(float steps_pr_sec) {
+    return MAX((float)(1e6 * TICK_US) / steps_pr_sec, TICK_US);
+}
+
+// Deadline of the next step, `period` after the latest one. Restarts from
+// now if the clock fell behind by more than a step, after idling or a slow
+// command, rather than catching up with a burst of steps.
+static uint64_t next_tick(DiffDrive * ddrive, uint64_t period) {
+    uint64_t next = ddrive->tick_time + period;
+    uint64_t now  = fine_now();
+    return next + period < now ? now : next;
+}
 
-    // Handle new command if available
-    if (ddrive->new_cmd_available) {
-        ddrive_handle_command(ddrive, &ddrive->next_cmd);
-        ddrive->new_cmd_available = false;
+// Wait for a time of the step clock, checking for commands on the way.
+// Returns false as soon as one can be applied.
+static bool wait_until(DiffDrive * ddrive, uint64_t time) {
+    uint64_t until = time >> STEP_TIMER_FRAC_BITS;
+    while (time_us_64() < until) {
+        if (command_pending(ddrive)) return false;
+        busy_wait_until(from_us_since_boot(MIN(until, time_us_64() + DDRIVE_CMD_POLL_US)));
     }
+    return !command_pending(ddrive);
+}
 
-    static float fast_rpm, slow_rpm, us_pr_step, ratio;
-    static bool fast_dir, slow_dir;
+// Wait for the deadline of a step. Steps land on the microsecond, and the
+// fractions carry over to the deadlines after it. A command cuts the wait
+// short, leaving the deadline pending, and returns false.
+static bool wait_tick(DiffDrive * ddrive, uint64_t deadline) {
+    if (!wait_until(ddrive, deadline)) return false;
+    ddrive->tick_time = deadline;
+    return true;
+}
+
+// Step rate of a motor at the resolution in use
+static float rpm_to_steps_pr_sec(Stepper * stepper, float rpm) {
+    uint steps_pr_rev = stepper->sequence.length * STEPPER_SEQS_PER_REV;
+    return steps_pr_rev * fabs(rpm) / 60;
+}
+
+// Integer DDA rate of a motor, in milli-steps per second
+static uint32_t steps_to_dda_rate(float steps_pr_sec) {
+    return steps_pr_sec * 1000;
+}
+
+// Switch to a coarser sequence at high speed, bounding the step rate
+static void update_resolution(Stepper * stepper, float rpm) {
+    stepper_update_resolution(stepper, fabsf(rpm) * STEPPER_SEQS_PER_REV / 60);
+}
 
-    static Stepper * fast_stepper;
-    static Stepper * slow_stepper;
+static uint16_t rpm_to_level(float rpm) {
+    float    t     = (fabs(rpm) - DDRIVE_MIN_PWM_SPEED) / (DDRIVE_MAX_PWM_SPEED - DDRIVE_MIN_PWM_SPEED);
+    uint16_t level = (PWM_MAX - PWM_MIN) * t + PWM_MIN;
+    return CLAMP(level, PWM_MIN, PWM_MAX);
+}
+
+static void run_planner(DiffDrive * ddrive) {
+    Planner * planner = &ddrive->planner;
+
+    uint steps_pr_seq = ddrive->rstepper.sequence.length;
+
+    for (int i = 0; i < steps_pr_seq && planner_active(planner); i++) {
+        // The rate follows the ramps step by step, and the axes of a new
+        // segment take over from its first step
+        uint64_t period = steps_to_period(planner_rate(planner));
+        ddrive->rrpm    = planner_axis_rate(planner, RAXIS) * 60 / steps_pr_rev(ddrive);
+        ddrive->lrpm    = planner_axis_rate(planner, LAXIS) * 60 / steps_pr_rev(ddrive);
+        uint16_t rlevel = rpm_to_level(ddrive->rrpm);
+        uint16_t llevel = rpm_to_level(ddrive->lrpm);
+
+        STEP_STATS_EXPECT(&ddrive->rstepper, ddrive->rrpm ? 1e6 / fabsf(planner_axis_rate(planner, RAXIS)) : 0);
+        STEP_STATS_EXPECT(&ddrive->lstepper, ddrive->lrpm ? 1e6 / fabsf(planner_axis_rate(planner, LAXIS)) : 0);
+
+        if (!wait_tick(ddrive, next_tick(ddrive, period))) break;
+
+        bool forward[PLANNER_AXES];
+        uint32_t steps = planner_step(planner, forward);
+
+        if (steps & (1u << RAXIS)) stepper_step(&ddrive->rstepper, forward[RAXIS], rlevel);
+        if (steps & (1u << LAXIS)) stepper_step(&ddrive->lstepper, forward[LAXIS], llevel);
+    }
+
+    // The planner always ends at a stop
+    if (!planner_active(planner)) {
+        ddrive->rrpm = 0;
+        ddrive->lrpm = 0;
+        finish_move(ddrive);
+    }
+}
+
+// Integrate the pose up to the steps made so far. Position counts are in
+// steps of the finest sequence, which planned segments also count in.
+static void update_odometry(DiffDrive * ddrive) {
+    odometry_update(&ddrive->odometry, ddrive->rstepper.position, ddrive->lstepper.position);
+}
+
+// Sleep while idle until a command is sent, which sends an event, or the
+// coils are to be released. Returns at least every `MAX_SEQ_US`.
+static void idle_wait(DiffDrive * ddrive) {
+    uint64_t now     = time_us_64();
+    uint64_t release = update_idle(ddrive, now);
+    uint64_t until   = release ? MIN(release, now + MAX_SEQ_US) : now + MAX_SEQ_US;
+
+    // An event sent between the check and the sleep ends the sleep at once
+    while (!command_pending(ddrive)) {
+        if (best_effort_wfe_or_timeout(from_us_since_boot(until))) break;
+    }
+}
+
+static void task_loop(DiffDrive * ddrive) {
+
+    // Handle queued commands
+    handle_queued_commands(ddrive);
+
+    // Streamed setpoints take over until the end of their sample
+    uint32_t sample_us = stream_update(ddrive);
+
+    // Planned segments take over until they are done. Their steps are
+    // counted at the finest resolution.
+    if (planner_active(&ddrive->planner)) {
+        leave_idle(ddrive);
+        stepper_set_resolution(&ddrive->rstepper, 0);
+        stepper_set_resolution(&ddrive->lstepper, 0);
+        run_planner(ddrive);
+        return;
+    }
 
     // Update RPMs if interpolating
-    if (ddrive->rinterp.running) ddrive->rrpm = interp_value(&ddrive->rinterp);
-    if (ddrive->linterp.running) ddrive->lrpm = interp_value(&ddrive->linterp);
+    if (ddrive->rinterp.interp.running) ddrive->rrpm = scurve_value(&ddrive->rinterp);
+    if (ddrive->linterp.interp.running) ddrive->lrpm = scurve_value(&ddrive->linterp);
 
-    // Disable steppers if RPM it should not move
-    if (ddrive->rrpm == 0.0) stepper_stop(&ddrive->rstepper);
-    if (ddrive->lrpm == 0.0) stepper_stop(&ddrive->lstepper);
+    // Hold or release the motors that should not move
+    if (ddrive->rrpm == 0.0) stop_wheel(ddrive, &ddrive->rstepper);
+    if (ddrive->lrpm == 0.0) stop_wheel(ddrive, &ddrive->lstepper);
 
     bool rforward = ddrive->rrpm >= 0;
     bool lforward = ddrive->lrpm >= 0;
 
-    float abs_rrpm = fabs(ddrive->rrpm);
-    float abs_lrpm = fabs(ddrive->lrpm);
+    float fast_rpm = MAX(fabs(ddrive->rrpm), fabs(ddrive->lrpm));
 
-    // Determine which stepper is faster for diff drive
-    if (abs_rrpm > abs_lrpm) {
-        fast_stepper = &ddrive->rstepper;
-        fast_dir = rforward;
-        fast_rpm = abs_rrpm;
-
-        slow_stepper = &ddrive->lstepper;
-        slow_rpm = abs_lrpm;
-        slow_dir = lforward;
-    } else {
-        fast_stepper = &ddrive->lstepper;
-        fast_rpm = abs_lrpm;
-        fast_dir = lforward;
-
-        slow_stepper = &ddrive->rstepper;
-        slow_rpm = abs_rrpm;
-        slow_dir = rforward;
+    // Ramps and streams pass through zero, only sleep when nothing runs
+    if (fast_rpm == 0 && !ddrive->interp_active && !ddrive->stream.running) {
+        idle_wait(ddrive);
+        return;
     }
 
     if (fast_rpm == 0) {
-        interp_tick(&ddrive->rinterp, ZERO_STEP_US);
-        interp_tick(&ddrive->linterp, ZERO_STEP_US);
+        tick_interpolators(ddrive, ZERO_STEP_US);
         sleep_us(ZERO_STEP_US);
         return;
     };
 
-    uint steps_pr_seq = ddrive->rstepper.sequence.length;
-    uint steps_pr_rev = steps_pr_seq * STEPPER_SEQS_PER_REV;
-    uint steps_pr_sec = steps_pr_rev * fast_rpm / 60;
-
-    us_pr_step = MIN(1e6 / steps_pr_sec, (float)MAX_SEQ_US / steps_pr_seq);
-    ratio      = slow_rpm / fast_rpm;
+    leave_idle(ddrive);
 
-    // Accumulates the fractional steps for the slow stepper
-    static float step_acc = 0;
+    update_resolution(&ddrive->rstepper, ddrive->rrpm);
+    update_resolution(&ddrive->lstepper, ddrive->lrpm);
 
-    // Update interpolators
-    bool rdone = interp_tick(&ddrive->rinterp, steps_pr_seq * us_pr_step);
-    bool ldone = interp_tick(&ddrive->linterp, steps_pr_seq * us_pr_step);
-    ddrive->interp_active = !(rdone && ldone);
+    float rsteps = rpm_to_steps_pr_sec(&ddrive->rstepper, ddrive->rrpm);
+    float lsteps = rpm_to_steps_pr_sec(&ddrive->lstepper, ddrive->lrpm);
 
+    // The DDA ticks at the step rate of the faster motor, for a sequence
+    float fast_steps  = MAX(rsteps, lsteps);
+    uint steps_pr_seq = (rsteps >= lsteps ? &ddrive->rstepper : &ddrive->lstepper)->sequence.length;
+    uint64_t period   = steps_to_period(fast_steps);
 
-    float    slow_t     = (fabs(slow_rpm) - DDRIVE_MIN_PWM_SPEED) / (DDRIVE_MAX_PWM_SPEED - DDRIVE_MIN_PWM_SPEED);
-    uint16_t slow_level = (PWM_MAX - PWM_MIN) * slow_t + PWM_MIN;
+    // The slower motor skips ticks, stepping at its own rate on average
+    STEP_STATS_EXPECT(&ddrive->rstepper, rsteps ? lroundf(1e6f / rsteps) : 0);
+    STEP_STATS_EXPECT(&ddrive->lstepper, lsteps ? lroundf(1e6f / lsteps) : 0);
 
-    float    fast_t     = (fabs(fast_rpm) - DDRIVE_MIN_PWM_SPEED) / (DDRIVE_MAX_PWM_SPEED - DDRIVE_MIN_PWM_SPEED);
-    uint16_t fast_level = (PWM_MAX - PWM_MIN) * fast_t + PWM_MIN;
+    uint32_t rates[DDRIVE_AXES];
+    rates[RAXIS] = steps_to_dda_rate(rsteps);
+    rates[LAXIS] = steps_to_dda_rate(lsteps);
+    dda_set_rates(&ddrive->dda, rates);
 
-    slow_level = CLAMP(slow_level, PWM_MIN, PWM_MAX);
-    fast_level = CLAMP(fast_level, PWM_MIN, PWM_MAX);
+    uint16_t rlevel = rpm_to_level(ddrive->rrpm);
+    uint16_t llevel = rpm_to_level(ddrive->lrpm);
 
-    for (int i = 0; i < steps_pr_seq; i++) {
-        // Step the fast stepper every iteration
-        stepper_step(fast_stepper, fast_dir, fast_level);
+    size_t rlength = ddrive->rstepper.sequence.length;
+    size_t llength = ddrive->lstepper.sequence.length;
 
-        // Accumulate fractional steps for the slow stepper
-        step_acc += ratio;
+    // Come back for commands, and for the next streamed sample in time
+    uint64_t start = fine_now();
+    uint64_t end   = start + (uint64_t)(sample_us ? MIN(sample_us, MAX_SEQ_US) : MAX_SEQ_US) * TICK_US;
 
-        // Step the slow stepper when enough fractional steps have accumulated
-        if (step_acc >= 1.0f) {
-            step_acc -= 1.0f;
-            stepper_step(slow_stepper, slow_dir, slow_level);
+    int ticks = 0;
+    while (ticks < steps_pr_seq) {
+        uint64_t next = next_tick(ddrive, period);
+        if (next >= end) {
+            wait_until(ddrive, end);
+            break;
         }
+        if (!wait_tick(ddrive, next)) break;
+
+        uint32_t steps = dda_tick(&ddrive->dda);
 
-        sleep_us(us_pr_step);
+        if (steps & (1u << RAXIS)) stepper_step(&ddrive->rstepper, rforward, rlevel);
+        if (steps & (1u << LAXIS)) stepper_step(&ddrive->lstepper, lforward, llevel);
+
+        ticks++;
+
+        // A switch of resolution changes the step rates, start over
+        if (ddrive->rstepper.sequence.length != rlength) break;
+        if (ddrive->lstepper.sequence.length != llength) break;
+    }
+
+    // Update interpolators
+    tick_interpolators(ddrive, (fine_now() - start) >> STEP_TIMER_FRAC_BITS);
+}
+
+void ddrive_task(DiffDrive * ddrive) {
+    task_loop(ddrive);
+    update_odometry(ddrive);
+}
+
+// ==================== STEP TIMER ====================
+
+static void timer_set_wheel(DiffDrive * ddrive, uint channel, Stepper * stepper, float rpm) {
+    if (rpm == 0.0) {
+        step_timer_set(&ddrive->timer, channel, 0, true, 0);
+        stop_wheel(ddrive, stepper);
+        return;
     }
 
+    // The step timer rescales the period when a coarser sequence is switched to
+    update_resolution(stepper, rpm);
+
+    uint64_t period = steps_to_period(rpm_to_steps_pr_sec(stepper, rpm));
+    step_timer_set_fine(&ddrive->timer, channel, period, rpm >= 0, rpm_to_level(rpm));
+}
+
+// Runs from the step timer interrupt every `DDRIVE_CONTROL_US`
+static void timer_control(void * ctx) {
+    DiffDrive * ddrive = ctx;
+    uint64_t now = time_us_64();
+
+    handle_queued_commands(ddrive);
+    stream_update(ddrive);
+
+    if (ddrive->rinterp.interp.running) ddrive->rrpm = scurve_value(&ddrive->rinterp);
+    if (ddrive->linterp.interp.running) ddrive->lrpm = scurve_value(&ddrive->linterp);
+
+    // Commands call in between the periods, so ramps advance by the time
+    // since the previous call
+    tick_interpolators(ddrive, now - ddrive->control_us);
+    ddrive->control_us = now;
+
+    // Hold the stopped motors, and release them after the timeout
+    if (ddrive->rrpm == 0.0 && ddrive->lrpm == 0.0 && !ddrive->interp_active) update_idle(ddrive, now);
+    else leave_idle(ddrive);
+
+    timer_set_wheel(ddrive, RAXIS, &ddrive->rstepper, ddrive->rrpm);
+    timer_set_wheel(ddrive, LAXIS, &ddrive->lstepper, ddrive->lrpm);
+
+    update_odometry(ddrive);
+}
+
+bool ddrive_start_timer(DiffDrive * ddrive) {
+    if (ddrive->timer_active) return true;
+    if (ddrive->core1_active) return false;
+
+    if (!step_timer_init(&ddrive->timer)) return false;
+
+    step_timer_add(&ddrive->timer, &ddrive->rstepper);
+    step_timer_add(&ddrive->timer, &ddrive->lstepper);
+    step_timer_set_control(&ddrive->timer, timer_control, ddrive, DDRIVE_CONTROL_US);
+    ddrive->control_us = time_us_64();
+    step_timer_start(&ddrive->timer);
+
+    ddrive->timer_active = true;
+    return true;
+}
+
+void ddrive_stop_timer(DiffDrive * ddrive) {
+    if (!ddrive->timer_active) return;
+
+    step_timer_deinit(&ddrive->timer);
+    ddrive->timer_active = false;
+}
+
+// ==================== CORE 1 ====================
+
+static void core1_task(void * ctx) {
+    ddrive_task(ctx);
+}
+
+bool ddrive_start_core1(DiffDrive * ddrive) {
+    if (ddrive->core1_active) return true;
+    if (ddrive->timer_active) return false;
+
+    if (!core1_runtime_start(core1_task, ddrive)) return false;
+
+    ddrive->core1_active = true;
+    return true;
+}
+
+void ddrive_stop_core1(DiffDrive * ddrive) {
+    if (!ddrive->core1_active) return;
+
+    core1_runtime_stop();
+    ddrive->core1_active = false;
 }
 
 // ==================== COMMANDS ====================
 static void send_cmd(DiffDrive * ddrive, DiffDriveCmd cmd) {
-    while (ddrive->new_cmd_available);
-    ddrive->next_cmd = cmd;
-    ddrive->new_cmd_available = true;
+    while (!ddrive_try_send(ddrive, cmd));
 }
 
 void ddrive_stop(DiffDrive * ddrive) {
     send_cmd(ddrive, DDRIVE_CMD_STOP);
 }
 
-void ddrive_rpm(DiffDrive * ddrive, float rrpm, float lrpm) {
+static DiffDriveCmd rpm_cmd(float rrpm, float lrpm) {
     DiffDriveCmd cmd = {
         .type  = DDRIVE_LEFT_RIGHT,
         .right = rrpm,
         .left  = lrpm,
     };
-    send_cmd(ddrive, cmd);
+    return cmd;
 }
 
-void ddrive_trans_rot(DiffDrive * ddrive, float trans, float rot) {
+static DiffDriveCmd trans_rot_cmd(float trans, float rot) {
     DiffDriveCmd cmd = {
         .type  = DDRIVE_TRANS_ROTATE,
         .trans = trans,
         .rot   = rot,
     };
+    return cmd;
+}
+
+void ddrive_rpm(DiffDrive * ddrive, float rrpm, float lrpm) {
+    send_cmd(ddrive, rpm_cmd(rrpm, lrpm));
+}
+
+bool ddrive_try_rpm(DiffDrive * ddrive, float rrpm, float lrpm) {
+    return ddrive_try_send(ddrive, rpm_cmd(rrpm, lrpm));
+}
+
+void ddrive_trans_rot(DiffDrive * ddrive, float trans, float rot) {
+    send_cmd(ddrive, trans_rot_cmd(trans, rot));
+}
+
+bool ddrive_try_trans_rot(DiffDrive * ddrive, float trans, float rot) {
+    return ddrive_try_send(ddrive, trans_rot_cmd(trans, rot));
+}
+
+static DiffDriveCmd segment_cmd(float rrev, float lrev, float rpm) {
+    DiffDriveCmd cmd = {
+        .type    = DDRIVE_SEGMENT,
+        .rrev    = rrev,
+        .lrev    = lrev,
+        .seg_rpm = rpm,
+    };
+    return cmd;
+}
+
+bool ddrive_segment(DiffDrive * ddrive, float rrev, float lrev, float rpm) {
+    if (ddrive->timer_active) return false;
+    send_cmd(ddrive, segment_cmd(rrev, lrev, rpm));
+    return true;
+}
+
+bool ddrive_try_segment(DiffDrive * ddrive, float rrev, float lrev, float rpm) {
+    if (ddrive->timer_active) return false;
+    return ddrive_try_send(ddrive, segment_cmd(rrev, lrev, rpm));
+}
+
+static DiffDriveCmd move_cmd(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm) {
+    DiffDriveCmd cmd = {
+        .type     = DDRIVE_MOVE,
+        .rsteps   = rsteps,
+        .lsteps   = lsteps,
+        .move_rpm = rpm,
+        .move_id  = ddrive->moves_sent + 1,
+    };
+    return cmd;
+}
+
+uint32_t ddrive_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm) {
+    if (ddrive->timer_active) return 0;
+    DiffDriveCmd cmd = move_cmd(ddrive, rsteps, lsteps, rpm);
     send_cmd(ddrive, cmd);
+    ddrive->moves_sent = cmd.move_id;
+    return cmd.move_id;
+}
+
+uint32_t ddrive_try_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm) {
+    if (ddrive->timer_active) return 0;
+    DiffDriveCmd cmd = move_cmd(ddrive, rsteps, lsteps, rpm);
+    if (!ddrive_try_send(ddrive, cmd)) return 0;
+    ddrive->moves_sent = cmd.move_id;
+    return cmd.move_id;
 }
 
-bool * ddrive_trap_rpm(DiffDrive * ddrive, float ltarget, float rtarget, float time) {
+// Ids run freely, so compare their distance
+bool ddrive_move_done(DiffDrive * ddrive, uint32_t id) {
+    return (int32_t)(ddrive->moves_done - id) >= 0;
+}
+
+void ddrive_accel(DiffDrive * ddrive, float accel) {
     DiffDriveCmd cmd = {
-        .type  = DDRIVE_TRAPEZOID,
-        .ltarget = ltarget,
-        .rtarget = rtarget,
-        .time    = time,
+        .type  = DDRIVE_ACCEL,
+        .accel = accel,
+    };
+    send_cmd(ddrive, cmd);
+}
+
+void ddrive_idle(DiffDrive * ddrive, uint16_t hold_level, uint32_t release_ms) {
+    DiffDriveCmd cmd = {
+        .type       = DDRIVE_IDLE,
+        .hold_level = hold_level,
+        .release_ms = release_ms,
     };
     send_cmd(ddrive, cmd);
-    return &ddrive->interp_active;
 }
 
-bool * ddrive_trap_trans_rot(DiffDrive * ddrive, float trans_target, float rot_target, float time) {
+void ddrive_odometry(DiffDrive * ddrive, float wheel_radius, float track_width) {
+    DiffDriveCmd cmd = {
+        .type         = DDRIVE_ODOMETRY,
+        .wheel_radius = wheel_radius,
+        .track_width  = track_width,
+    };
+    send_cmd(ddrive, cmd);
+}
+
+void ddrive_pose(DiffDrive * ddrive, OdometryPose * pose) {
+    odometry_read(&ddrive->odometry, pose);
+}
+
+static DiffDriveCmd ramp_cmd(DiffDrive * ddrive, float rtarget, float ltarget, float time, float jerk) {
     DiffDriveCmd cmd = {
         .type    = DDRIVE_TRAPEZOID,
-        .ltarget = 0,
-        .rtarget = 0,
+        .ltarget = ltarget,
+        .rtarget = rtarget,
         .time    = time,
+        .jerk    = jerk,
+        .ramp_id = ddrive->moves_sent + 1,
     };
-    trans_rot_to_rpm(trans_target, rot_target, &cmd.ltarget, &cmd.rtarget);
+    return cmd;
+}
+
+uint32_t ddrive_trap_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time) {
+    return ddrive_scurve_rpm(ddrive, rtarget, ltarget, time, 0);
+}
+
+uint32_t ddrive_trap_trans_rot(DiffDrive * ddrive, float trans_target, float rot_target, float time) {
+    return ddrive_scurve_trans_rot(ddrive, trans_target, rot_target, time, 0);
+}
+
+// Ramps share their ids with moves
+uint32_t ddrive_scurve_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time, float jerk) {
+    DiffDriveCmd cmd = ramp_cmd(ddrive, rtarget, ltarget, time, jerk);
     send_cmd(ddrive, cmd);
-    return &ddrive->interp_active;
+    ddrive->moves_sent = cmd.ramp_id;
+    return cmd.ramp_id;
+}
+
+uint32_t ddrive_scurve_trans_rot(DiffDrive * ddrive, float trans_target, float rot_target, float time, float jerk) {
+    float ltarget, rtarget;
+    trans_rot_to_rpm(trans_target, rot_target, &ltarget, &rtarget);
+    return ddrive_scurve_rpm(ddrive, rtarget, ltarget, time, jerk);
 }
@@ -3,12 +3,29 @@
 
 #include "stepper.h"
 #include "interp.h"
+#include "scurve.h"
+#include "dda.h"
+#include "planner.h"
+#include "step_timer.h"
+#include "odometry.h"
 
 /*
  * A good value for steps per sequence for diff drive motors.
  */
 static const uint DEFAULT_DDRIVE_STEPS_PR_SEQ = 128;
 
+/*
+ * Number of motors of a differential drive.
+ */
+#define DDRIVE_AXES 2
+
+/*
+ * Steps per sequence of the coarser sequences the motors switch to at high
+ * speed, see `stepper_update_resolution`. Planned segments always run at
+ * the steps per sequence the drive was initialized with.
+ */
+static const uint DDRIVE_RESOLUTIONS[] = {32, 8, FULL_STEP};
+
 /*
  * Rpm at which the stepper motor reaches maximum PWM level.
  */
@@ -19,6 +36,29 @@ static const float DDRIVE_MAX_PWM_SPEED = 300.0f;
  */
 static const float DDRIVE_MIN_PWM_SPEED =   0.0f;
 
+/*
+ * Default acceleration limit of planned segments in rpm per second.
+ */
+static const float DDRIVE_DEFAULT_ACCEL = 600.0f;
+
+/*
+ * Largest instant change of rpm of a motor in planned segments. Planned
+ * moves also start and end at this rpm.
+ */
+static const float DDRIVE_JUMP_RPM = 10.0f;
+
+/*
+ * Interval between command and profile updates when the differential drive
+ * runs from a step timer. See `ddrive_start_timer`.
+ */
+static const uint DDRIVE_CONTROL_US = 1000;
+
+/*
+ * Longest time `ddrive_task` waits for a step without checking for new
+ * commands, in µs.
+ */
+static const uint DDRIVE_CMD_POLL_US = 50;
+
 /*
  * Command types for differential drive.
  */
@@ -27,6 +67,11 @@ typedef enum {
     DDRIVE_TRANS_ROTATE,
     DDRIVE_STOP,
     DDRIVE_TRAPEZOID,
+    DDRIVE_SEGMENT,
+    DDRIVE_ACCEL,
+    DDRIVE_ODOMETRY,
+    DDRIVE_MOVE,
+    DDRIVE_IDLE,
 } DiffDriveCmdType;
 
 /*
@@ -41,10 +86,89 @@ typedef struct {
             float ltarget;
             float rtarget;
             float time;
+            float jerk; // Time of each jerk phase. Zero for a linear ramp.
+            uint32_t ramp_id;
+        };
+        struct {
+            float rrev;    // Revolutions of the right motor
+            float lrev;    // Revolutions of the left motor
+            float seg_rpm; // Rpm of the motor turning the most
+        };
+        struct { float accel; };
+        struct {
+            float wheel_radius;
+            float track_width; // Distance between the wheels
+        };
+        struct {
+            int32_t rsteps;
+            int32_t lsteps;
+            float move_rpm; // Rpm of the motor moving the most
+            uint32_t move_id;
+        };
+        struct {
+            uint16_t hold_level;
+            uint32_t release_ms; // Zero holds until the next command
         };
     };
+    uint32_t stream_head; // Buffers streamed before the command was sent
+    uint32_t sent_us;     // Time the command was sent, for `ddrive_max_latency`
 } DiffDriveCmd;
 
+/*
+ * Number of commands that can be queued for the differential drive.
+ * Must be a power of two.
+ */
+#define DDRIVE_CMD_QUEUE_LEN 16
+
+/*
+ * Bounded lock-free single-producer/single-consumer command queue.
+ *
+ * `head` is only written by the producer (the caller of the command
+ * functions) and `tail` only by the consumer (`ddrive_task` or the step
+ * timer). They run freely and are masked when indexing `items`.
+ */
+typedef struct {
+    DiffDriveCmd items[DDRIVE_CMD_QUEUE_LEN];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} DiffDriveCmdQueue;
+
+/*
+ * Number of buffers a stream can have queued. See `ddrive_stream`.
+ */
+#define DDRIVE_STREAM_BUFS 2
+
+/*
+ * Streamed setpoints per rpm. Setpoints are signed 16 bit, so streams reach
+ * up to 2047 rpm in steps of 1/16 rpm.
+ */
+static const float DDRIVE_STREAM_RPM_SCALE = 16.0f;
+
+/*
+ * A buffer of streamed setpoints, read in place.
+ */
+typedef struct {
+    const int16_t * samples; // Right and left setpoint of each sample
+    uint32_t count;          // Samples, each being two setpoints
+    uint32_t dt_us;          // Duration of each sample
+} DiffDriveStreamBuf;
+
+/*
+ * Double buffered stream of rpm setpoints.
+ *
+ * Like the command queue, `head` is only written by the producer and
+ * `tail` only by the stepping side. The buffer at `tail` is played from
+ * `start_us`, and handed back when its last sample is over.
+ */
+typedef struct {
+    DiffDriveStreamBuf bufs[DDRIVE_STREAM_BUFS];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+    bool running;
+    uint64_t start_us;
+} DiffDriveStream;
+
 /*
  * Predefined stop command.
  */
@@ -65,31 +189,82 @@ typedef struct {
     float rrpm;
     float lrpm;
 
-    // Next command handling. See `ddrive_task`.
-    DiffDriveCmd next_cmd;
-    bool new_cmd_available;
+    // Distributes steps between the motors in `ddrive_task`
+    Dda dda;
+
+    // Time of the latest step of `ddrive_task`, in fixed-point microseconds
+    // of `STEP_TIMER_FRAC_BITS` fractional bits. The steps are timed from it
+    // with absolute deadlines.
+    uint64_t tick_time;
+
+    // Planned segments. See `ddrive_segment`.
+    Planner planner;
+
+    // Moves and ramps sent and finished, and the one running. See
+    // `ddrive_move`.
+    volatile uint32_t moves_sent;
+    volatile uint32_t moves_done;
+    uint32_t move_id;
+
+    // Queued commands. See `ddrive_task`.
+    DiffDriveCmdQueue cmds;
+    volatile uint32_t max_latency_us; // See `ddrive_max_latency`
+
+    // For trapezoidal and S-curve velocity profiles
+    SCurve rinterp;
+    SCurve linterp;
+    bool interp_active; // A ramp is running
+
+    // Interrupt driven stepping. See `ddrive_start_timer`.
+    StepTimer timer;
+    bool timer_active;
+    uint64_t control_us; // Time of the latest control call
+
+    // Task loop on core 1. See `ddrive_start_core1`.
+    bool core1_active;
 
-    // For trapezoidal velocity profile
-    Interp rinterp;
-    Interp linterp;
-    bool interp_active;
+    // Streamed setpoints. See `ddrive_stream`.
+    DiffDriveStream stream;
+
+    // Holding of stopped motors. See `ddrive_idle`.
+    uint16_t hold_level;
+    uint32_t release_ms;
+    bool idle;           // Both motors stopped since `idle_since`
+    bool released;       // The coils of stopped motors are released
+    uint64_t idle_since;
+
+    // Step counts and pose, updated by the stepping. See `ddrive_pose`.
+    Odometry odometry;
 
 } DiffDrive;
 
 /*
  * Initialize a differential drive with given pins and steps per sequence.
  *
- * This method allocates memory for the PWM sequences internally using
- * the `malloc` from the PICO SDK. See `ddrive_deinit` for freeing the memory.
+ * Both steppers share a PWM sequence from the sequence registry, see
+ * `seq_registry.h`. The level caches of both steppers are allocated with
+ * `malloc`, and left out if memory runs out. See `ddrive_deinit` for freeing
+ * the memory.
  *
  * See also `ddrive_init_with_seq` for more control over memory allocation.
+ *
+ * Returns false if memory ran out for the sequence.
+ */
+bool ddrive_init(DiffDrive * ddrive, int * lpins, int * rpins, size_t steps_pr_seq);
+
+/*
+ * Stop the step timer or core 1 task loop and deinitialize both steppers,
+ * releasing the memory allocated by `ddrive_init`.
  */
-void ddrive_init(DiffDrive * ddrive, int * lpins, int * rpins, size_t steps_pr_seq);
+void ddrive_deinit(DiffDrive * ddrive);
 
 /*
  * Initialize a differential drive with given pins and PWM sequence.
  *
  * Use the `stepper_generate_seq` function from `stepper.h` to create a PWM sequence.
+ *
+ * The PWM slices of both steppers are restarted in phase, see
+ * `stepper_sync_slices`.
  */
 void ddrive_init_with_seq(DiffDrive * ddrive, int * rpins, int * lpins, PWMSequence seq);
 
@@ -98,17 +273,87 @@ void ddrive_init_with_seq(DiffDrive * ddrive, int * rpins, int * lpins, PWMSeque
  * called periodically in a dedicated task or main loop. It handles motor control
  * and command processing. All methods that send commands to the differential drive
  * will not work unless this function is called regularly.
+ *
+ * Steps are timed with absolute deadlines that carry fractions of a
+ * microsecond, so neither the time spent stepping nor rounding slows the
+ * motors down. Between steps, the queue is checked for commands every
+ * `DDRIVE_CMD_POLL_US`, and the call returns early to apply them. The next
+ * step keeps its deadline and the motors their phase, so commands take
+ * effect in well under a millisecond without disturbing the stepping.
+ *
+ * While both motors are stopped the core sleeps in `__wfe` until a command
+ * is sent, see `ddrive_idle`, returning at least every 10 ms.
  */
 void ddrive_task(DiffDrive * ddrive);
 
+/*
+ * Run the differential drive from a hardware alarm interrupt instead of
+ * calling `ddrive_task` in a loop. Each motor is stepped at its own deadline,
+ * and ramps and streams are updated every `DDRIVE_CONTROL_US`. Commands and
+ * streamed buffers interrupt the timer as they are sent, and are handled
+ * right away.
+ *
+ * The interrupt is handled on the calling core, which is otherwise free.
+ * Returns false if no hardware alarm is available or the task loop runs on
+ * core 1.
+ */
+bool ddrive_start_timer(DiffDrive * ddrive);
+
+/*
+ * Stop interrupt driven stepping, releasing the hardware alarm.
+ */
+void ddrive_stop_timer(DiffDrive * ddrive);
+
+/*
+ * Run `ddrive_task` in a loop on core 1 with the core 1 runtime, see
+ * `core1_runtime.h`. Commands are sent from core 0 as usual, through the
+ * lock-free command queue.
+ *
+ * Returns false if core 1 is already running a runtime or the step timer
+ * is running.
+ */
+bool ddrive_start_core1(DiffDrive * ddrive);
+
+/*
+ * Stop the task loop on core 1 and reset the core.
+ */
+void ddrive_stop_core1(DiffDrive * ddrive);
+
 /*
  * Execute a differential drive command. This function is called internally by
- * `ddrive_task` when a new command is available.
+ * `ddrive_task` for every queued command.
  */
 void ddrive_handle_command(DiffDrive * ddrive, DiffDriveCmd * cmd);
 
 /*
- * Stop the differential drive motors, allowing them to coast.
+ * Queue a command without blocking.
+ *
+ * Returns false if the queue is full, in which case the command is dropped.
+ * Commands must be sent from a single core/thread.
+ */
+bool ddrive_try_send(DiffDrive * ddrive, DiffDriveCmd cmd);
+
+/*
+ * Returns true if there is room for another command in the queue.
+ */
+bool ddrive_ready(DiffDrive * ddrive);
+
+/*
+ * Longest time in µs from sending a command until it was applied, since the
+ * drive was initialized or the latency was last reset. Time spent queued
+ * before the stepping was started counts too, so reset it after starting.
+ * Segments waiting for room in the planner are not counted.
+ */
+uint32_t ddrive_max_latency(DiffDrive * ddrive, bool reset);
+
+/*
+ * The command functions below block while the command queue is full.
+ * Use `ddrive_try_send` to never block.
+ */
+
+/*
+ * Stop the differential drive motors, releasing their coils so they coast,
+ * even if a holding level is set with `ddrive_idle`.
  */
 void ddrive_stop(DiffDrive * ddrive);
 
@@ -117,6 +362,12 @@ void ddrive_stop(DiffDrive * ddrive);
  */
 void ddrive_rpm(DiffDrive * ddrive, float rrpm, float lrpm);
 
+/*
+ * Non-blocking version of `ddrive_rpm`. Returns false if the command queue
+ * is full.
+ */
+bool ddrive_try_rpm(DiffDrive * ddrive, float rrpm, float lrpm);
+
 /*
  * Set the target translational and rotational velocities.
  *
@@ -125,9 +376,147 @@ void ddrive_rpm(DiffDrive * ddrive, float rrpm, float lrpm);
  */
 void ddrive_trans_rot(DiffDrive * ddrive, float trans, float rot);
 
-// TODO: These commands don't always work as expected.
-//       I think it has to do with the interpolators.
-bool * ddrive_trap_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time);
-bool * ddrive_trap_trans_rot(DiffDrive * ddrive, float trans, float rot, float time);
+/*
+ * Non-blocking version of `ddrive_trans_rot`. Returns false if the command
+ * queue is full.
+ */
+bool ddrive_try_trans_rot(DiffDrive * ddrive, float trans, float rot);
+
+/*
+ * Queue a segment moving the motors the given number of revolutions, with
+ * the motor turning the most at `rpm`.
+ *
+ * Segments are planned ahead under the acceleration limit set with
+ * `ddrive_accel`, so consecutive segments run without stopping in between.
+ * The motors come to a stop after the last queued segment. Any other motion
+ * command drops the queued segments, including those still waiting for room
+ * in the planner.
+ *
+ * Planned segments are executed by `ddrive_task`, not the step timer. While
+ * the step timer runs, segments are rejected and this returns false.
+ */
+bool ddrive_segment(DiffDrive * ddrive, float rrev, float lrev, float rpm);
+
+/*
+ * Non-blocking version of `ddrive_segment`. Returns false if the command
+ * queue is full or the step timer runs.
+ */
+bool ddrive_try_segment(DiffDrive * ddrive, float rrev, float lrev, float rpm);
+
+/*
+ * Move the motors the given signed number of steps, counted at the steps per
+ * sequence the drive was initialized with, the motor moving the most at
+ * `rpm`. The move is planned like a segment, accelerating and decelerating
+ * within the limit of `ddrive_accel`, and stops exactly on target, where the
+ * motors are held or released as set with `ddrive_idle`.
+ *
+ * Replaces running segments and moves, and is replaced by any command other
+ * than a segment. Like segments, moves are executed by `ddrive_task`, not
+ * the step timer. While the step timer runs, moves are rejected and this
+ * returns zero.
+ *
+ * Returns an id for `ddrive_move_done`.
+ */
+uint32_t ddrive_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm);
+
+/*
+ * Non-blocking version of `ddrive_move`. Returns zero if the command queue
+ * is full or the step timer runs.
+ */
+uint32_t ddrive_try_move(DiffDrive * ddrive, int32_t rsteps, int32_t lsteps, float rpm);
+
+/*
+ * Returns true once the move or ramp with the given id has reached its
+ * target, or was replaced. Lock free, and may be called from any core.
+ *
+ * The stepping sends an event with `__sev` when one finishes, so a core
+ * waiting for it can sleep in `__wfe`.
+ */
+bool ddrive_move_done(DiffDrive * ddrive, uint32_t id);
+
+/*
+ * Queue a buffer of `count` samples of rpm setpoints, each lasting `dt_us`.
+ * A sample is the right and then the left setpoint, in units of
+ * `DDRIVE_STREAM_RPM_SCALE`.
+ *
+ * The samples are read in place, so the buffer must be left alone until
+ * `ddrive_stream_free` shows it was handed back. A queued buffer plays
+ * seamlessly after the one before, and the motors stop when the stream runs
+ * dry. Streams take over from other commands, and any command other than
+ * `ddrive_accel`, `ddrive_odometry` and `ddrive_idle` drops the buffers
+ * streamed before it was sent. Empty buffers are ignored.
+ *
+ * The setpoints are picked up by every loop of `ddrive_task`, which ends at
+ * the next sample, or every `DDRIVE_CONTROL_US` when stepping from the step
+ * timer, skipping shorter samples. The step timer picks up a new stream as
+ * it is sent.
+ *
+ * Returns false if `DDRIVE_STREAM_BUFS` buffers are queued already.
+ */
+bool ddrive_stream(DiffDrive * ddrive, const int16_t * samples, uint32_t count, uint32_t dt_us);
+
+/*
+ * Number of buffers that can be queued with `ddrive_stream`. All of them
+ * once the stream has played out.
+ */
+uint ddrive_stream_free(DiffDrive * ddrive);
+
+/*
+ * Set the acceleration limit of planned segments in rpm per second.
+ */
+void ddrive_accel(DiffDrive * ddrive, float accel);
+
+/*
+ * Set how stopped motors are held. A stopped motor keeps its coils
+ * energized at the current step of its sequence with PWM level `hold_level`
+ * (0 to PWM_MAX), so it keeps its position with less current than stepping.
+ * Once both motors have been stopped for `release_ms`, the coils are
+ * released. A `hold_level` of 0 releases stopped motors right away, which
+ * is the default, and a `release_ms` of 0 holds them until the next command.
+ *
+ * While idle, `ddrive_task` sleeps the core in `__wfe`, and every command
+ * wakes it with `__sev`. Like `ddrive_accel`, this leaves the motion alone.
+ */
+void ddrive_idle(DiffDrive * ddrive, uint16_t hold_level, uint32_t release_ms);
+
+/*
+ * Ramp the rpms linearly to their targets over `time` seconds.
+ *
+ * Returns an id for `ddrive_move_done`, which turns true once the ramp is
+ * done or was replaced by another command.
+ */
+uint32_t ddrive_trap_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time);
+uint32_t ddrive_trap_trans_rot(DiffDrive * ddrive, float trans, float rot, float time);
+
+/*
+ * Ramp the rpms to their targets over `time` seconds with limited jerk.
+ *
+ * The acceleration ramps up during the first `jerk` seconds and down during
+ * the last, instead of jumping at both ends of the ramp. `jerk` is at most
+ * half of `time`, which gives a pure S-curve.
+ *
+ * Returns an id for `ddrive_move_done`, like `ddrive_trap_rpm`.
+ */
+uint32_t ddrive_scurve_rpm(DiffDrive * ddrive, float rtarget, float ltarget, float time, float jerk);
+uint32_t ddrive_scurve_trans_rot(DiffDrive * ddrive, float trans, float rot, float time, float jerk);
+
+/*
+ * Set the wheel radius and the distance between the wheels, in any unit,
+ * and restart the pose from the origin once the command is handled. The
+ * step counts carry on. The pose is integrated after every
+ * loop of `ddrive_task`, or every `DDRIVE_CONTROL_US` when stepping from the
+ * step timer. See `odometry.h`.
+ *
+ * Until this is called only the step counts are kept.
+ */
+void ddrive_odometry(DiffDrive * ddrive, float wheel_radius, float track_width);
+
+/*
+ * Get a consistent snapshot of the step counts of the wheels, counted at the
+ * steps per sequence the drive was initialized with, and of the pose.
+ *
+ * Lock free, and may be called from any core while the drive is stepping.
+ */
+void ddrive_pose(DiffDrive * ddrive, OdometryPose * pose);
 
 #endif // DIFF_DRIVE_H
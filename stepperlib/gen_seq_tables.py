@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Generate the constant PWM sequence tables of `seq_tables.h`.
+
+The tables hold the quarter waves of the same half sines as
+`stepper_generate_quarter_seq`, as Q15 fixed point duty fractions, for every
+`StepperStepping` mode and the common longer sequences.
+
+Usage: gen_seq_tables.py OUTPUT
+"""
+
+import math
+import struct
+import sys
+
+STEPS = [4, 8, 16, 32, 64, 128, 256, 512, 1024]
+PER_ROW = 8
+Q15_ONE = 1 << 15
+
+
+def f32(x: float) -> float:
+    return struct.unpack("f", struct.pack("f", x))[0]
+
+
+def quarter_sine(steps: int) -> list[float]:
+    return [f32(math.sin(f32(2 * f32(math.pi) * step / steps))) for step in range(steps // 4 + 1)]
+
+
+def to_q15(y: float) -> int:
+    return int(min(max(y, 0.0), 1.0) * Q15_ONE + 0.5)
+
+
+def rows(values: list[str]) -> str:
+    lines = []
+    for i in range(0, len(values), PER_ROW):
+        lines.append("    " + ", ".join(values[i:i + PER_ROW]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__, file=sys.stderr)
+        sys.exit(1)
+
+    out = [
+        "// Generated by gen_seq_tables.py. Do not edit.",
+        "",
+        '#include "seq_tables.h"',
+        "",
+    ]
+
+    for steps in STEPS:
+        out += [
+            f"static const StepperQ15 half_sine_{steps}_quarter[STEPPER_QUARTER_LEN({steps})] = {{",
+            rows([f"{to_q15(y):5d}" for y in quarter_sine(steps)]),
+            "};",
+            "",
+        ]
+
+    out.append("const PWMSequence seq_tables[] = {")
+    for steps in STEPS:
+        out.append(f"    {{ .quarter = half_sine_{steps}_quarter, .length = {steps} }},")
+    out += [
+        "};",
+        "",
+        "const size_t seq_table_count = sizeof(seq_tables) / sizeof(seq_tables[0]);",
+        "",
+    ]
+
+    with open(sys.argv[1], "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
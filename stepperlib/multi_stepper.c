@@ -0,0 +1,153 @@
+#include <math.h>
+#include <stdlib.h>
+#include <pico/stdlib.h>
+
+#include "multi_stepper.h"
+
+// Runs from the step timer interrupt every `period_us`
+static void tick(void * ctx) {
+    MultiStepper * ms = ctx;
+
+    critical_section_enter_blocking(&ms->lock);
+
+    uint32_t steps = dda_tick(&ms->dda);
+
+    for (uint axis = 0; axis < ms->axes; axis++) {
+        if (!(steps & (1u << axis))) continue;
+        stepper_step(ms->steppers[axis], ms->forward[axis], ms->level);
+        ms->position[axis] += ms->forward[axis] ? 1 : -1;
+    }
+
+    bool finished = ms->moving && --ms->remaining == 0;
+    if (finished) {
+        ms->moving    = false;
+        ms->period_us = 0;
+    }
+
+    critical_section_exit(&ms->lock);
+
+    if (finished) step_timer_set_control(&ms->timer, NULL, NULL, 0);
+}
+
+// Tick every `period_us`, or stop ticking if zero. Must hold the lock.
+//
+// Rescheduling restarts the period, so an unchanged period is left running
+// unless `restart` is set.
+static void schedule(MultiStepper * ms, uint32_t period_us, bool restart) {
+    if (!restart && period_us == ms->period_us) return;
+
+    ms->period_us = period_us;
+    step_timer_set_control(&ms->timer, period_us ? tick : NULL, ms, period_us);
+}
+
+// Expected time between steps of every axis at the current rates
+static void expect_periods(MultiStepper * ms) {
+    for (uint axis = 0; axis < ms->axes; axis++) {
+        STEP_STATS_EXPECT(ms->steppers[axis], ms->dda.rates[axis] ?
+                (float)ms->period_us * ms->dda.major / ms->dda.rates[axis] : 0);
+    }
+}
+
+bool multi_stepper_init(MultiStepper * ms, Stepper ** steppers, uint axes) {
+    *ms = (MultiStepper){0};
+    if (axes == 0 || axes > MULTI_STEPPER_MAX_AXES) return false;
+
+    if (!step_timer_init(&ms->timer)) return false;
+
+    critical_section_init(&ms->lock);
+
+    uint32_t slices = 0;
+    for (uint axis = 0; axis < axes; axis++) {
+        ms->steppers[axis] = steppers[axis];
+        ms->forward[axis]  = true;
+        slices |= stepper_slice_mask(steppers[axis]);
+    }
+    ms->axes = axes;
+
+    // Steps of all axes take effect on the same PWM wrap
+    stepper_sync_slices(slices);
+
+    dda_init(&ms->dda, axes);
+    step_timer_start(&ms->timer);
+
+    return true;
+}
+
+void multi_stepper_deinit(MultiStepper * ms) {
+    if (!ms->axes) return;
+
+    step_timer_deinit(&ms->timer);
+    critical_section_deinit(&ms->lock);
+    ms->axes = 0;
+}
+
+void multi_stepper_velocity(MultiStepper * ms, const float * steps_pr_sec, uint16_t level) {
+    uint32_t rates[MULTI_STEPPER_MAX_AXES];
+    float fastest = 0;
+
+    for (uint axis = 0; axis < ms->axes; axis++) {
+        // Integer DDA rates in milli-steps per second
+        rates[axis] = fabsf(steps_pr_sec[axis]) * 1000;
+        fastest     = MAX(fastest, fabsf(steps_pr_sec[axis]));
+    }
+
+    critical_section_enter_blocking(&ms->lock);
+
+    for (uint axis = 0; axis < ms->axes; axis++) ms->forward[axis] = steps_pr_sec[axis] >= 0;
+
+    // A move starts the DDA from scratch, so do not continue its progress
+    if (ms->moving) dda_init(&ms->dda, ms->axes);
+    dda_set_rates(&ms->dda, rates);
+
+    ms->level  = level;
+    ms->moving = false;
+
+    schedule(ms, fastest > 0 ? MAX(1e6f / fastest, 1.0f) : 0, false);
+    expect_periods(ms);
+
+    critical_section_exit(&ms->lock);
+}
+
+void multi_stepper_move(MultiStepper * ms, const int32_t * steps, float steps_pr_sec, uint16_t level) {
+    uint32_t rates[MULTI_STEPPER_MAX_AXES];
+    uint32_t length = 0;
+
+    for (uint axis = 0; axis < ms->axes; axis++) {
+        // Negate as unsigned, since abs(INT32_MIN) does not fit in an int32_t
+        rates[axis] = steps[axis] < 0 ? -(uint32_t)steps[axis] : (uint32_t)steps[axis];
+        length      = MAX(length, rates[axis]);
+    }
+
+    critical_section_enter_blocking(&ms->lock);
+
+    for (uint axis = 0; axis < ms->axes; axis++) ms->forward[axis] = steps[axis] >= 0;
+
+    // Start half way, so every axis makes exactly its steps over the move
+    dda_init(&ms->dda, ms->axes);
+    dda_set_rates(&ms->dda, rates);
+
+    ms->level     = level;
+    ms->remaining = length;
+    ms->moving    = length > 0 && steps_pr_sec > 0;
+
+    // The first steps come one period from now
+    schedule(ms, ms->moving ? MAX(1e6f / steps_pr_sec, 1.0f) : 0, true);
+    expect_periods(ms);
+
+    critical_section_exit(&ms->lock);
+}
+
+bool multi_stepper_busy(MultiStepper * ms) {
+    return ms->period_us != 0;
+}
+
+void multi_stepper_stop(MultiStepper * ms) {
+    critical_section_enter_blocking(&ms->lock);
+
+    ms->moving = false;
+    schedule(ms, 0, false);
+
+    for (uint axis = 0; axis < ms->axes; axis++) stepper_stop(ms->steppers[axis]);
+
+    critical_section_exit(&ms->lock);
+}
@@ -0,0 +1,90 @@
+#ifndef MULTI_STEPPER_H
+#define MULTI_STEPPER_H
+
+#include <pico/stdlib.h>
+#include <pico/sync.h>
+
+#include "stepper.h"
+#include "dda.h"
+#include "step_timer.h"
+
+/*
+ * Maximum number of axes of a multi stepper. Four steppers with their pins
+ * on both channels of their slices use all 8 PWM slices.
+ */
+#define MULTI_STEPPER_MAX_AXES 4
+
+/*
+ * Coordinated stepping of several steppers from a single timing source.
+ *
+ * A step timer ticks at the rate of the fastest axis and a DDA distributes
+ * the ticks between the axes, see `dda.h`. All axes therefore start on the
+ * same tick, keep their rate ratios exactly, and finish a move on the same
+ * tick.
+ *
+ * The steppers are not owned by the multi stepper. They must be initialized
+ * before and must not be stepped by anything else while it runs.
+ */
+typedef struct {
+    Stepper * steppers[MULTI_STEPPER_MAX_AXES];
+    uint axes;
+
+    Dda dda;
+    bool forward[MULTI_STEPPER_MAX_AXES];
+    uint16_t level;
+    volatile uint32_t period_us; // Time between ticks. Zero when idle.
+    uint32_t remaining;          // Ticks left of a move
+    bool moving;                 // A move with a fixed number of ticks is running
+
+    // Signed steps made by each axis
+    int32_t position[MULTI_STEPPER_MAX_AXES];
+
+    StepTimer timer;
+    critical_section_t lock;
+} MultiStepper;
+
+/*
+ * Initialize a multi stepper driving `axes` already initialized steppers.
+ *
+ * Claims a hardware alarm for the step timer, handled on the calling core,
+ * and restarts the PWM slices of all steppers in phase, see
+ * `stepper_sync_slices`.
+ *
+ * Returns false if there are too many axes or no hardware alarm is available.
+ */
+bool multi_stepper_init(MultiStepper * ms, Stepper ** steppers, uint axes);
+
+/*
+ * Stop stepping and release the hardware alarm. The steppers are left
+ * initialized.
+ */
+void multi_stepper_deinit(MultiStepper * ms);
+
+/*
+ * Step every axis continuously at its signed rate in steps per second.
+ *
+ * The fractional step progress of every axis is kept when the rates change.
+ * Replaces a running move.
+ */
+void multi_stepper_velocity(MultiStepper * ms, const float * steps_pr_sec, uint16_t level);
+
+/*
+ * Move every axis the given signed number of steps, with the axis moving the
+ * most at `steps_pr_sec`. All axes start and finish together, and the coils
+ * are left energized at the end.
+ *
+ * Replaces a running move or velocity.
+ */
+void multi_stepper_move(MultiStepper * ms, const int32_t * steps, float steps_pr_sec, uint16_t level);
+
+/*
+ * Returns true while the axes are stepping.
+ */
+bool multi_stepper_busy(MultiStepper * ms);
+
+/*
+ * Stop stepping and release the coils of all axes.
+ */
+void multi_stepper_stop(MultiStepper * ms);
+
+#endif // MULTI_STEPPER_H
@@ -0,0 +1,113 @@
+#include <math.h>
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+
+#include "odometry.h"
+
+// Quarter sine wave in Q30, with both ends
+#define SINE_BITS 8
+#define SINE_SIZE (1u << SINE_BITS)
+#define SINE_ONE  (1 << 30)
+
+static int32_t quarter_sine[SINE_SIZE + 1];
+
+static void fill_sine(void) {
+    if (quarter_sine[SINE_SIZE]) return;
+
+    for (uint i = 0; i <= SINE_SIZE; i++) {
+        quarter_sine[i] = lround(sin(M_PI / 2 * i / SINE_SIZE) * SINE_ONE);
+    }
+}
+
+// Sine in Q30 of an angle where a full turn is 2^32
+static int32_t sine(uint32_t angle) {
+    uint32_t quadrant = angle >> 30;
+    uint32_t a        = angle & (SINE_ONE - 1);
+
+    // The second and fourth quadrants run backwards through the table
+    if (quadrant & 1) a = SINE_ONE - a;
+
+    uint32_t idx  = a >> (30 - SINE_BITS);
+    uint32_t frac = (a >> (14 - SINE_BITS)) & 0xFFFF;
+
+    int32_t y = quarter_sine[idx];
+    if (idx < SINE_SIZE) y += ((int64_t)(quarter_sine[idx + 1] - y) * frac) >> 16;
+
+    return quadrant & 2 ? -y : y;
+}
+
+static int32_t cosine(uint32_t angle) {
+    return sine(angle + (1u << 30));
+}
+
+static void publish(Odometry * odo, int64_t rsteps, int64_t lsteps) {
+    odo->seq++;
+    __dmb();
+
+    odo->pose = (OdometryPose){
+        .rsteps = rsteps,
+        .lsteps = lsteps,
+        .x      = odo->x,
+        .y      = odo->y,
+        .theta  = odo->theta >> 32,
+    };
+
+    __dmb();
+    odo->seq++;
+}
+
+void odometry_init(Odometry * odo) {
+    fill_sine();
+    *odo = (Odometry){0};
+}
+
+void odometry_configure(Odometry * odo, float step_length, float track_width) {
+    odo->step_length  = llround((double)step_length * (1ull << ODOMETRY_POS_SHIFT));
+    odo->turn_pr_step = track_width > 0 ? (uint64_t)((double)step_length / (2 * M_PI * track_width) * 0x1p64) : 0;
+
+    odo->x     = 0;
+    odo->y     = 0;
+    odo->theta = 0;
+
+    publish(odo, odo->rlast, odo->llast);
+}
+
+void odometry_update(Odometry * odo, int64_t rsteps, int64_t lsteps) {
+    int32_t dr = rsteps - odo->rlast;
+    int32_t dl = lsteps - odo->llast;
+    odo->rlast = rsteps;
+    odo->llast = lsteps;
+
+    if (dr || dl) {
+        // Counter-clockwise when the right wheel travels further
+        uint64_t turn = (uint64_t)(int64_t)(dr - dl) * odo->turn_pr_step;
+        uint32_t mid  = (odo->theta + (uint64_t)((int64_t)turn >> 1)) >> 32;
+
+        // Travel of the center in Q32, up to two units
+        int64_t travel = (int64_t)(dr + dl) * odo->step_length / 2;
+
+        odo->x     += (travel * cosine(mid)) >> 30;
+        odo->y     += (travel * sine(mid)) >> 30;
+        odo->theta += turn;
+    }
+
+    publish(odo, rsteps, lsteps);
+}
+
+void odometry_read(Odometry * odo, OdometryPose * pose) {
+    uint32_t seq;
+    do {
+        seq = odo->seq;
+        __dmb();
+        *pose = odo->pose;
+        __dmb();
+    } while ((seq & 1) || seq != odo->seq);
+}
+
+float odometry_pos_to_float(int64_t pos) {
+    return (float)pos / (1ull << ODOMETRY_POS_SHIFT);
+}
+
+float odometry_theta_to_float(uint32_t theta) {
+    return (int32_t)theta * (float)(M_PI / (1u << 31));
+}
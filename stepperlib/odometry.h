@@ -0,0 +1,90 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <pico/stdlib.h>
+
+/*
+ * Fixed point position unit. Positions are Q32.32 numbers in the unit of
+ * the wheel radius given to `odometry_configure`.
+ */
+#define ODOMETRY_POS_SHIFT 32
+
+/*
+ * Snapshot of the step counts and pose of a differential drive.
+ *
+ * `theta` is the heading counter-clockwise from the x axis, with a full turn
+ * being 2^32, so it wraps around like an angle. The robot starts at the
+ * origin heading along the x axis.
+ */
+typedef struct {
+    int64_t rsteps; // Signed steps of the right wheel
+    int64_t lsteps; // Signed steps of the left wheel
+    int64_t x;      // See `ODOMETRY_POS_SHIFT`
+    int64_t y;
+    uint32_t theta;
+} OdometryPose;
+
+/*
+ * Integrates the pose of a differential drive from the step counts of its
+ * wheels, in fixed point.
+ *
+ * The wheel travel since the last update is taken as an arc, moving along
+ * the heading half way through it. Headings are looked up in a sine table
+ * interpolated to about 5e-6, so no floating point is used when updating.
+ *
+ * `odometry_update` is called by the single writer stepping the wheels. Any
+ * core or interrupt can read a consistent snapshot with `odometry_read`,
+ * which never blocks the writer: `seq` is odd while the snapshot is written
+ * and readers retry until they see the same even value before and after
+ * copying it.
+ */
+typedef struct {
+    int64_t step_length;   // Wheel travel per step, see `ODOMETRY_POS_SHIFT`
+    uint64_t turn_pr_step; // Heading change per step of difference, a full turn being 2^64
+
+    int64_t rlast; // Step counts at the last update
+    int64_t llast;
+
+    int64_t x;
+    int64_t y;
+    uint64_t theta; // A full turn being 2^64
+
+    volatile uint32_t seq;
+    OdometryPose pose;
+} Odometry;
+
+/*
+ * Initialize odometry at the origin with step counts of zero. The pose is
+ * not integrated until `odometry_configure` is called.
+ */
+void odometry_init(Odometry * odo);
+
+/*
+ * Set the distance a wheel travels per step and the distance between the
+ * wheels, in the same unit, and restart the pose from the origin.
+ *
+ * Must be called by the writer.
+ */
+void odometry_configure(Odometry * odo, float step_length, float track_width);
+
+/*
+ * Integrate the pose up to the given absolute step counts of the wheels and
+ * publish a new snapshot.
+ *
+ * The wheels must travel less than two units between updates.
+ */
+void odometry_update(Odometry * odo, int64_t rsteps, int64_t lsteps);
+
+/*
+ * Copy the latest snapshot. Lock free, see `Odometry`.
+ */
+void odometry_read(Odometry * odo, OdometryPose * pose);
+
+/*
+ * Convert a snapshot position to the unit of the wheel radius, and a
+ * heading to radians between -pi and pi.
+ */
+float odometry_pos_to_float(int64_t pos);
+float odometry_theta_to_float(uint32_t theta);
+
+#endif // ODOMETRY_H
@@ -0,0 +1,164 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "planner.h"
+
+static PlannerSegment * segment(Planner * planner, uint i) {
+    return &planner->segments[(planner->first + i) % PLANNER_QUEUE_LEN];
+}
+
+// Signed fraction of the major axis rate an axis moves at
+static float fraction(const PlannerSegment * seg, uint axis) {
+    return (float)seg->steps[axis] / seg->length;
+}
+
+// Highest rate reachable from `rate` within `steps`
+static float reachable(float rate, float accel, uint32_t steps) {
+    return sqrtf(rate * rate + 2 * accel * steps);
+}
+
+// Highest major axis rate at which no axis changes rate by more than the
+// jump rate when going from `prev` to `next`
+static float junction_limit(Planner * planner, const PlannerSegment * prev, const PlannerSegment * next) {
+    float limit = MIN(prev->nominal_rate, next->nominal_rate);
+
+    for (uint axis = 0; axis < PLANNER_AXES; axis++) {
+        float jump = fabsf(fraction(prev, axis) - fraction(next, axis));
+        if (jump > 0) limit = MIN(limit, planner->jump_rate / jump);
+    }
+
+    return limit;
+}
+
+// Steps left of a queued segment. The first one is partially done.
+static uint32_t remaining(Planner * planner, uint i) {
+    uint32_t length = segment(planner, i)->length;
+    return i == 0 ? length - planner->done : length;
+}
+
+static void replan(Planner * planner) {
+    if (!planner->count) return;
+
+    // Backward pass: every segment must be able to slow down to the entry
+    // of the next, and the last one must be able to stop.
+    PlannerSegment * last = segment(planner, planner->count - 1);
+    float exit = MIN(planner->jump_rate, last->nominal_rate);
+
+    for (int i = planner->count - 1; i >= 0; i--) {
+        PlannerSegment * seg = segment(planner, i);
+        seg->exit_rate = exit;
+
+        float entry = reachable(exit, planner->accel, remaining(planner, i));
+        if (i > 0) entry = MIN(entry, seg->max_entry_rate);
+        seg->entry_rate = MIN(entry, seg->nominal_rate);
+
+        exit = seg->entry_rate;
+    }
+
+    // Forward pass: every segment must be reachable from the current rate
+    float rate = planner->rate;
+
+    for (uint i = 0; i < planner->count; i++) {
+        PlannerSegment * seg = segment(planner, i);
+        seg->entry_rate = i == 0 ? rate : MIN(seg->entry_rate, rate);
+        seg->exit_rate  = MIN(seg->exit_rate, reachable(seg->entry_rate, planner->accel, remaining(planner, i)));
+        rate = seg->exit_rate;
+    }
+
+    // Accelerate from the current state
+    planner->anchor      = planner->done;
+    planner->anchor_rate = planner->rate;
+}
+
+void planner_init(Planner * planner, float accel, float jump_rate) {
+    *planner = (Planner){0};
+    planner->accel     = accel;
+    planner->jump_rate = jump_rate;
+}
+
+void planner_set_accel(Planner * planner, float accel) {
+    planner->accel = accel;
+    replan(planner);
+}
+
+bool planner_add(Planner * planner, const int32_t steps[PLANNER_AXES], float nominal_rate) {
+    if (!planner_ready(planner) || nominal_rate <= 0) return false;
+
+    uint32_t length = 0;
+    for (uint axis = 0; axis < PLANNER_AXES; axis++) length = MAX(length, (uint32_t)abs(steps[axis]));
+    if (!length) return false;
+
+    // Start from standstill
+    if (planner->count == 0) {
+        planner->done = 0;
+        planner->rate = MIN(planner->jump_rate, nominal_rate);
+    }
+
+    PlannerSegment * seg = segment(planner, planner->count);
+    for (uint axis = 0; axis < PLANNER_AXES; axis++) seg->steps[axis] = steps[axis];
+    seg->length         = length;
+    seg->nominal_rate   = nominal_rate;
+    seg->max_entry_rate = nominal_rate;
+
+    if (planner->count > 0) {
+        seg->max_entry_rate = junction_limit(planner, segment(planner, planner->count - 1), seg);
+    }
+
+    planner->count++;
+    replan(planner);
+
+    return true;
+}
+
+void planner_clear(Planner * planner) {
+    planner->count = 0;
+    planner->done  = 0;
+    planner->rate  = 0;
+}
+
+float planner_rate(Planner * planner) {
+    if (!planner->count) return 0;
+
+    PlannerSegment * seg = segment(planner, 0);
+
+    float rate = MIN(seg->nominal_rate, reachable(planner->anchor_rate, planner->accel, planner->done - planner->anchor));
+    // The last step of the segment runs at the exit rate
+    rate = MIN(rate, reachable(seg->exit_rate, planner->accel, seg->length - 1 - planner->done));
+
+    planner->rate = MAX(rate, 1.0f);
+    return planner->rate;
+}
+
+float planner_axis_rate(Planner * planner, uint axis) {
+    if (!planner->count) return 0;
+    return planner->rate * fraction(segment(planner, 0), axis);
+}
+
+uint32_t planner_step(Planner * planner, bool forward[PLANNER_AXES]) {
+    if (!planner->count) return 0;
+
+    PlannerSegment * seg = segment(planner, 0);
+
+    // Distribute the steps of a new segment. The DDA starts half way, so
+    // every axis makes exactly its number of steps over the segment.
+    if (planner->done == 0) {
+        uint32_t rates[PLANNER_AXES];
+        for (uint axis = 0; axis < PLANNER_AXES; axis++) rates[axis] = abs(seg->steps[axis]);
+        dda_init(&planner->dda, PLANNER_AXES);
+        dda_set_rates(&planner->dda, rates);
+    }
+
+    for (uint axis = 0; axis < PLANNER_AXES; axis++) forward[axis] = seg->steps[axis] >= 0;
+
+    uint32_t mask = dda_tick(&planner->dda);
+
+    if (++planner->done >= seg->length) {
+        planner->first = (planner->first + 1) % PLANNER_QUEUE_LEN;
+        planner->count--;
+        planner->done        = 0;
+        planner->anchor      = 0;
+        planner->anchor_rate = planner->rate;
+    }
+
+    return mask;
+}
@@ -0,0 +1,115 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <pico/stdlib.h>
+
+#include "dda.h"
+
+/*
+ * Number of axes moved by a planned segment.
+ */
+#define PLANNER_AXES 2
+
+/*
+ * Number of segments the planner can look ahead.
+ */
+#define PLANNER_QUEUE_LEN 16
+
+/*
+ * A straight move of all axes, with steps distributed by a DDA.
+ *
+ * Rates are in steps per second of the major axis, the axis moving the most
+ * steps. The major axis rate is continuous across segments, while the other
+ * axes scale with it.
+ */
+typedef struct {
+    int32_t steps[PLANNER_AXES]; // Signed steps of each axis
+    uint32_t length;             // Steps of the major axis
+    float nominal_rate;          // Cruise rate
+    float max_entry_rate;        // Junction limit with the previous segment
+    float entry_rate;            // Planned rate at the start
+    float exit_rate;             // Planned rate at the end
+} PlannerSegment;
+
+/*
+ * Lookahead motion planner.
+ *
+ * Every time a segment is added, the junction rates of all queued segments
+ * are replanned with a backward and forward pass, so the motors only slow
+ * down where the path requires it and can always stop at the end of the
+ * queue within the acceleration limit.
+ */
+typedef struct {
+    PlannerSegment segments[PLANNER_QUEUE_LEN];
+    uint first;
+    uint count;
+
+    float accel;     // Major axis acceleration limit in steps/s^2
+    float jump_rate; // Largest instant rate change of any axis in steps/s
+
+    // Execution state of the first segment
+    uint32_t done;       // Major axis steps done
+    float rate;          // Current major axis rate
+    uint32_t anchor;     // Step at which `anchor_rate` was reached
+    float anchor_rate;   // Rate accelerated from
+    Dda dda;
+} Planner;
+
+/*
+ * Initialize an empty planner.
+ *
+ * `jump_rate` is the largest rate change an axis can make instantly, and is
+ * also the rate moves start and end at.
+ */
+void planner_init(Planner * planner, float accel, float jump_rate);
+
+/*
+ * Set the acceleration limit in steps/s^2 and replan the queued segments.
+ */
+void planner_set_accel(Planner * planner, float accel);
+
+/*
+ * Queue a segment and replan.
+ *
+ * Returns false if the queue is full or the segment does not move.
+ */
+bool planner_add(Planner * planner, const int32_t steps[PLANNER_AXES], float nominal_rate);
+
+/*
+ * Drop all queued segments, stopping immediately.
+ */
+void planner_clear(Planner * planner);
+
+/*
+ * Returns true if there are segments left to execute.
+ */
+static inline bool planner_active(Planner * planner) {
+    return planner->count > 0;
+}
+
+/*
+ * Returns true if another segment can be queued.
+ */
+static inline bool planner_ready(Planner * planner) {
+    return planner->count < PLANNER_QUEUE_LEN;
+}
+
+/*
+ * Update and return the major axis rate for the next step.
+ */
+float planner_rate(Planner * planner);
+
+/*
+ * Returns the signed rate of an axis at the current major axis rate.
+ */
+float planner_axis_rate(Planner * planner, uint axis);
+
+/*
+ * Advance the first segment by one major axis step.
+ *
+ * Returns a bit mask of the axes to step, with their directions in
+ * `forward`. Finished segments are removed from the queue.
+ */
+uint32_t planner_step(Planner * planner, bool forward[PLANNER_AXES]);
+
+#endif // PLANNER_H
@@ -0,0 +1,68 @@
+#ifndef SCURVE_H
+#define SCURVE_H
+
+#include <pico/stdlib.h>
+
+#include "interp.h"
+
+/*
+ * Fixed point fraction of the ramp time.
+ */
+#define SCURVE_Q   16
+#define SCURVE_ONE ((uint64_t)1 << SCURVE_Q)
+
+/*
+ * Jerk limited ramp between two values, with the same tick/value interface
+ * as `Interp`.
+ *
+ * The rate of change grows linearly during the first `tjerk`, stays
+ * constant, and falls linearly during the last `tjerk`, so it is continuous
+ * at both ends. A velocity ramp is therefore the acceleration half of a
+ * 7-phase S-curve move. With `tjerk` zero it is the linear ramp of `Interp`.
+ *
+ * Time is evaluated as a Q16 fraction of `tend`.
+ */
+typedef struct {
+    Interp interp;
+    InterpCounter tjerk; // Duration of each jerk phase, at most half of `tend`
+} SCurve;
+
+static inline void scurve_start(SCurve *s, float start, float end, InterpCounter tend, InterpCounter tjerk) {
+    interp_start(&s->interp, start, end, tend);
+    s->tjerk = MIN(tjerk, tend / 2);
+}
+
+static inline bool scurve_tick(SCurve *s, InterpCounter dt) {
+    return interp_tick(&s->interp, dt);
+}
+
+/*
+ * Fraction of the ramp done in Q16, for a Q16 time `u` and jerk time `j`.
+ */
+static inline uint64_t scurve_fraction(uint64_t u, uint64_t j) {
+    if (j == 0) return u;
+
+    // Twice the area of a jerk phase, scaled to the peak rate of change
+    uint64_t den = 2 * j * (SCURVE_ONE - j);
+
+    if (u < j) {
+        return ((u * u) << SCURVE_Q) / den;
+    } else if (u <= SCURVE_ONE - j) {
+        return ((u - j / 2) << SCURVE_Q) / (SCURVE_ONE - j);
+    } else {
+        uint64_t left = SCURVE_ONE - u;
+        return SCURVE_ONE - ((left * left) << SCURVE_Q) / den;
+    }
+}
+
+static inline float scurve_value(SCurve *s) {
+    Interp *i = &s->interp;
+    if (!i->tend) return i->end;
+
+    uint64_t u = (i->t << SCURVE_Q) / i->tend;
+    uint64_t j = (s->tjerk << SCURVE_Q) / i->tend;
+
+    return i->start + scurve_fraction(u, j) * (i->end - i->start) / SCURVE_ONE;
+}
+
+#endif // SCURVE_H
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <pico/stdlib.h>
+
+#include "seq_registry.h"
+#include "seq_tables.h"
+
+typedef struct SeqEntry {
+    uint steps;
+    SeqWaveform wave;
+    uint refs;
+    PWMSequence seq;
+    struct SeqEntry * next;
+} SeqEntry;
+
+static SeqEntry * entries = NULL;
+
+// Compact sequence of a quarter wave
+static PWMSequence generate_quarter(uint steps) {
+    StepperQ15 * quarter = malloc(sizeof(StepperQ15) * STEPPER_QUARTER_LEN(steps));
+    if (!quarter) return (PWMSequence){0};
+
+    return stepper_generate_quarter_seq(steps, quarter);
+}
+
+static PWMSequence generate(uint steps, SeqWaveform wave) {
+    // Only a multiple of 4 steps folds into a quarter wave
+    if (wave == SEQ_WAVE_HALF_SINE && steps % 4 == 0) return generate_quarter(steps);
+
+    float      * items = malloc(sizeof(float) * steps * STEPPER_PINS);
+    StepperQ15 * fixed = malloc(sizeof(StepperQ15) * steps * STEPPER_PINS);
+
+    if (!items || !fixed) {
+        free(items);
+        free(fixed);
+        return (PWMSequence){0};
+    }
+
+    PWMSequence seq = {0};
+    switch (wave) {
+        case SEQ_WAVE_HALF_SINE:
+            seq = stepper_generate_seq(steps, items);
+            break;
+    }
+    stepper_seq_to_fixed(&seq, fixed);
+
+    return seq;
+}
+
+// Constant table of a sequence, if there is one
+static const PWMSequence * find_const(uint steps, SeqWaveform wave) {
+    if (wave != SEQ_WAVE_HALF_SINE) return NULL;
+
+    for (size_t i = 0; i < seq_table_count; i++) {
+        if (seq_tables[i].length == steps) return &seq_tables[i];
+    }
+    return NULL;
+}
+
+PWMSequence seq_registry_acquire(uint steps, SeqWaveform wave) {
+    // Constant tables in flash need no reference counting
+    const PWMSequence * table = find_const(steps, wave);
+    if (table) return *table;
+
+    for (SeqEntry * e = entries; e; e = e->next) {
+        if (e->steps == steps && e->wave == wave) {
+            e->refs++;
+            return e->seq;
+        }
+    }
+
+    SeqEntry * e = malloc(sizeof(SeqEntry));
+    if (!e) return (PWMSequence){0};
+
+    e->seq = generate(steps, wave);
+    if (!e->seq.length) {
+        free(e);
+        return (PWMSequence){0};
+    }
+
+    e->steps = steps;
+    e->wave  = wave;
+    e->refs  = 1;
+    e->next  = entries;
+    entries  = e;
+
+    return e->seq;
+}
+
+bool seq_registry_release(PWMSequence seq) {
+    for (size_t i = 0; i < seq_table_count; i++) {
+        if (stepper_seq_table(seq_tables[i]) == stepper_seq_table(seq)) return true;
+    }
+
+    for (SeqEntry ** link = &entries; *link; link = &(*link)->next) {
+        SeqEntry * e = *link;
+        if (stepper_seq_table(e->seq) != stepper_seq_table(seq)) continue;
+
+        if (--e->refs == 0) {
+            *link = e->next;
+            free((float *)e->seq.items);
+            free((StepperQ15 *)e->seq.fixed);
+            free((StepperQ15 *)e->seq.quarter);
+            free(e);
+        }
+        return true;
+    }
+    return false;
+}
+
+uint seq_registry_count(void) {
+    uint count = 0;
+    for (SeqEntry * e = entries; e; e = e->next) count++;
+    return count;
+}
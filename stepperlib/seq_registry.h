@@ -0,0 +1,49 @@
+#ifndef SEQ_REGISTRY_H
+#define SEQ_REGISTRY_H
+
+#include <pico/stdlib.h>
+
+#include "stepper.h"
+
+/*
+ * Waveforms of registered sequences.
+ */
+typedef enum {
+    SEQ_WAVE_HALF_SINE, // Positive half of a sine per coil, see `stepper_generate_seq`
+} SeqWaveform;
+
+/*
+ * Shared, reference counted PWM sequences.
+ *
+ * Sequences are keyed by steps per sequence and waveform, so every motor
+ * with the same stepping mode shares one table. Sequences with a constant
+ * table in flash, see `seq_tables.h`, are handed out directly. Any other
+ * table is allocated with `malloc` on first use and freed when the last
+ * reference is released. Half sines of a multiple of 4 steps are compact
+ * quarter wave tables, see `stepper_generate_quarter_seq`. Others have a
+ * float and a fixed point table.
+ *
+ * The registry is not thread safe. Acquire and release from one core.
+ */
+
+/*
+ * Get a sequence with a quarter wave, or a float and a fixed point table,
+ * taking a reference.
+ *
+ * Returns a sequence with a length of zero if memory ran out.
+ */
+PWMSequence seq_registry_acquire(uint steps, SeqWaveform wave);
+
+/*
+ * Drop a reference to a sequence, freeing its tables with the last one.
+ *
+ * Returns false if the sequence does not come from the registry.
+ */
+bool seq_registry_release(PWMSequence seq);
+
+/*
+ * Number of allocated sequences currently held by the registry.
+ */
+uint seq_registry_count(void);
+
+#endif // SEQ_REGISTRY_H
@@ -0,0 +1,20 @@
+#ifndef SEQ_TABLES_H
+#define SEQ_TABLES_H
+
+#include <pico/stdlib.h>
+
+#include "stepper.h"
+
+/*
+ * Constant half sine sequences for every `StepperStepping` mode and the
+ * common longer sequences up to 1024 steps, as compact quarter wave tables,
+ * see `stepper_generate_quarter_seq`.
+ *
+ * Generated at build time by `gen_seq_tables.py`. Being `const`, the tables
+ * stay in flash and are read through the XIP cache, taking no SRAM and no
+ * time to generate at boot. All of them take about 1 KB.
+ */
+extern const PWMSequence seq_tables[];
+extern const size_t seq_table_count;
+
+#endif // SEQ_TABLES_H
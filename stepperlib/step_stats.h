@@ -0,0 +1,106 @@
+#ifndef STEP_STATS_H
+#define STEP_STATS_H
+
+#include <pico/stdlib.h>
+
+/*
+ * Step timing instrumentation.
+ *
+ * Only compiled in with the `STEPPER_STATS` CMake option. Without it,
+ * `Stepper` has no `stats` field and the `STEP_STATS_` macros expand to
+ * nothing, so neither their arguments nor the recording cost anything.
+ *
+ * Every step records its timestamp. When the stepping code has announced
+ * the period it intends with `STEP_STATS_EXPECT`, the error of the period
+ * since the previous step is recorded too. A step more than half a period
+ * late counts as a missed deadline.
+ */
+
+/*
+ * Number of step timestamps kept. Must be a power of two.
+ */
+#define STEP_STATS_RING 32
+
+/*
+ * Number of histogram bins. Bin 0 counts period errors below 1 µs, bin `k`
+ * errors in [2^(k-1), 2^k) µs, and the last bin everything above.
+ */
+#define STEP_STATS_BINS 16
+
+typedef struct {
+    uint32_t times[STEP_STATS_RING]; // Timestamps of the latest steps in µs
+    uint32_t steps;                  // Steps recorded
+
+    uint32_t expected_us; // Intended period. Zero when unknown.
+    bool has_last;        // Whether the previous step belongs to the period
+
+    uint32_t periods; // Periods with an expected value
+    int32_t min_error_us;
+    int32_t max_error_us;
+    int64_t sum_error_us;
+    uint32_t missed;
+
+    uint32_t histogram[STEP_STATS_BINS]; // Absolute period errors
+} StepStats;
+
+static inline void step_stats_reset(StepStats * stats) {
+    *stats = (StepStats){0};
+}
+
+/*
+ * Announce the intended step period. Zero stops checking periods and starts
+ * over at the next step, so an idle gap does not count as an error.
+ */
+static inline void step_stats_expect(StepStats * stats, uint32_t period_us) {
+    if (period_us == 0) stats->has_last = false;
+    stats->expected_us = period_us;
+}
+
+/*
+ * Start over at the next step, for example after stepping was paused.
+ */
+static inline void step_stats_restart(StepStats * stats) {
+    stats->has_last = false;
+}
+
+static inline uint step_stats_bin(uint32_t error_us) {
+    uint bin = 0;
+    while (error_us && bin < STEP_STATS_BINS - 1) {
+        error_us >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+static inline void step_stats_record(StepStats * stats, uint32_t now_us) {
+    uint32_t last = stats->times[(stats->steps - 1) & (STEP_STATS_RING - 1)];
+    stats->times[stats->steps & (STEP_STATS_RING - 1)] = now_us;
+    stats->steps++;
+
+    bool has_last   = stats->has_last;
+    stats->has_last = true;
+    if (!has_last || !stats->expected_us) return;
+
+    int32_t error = (int32_t)(now_us - last - stats->expected_us);
+
+    if (stats->periods == 0 || error < stats->min_error_us) stats->min_error_us = error;
+    if (stats->periods == 0 || error > stats->max_error_us) stats->max_error_us = error;
+    stats->sum_error_us += error;
+    stats->periods++;
+
+    if (error > (int32_t)(stats->expected_us / 2)) stats->missed++;
+
+    stats->histogram[step_stats_bin(error < 0 ? -error : error)]++;
+}
+
+#if STEPPER_STATS
+#define STEP_STATS_RECORD(stepper)            step_stats_record(&(stepper)->stats, time_us_32())
+#define STEP_STATS_EXPECT(stepper, period_us) step_stats_expect(&(stepper)->stats, (period_us))
+#define STEP_STATS_RESTART(stepper)           step_stats_restart(&(stepper)->stats)
+#else
+#define STEP_STATS_RECORD(stepper)            ((void)0)
+#define STEP_STATS_EXPECT(stepper, period_us) ((void)0)
+#define STEP_STATS_RESTART(stepper)           ((void)0)
+#endif
+
+#endif // STEP_STATS_H
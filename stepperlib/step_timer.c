@@ -0,0 +1,282 @@
+#include <pico/stdlib.h>
+#include <hardware/timer.h>
+
+#include "step_timer.h"
+
+// Step timer handling each hardware alarm
+static StepTimer * alarm_timers[NUM_ALARMS];
+
+static uint64_t next_deadline(StepTimer * timer) {
+    uint64_t next = UINT64_MAX;
+
+    for (uint i = 0; i < timer->channel_count; i++) {
+        StepTimerChannel * ch = &timer->channels[i];
+        if (ch->period_us) next = MIN(next, ch->deadline);
+    }
+
+    if (timer->control) next = MIN(next, timer->control_deadline);
+
+    return next;
+}
+
+// Arm the alarm for the earliest deadline. Must hold the lock.
+// Returns true if the deadline has already passed.
+static bool arm(StepTimer * timer) {
+    uint64_t next = next_deadline(timer);
+
+    if (next == UINT64_MAX) {
+        hardware_alarm_cancel(timer->alarm);
+        return false;
+    }
+
+    return hardware_alarm_set_target(timer->alarm, from_us_since_boot(next));
+}
+
+// Advance a deadline by one period. If it is still behind, the interrupt
+// was late by more than a period, so restart from now instead of catching
+// up with a burst of steps.
+static uint64_t advance(uint64_t deadline, uint32_t period_us, uint64_t now) {
+    deadline += period_us;
+    return deadline > now ? deadline : now + period_us;
+}
+
+// Advance the deadline of a channel by its period, carrying the fractions
+// of a microsecond over to the following steps
+static void advance_channel(StepTimerChannel * ch, uint64_t now) {
+    uint32_t phase = ch->phase + ch->period_frac;
+    ch->phase      = phase;
+    ch->deadline   = advance(ch->deadline, ch->period_us + (phase >> STEP_TIMER_FRAC_BITS), now);
+}
+
+// Magnitude of a signed step count or period. Negating as unsigned also
+// works for INT32_MIN, where abs() is undefined.
+static uint32_t magnitude(int32_t value) {
+    return value < 0 ? -(uint32_t)value : (uint32_t)value;
+}
+
+static void step_due(StepTimer * timer, uint64_t now) {
+    for (uint i = 0; i < timer->channel_count; i++) {
+        StepTimerChannel * ch = &timer->channels[i];
+        if (!ch->period_us || ch->deadline > now) continue;
+
+        size_t length = ch->stepper->sequence.length;
+        stepper_step(ch->stepper, ch->direction, ch->level);
+
+        // A switch to a coarser sequence makes every step longer
+        if (ch->stepper->sequence.length != length) {
+            uint64_t period = ((uint64_t)ch->period_us << STEP_TIMER_FRAC_BITS) | ch->period_frac;
+            period = period * length / ch->stepper->sequence.length;
+            ch->period_us   = period >> STEP_TIMER_FRAC_BITS;
+            ch->period_frac = period;
+        }
+
+        if (ch->remaining && --ch->remaining == 0) {
+            ch->period_us = 0;
+            ch->profile   = NULL;
+            continue;
+        }
+
+        if (ch->profile) {
+            int32_t period = *ch->profile++;
+            ch->period_us  = MAX(magnitude(period), 1);
+            ch->direction  = period >= 0;
+            STEP_STATS_EXPECT(ch->stepper, ch->period_us);
+        }
+
+        advance_channel(ch, now);
+    }
+}
+
+static void alarm_handler(uint alarm) {
+    StepTimer * timer = alarm_timers[alarm];
+    if (!timer) return;
+
+    bool missed = true;
+    while (missed && timer->running) {
+        uint64_t now = time_us_64();
+
+        critical_section_enter_blocking(&timer->lock);
+        step_due(timer, now);
+
+        bool control_due = timer->control && (timer->control_requested || timer->control_deadline <= now);
+        if (control_due && timer->control_deadline <= now) {
+            timer->control_deadline = advance(timer->control_deadline, timer->control_period_us, now);
+        }
+        timer->control_requested = false;
+        critical_section_exit(&timer->lock);
+
+        // The control callback may update the channels
+        if (control_due) timer->control(timer->control_ctx);
+
+        critical_section_enter_blocking(&timer->lock);
+        missed = arm(timer);
+        critical_section_exit(&timer->lock);
+    }
+}
+
+bool step_timer_init(StepTimer * timer) {
+    *timer = (StepTimer){0};
+
+    timer->alarm = hardware_alarm_claim_unused(false);
+    if (timer->alarm < 0) return false;
+
+    critical_section_init(&timer->lock);
+
+    alarm_timers[timer->alarm] = timer;
+    hardware_alarm_set_callback(timer->alarm, alarm_handler);
+
+    return true;
+}
+
+void step_timer_deinit(StepTimer * timer) {
+    if (timer->alarm < 0) return;
+
+    step_timer_stop(timer);
+
+    hardware_alarm_set_callback(timer->alarm, NULL);
+    hardware_alarm_unclaim(timer->alarm);
+    alarm_timers[timer->alarm] = NULL;
+    timer->alarm = -1;
+
+    critical_section_deinit(&timer->lock);
+}
+
+int step_timer_add(StepTimer * timer, Stepper * stepper) {
+    if (timer->channel_count >= STEP_TIMER_MAX_CHANNELS) return -1;
+
+    critical_section_enter_blocking(&timer->lock);
+    int channel = timer->channel_count++;
+    timer->channels[channel] = (StepTimerChannel){ .stepper = stepper };
+    critical_section_exit(&timer->lock);
+
+    return channel;
+}
+
+void step_timer_set(StepTimer * timer, uint channel, uint32_t period_us, bool direction, uint16_t level) {
+    step_timer_set_fine(timer, channel, (uint64_t)period_us << STEP_TIMER_FRAC_BITS, direction, level);
+}
+
+void step_timer_set_fine(StepTimer * timer, uint channel, uint64_t period, bool direction, uint16_t level) {
+    StepTimerChannel * ch = &timer->channels[channel];
+    uint32_t period_us    = period >> STEP_TIMER_FRAC_BITS;
+    bool missed = false;
+
+    critical_section_enter_blocking(&timer->lock);
+
+    // Only a shorter period pulls in the pending step, so setting the same
+    // period again keeps the carried fractions
+    uint64_t last = ((uint64_t)ch->period_us << STEP_TIMER_FRAC_BITS) | ch->period_frac;
+    uint64_t next = time_us_64() + period_us;
+    if (period_us && (!ch->period_us || (period < last && next < ch->deadline))) {
+        ch->deadline = next;
+        ch->phase    = 0;
+    }
+
+    ch->period_us   = period_us;
+    ch->period_frac = period_us ? period : 0;
+    ch->direction   = direction;
+    ch->level       = level;
+    ch->remaining   = 0;
+    ch->profile     = NULL;
+
+    STEP_STATS_EXPECT(ch->stepper, period_us);
+
+    if (timer->running) missed = arm(timer);
+
+    critical_section_exit(&timer->lock);
+
+    // Let the interrupt handler catch up
+    if (missed) hardware_alarm_force_irq(timer->alarm);
+}
+
+// Start a run of `steps` steps, the first one `period_us` from now
+static void start_run(StepTimer * timer, StepTimerChannel * ch, uint32_t steps, uint32_t period_us,
+        bool direction, uint16_t level, const int32_t * profile) {
+    bool missed = false;
+
+    critical_section_enter_blocking(&timer->lock);
+
+    ch->period_us   = steps ? MAX(period_us, 1) : 0;
+    ch->period_frac = 0;
+    ch->deadline    = time_us_64() + ch->period_us;
+    ch->direction = direction;
+    ch->level     = level;
+    ch->remaining = steps;
+    ch->profile   = steps ? profile : NULL;
+
+    STEP_STATS_RESTART(ch->stepper);
+    STEP_STATS_EXPECT(ch->stepper, ch->period_us);
+
+    if (timer->running) missed = arm(timer);
+
+    critical_section_exit(&timer->lock);
+
+    if (missed) hardware_alarm_force_irq(timer->alarm);
+}
+
+void step_timer_run(StepTimer * timer, uint channel, int32_t steps, uint32_t period_us, uint16_t level) {
+    start_run(timer, &timer->channels[channel], magnitude(steps), period_us, steps >= 0, level, NULL);
+}
+
+void step_timer_run_profile(StepTimer * timer, uint channel, const int32_t * periods_us, uint32_t count, uint16_t level) {
+    int32_t first = count ? periods_us[0] : 0;
+    start_run(timer, &timer->channels[channel], count, magnitude(first), first >= 0, level, periods_us + 1);
+}
+
+uint32_t step_timer_remaining(StepTimer * timer, uint channel) {
+    return timer->channels[channel].remaining;
+}
+
+void step_timer_set_control(StepTimer * timer, StepTimerControl control, void * ctx, uint32_t period_us) {
+    bool missed = false;
+
+    critical_section_enter_blocking(&timer->lock);
+    timer->control           = control;
+    timer->control_ctx       = ctx;
+    timer->control_period_us = period_us;
+    timer->control_deadline  = time_us_64() + period_us;
+
+    if (timer->running) missed = arm(timer);
+    critical_section_exit(&timer->lock);
+
+    if (missed) hardware_alarm_force_irq(timer->alarm);
+}
+
+void step_timer_request_control(StepTimer * timer) {
+    critical_section_enter_blocking(&timer->lock);
+    timer->control_requested = true;
+
+    // A forced interrupt only calls the handler once the alarm is disarmed.
+    // The handler arms it again.
+    if (timer->running) {
+        hardware_alarm_cancel(timer->alarm);
+        hardware_alarm_force_irq(timer->alarm);
+    }
+    critical_section_exit(&timer->lock);
+}
+
+void step_timer_start(StepTimer * timer) {
+    critical_section_enter_blocking(&timer->lock);
+
+    uint64_t now = time_us_64();
+    for (uint i = 0; i < timer->channel_count; i++) {
+        StepTimerChannel * ch = &timer->channels[i];
+        if (ch->deadline < now) ch->deadline = now + ch->period_us;
+        STEP_STATS_RESTART(ch->stepper);
+    }
+    if (timer->control_deadline < now) timer->control_deadline = now + timer->control_period_us;
+
+    timer->running = true;
+    bool missed = arm(timer);
+
+    critical_section_exit(&timer->lock);
+
+    if (missed) hardware_alarm_force_irq(timer->alarm);
+}
+
+void step_timer_stop(StepTimer * timer) {
+    critical_section_enter_blocking(&timer->lock);
+    timer->running = false;
+    hardware_alarm_cancel(timer->alarm);
+    critical_section_exit(&timer->lock);
+}
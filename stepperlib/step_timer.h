@@ -0,0 +1,157 @@
+#ifndef STEP_TIMER_H
+#define STEP_TIMER_H
+
+#include <pico/stdlib.h>
+#include <pico/sync.h>
+
+#include "stepper.h"
+
+/*
+ * Maximum number of steppers driven by a single step timer.
+ */
+#define STEP_TIMER_MAX_CHANNELS 4
+
+/*
+ * Fractional bits of the fixed-point periods of `step_timer_set_fine`.
+ */
+#define STEP_TIMER_FRAC_BITS 16
+
+/*
+ * A stepper driven by a step timer.
+ */
+typedef struct {
+    Stepper * stepper;
+    uint32_t period_us;   // Time between steps. Zero when idle.
+    uint16_t period_frac; // Fraction of a microsecond added to the period
+    uint16_t phase;       // Fractions carried over from the steps so far
+    bool direction;
+    uint16_t level;
+    uint64_t deadline;    // Absolute time of the next step
+
+    // Steps left of a run, or zero when stepping until stopped. See
+    // `step_timer_run`.
+    volatile uint32_t remaining;
+    const int32_t * profile; // Signed periods of the steps after the next one, or NULL
+} StepTimerChannel;
+
+/*
+ * Called from the timer interrupt every `control_period_us`. Used to update
+ * the channels, for example from queued commands.
+ */
+typedef void (*StepTimerControl)(void * ctx);
+
+/*
+ * Interrupt driven step scheduler.
+ *
+ * A hardware alarm fires at the earliest deadline of all channels. The
+ * interrupt handler steps every channel that is due and re-arms the alarm
+ * for the next deadline. Deadlines are absolute, so a late interrupt does
+ * not shift the following steps.
+ *
+ * The interrupt is handled on the core that called `step_timer_init`.
+ */
+typedef struct {
+    int alarm;
+    critical_section_t lock;
+
+    StepTimerChannel channels[STEP_TIMER_MAX_CHANNELS];
+    uint channel_count;
+
+    StepTimerControl control;
+    void * control_ctx;
+    uint32_t control_period_us;
+    uint64_t control_deadline;
+    bool control_requested; // See `step_timer_request_control`
+
+    bool running;
+} StepTimer;
+
+/*
+ * Initialize a step timer, claiming an unused hardware alarm.
+ *
+ * Returns false if no hardware alarm is available.
+ */
+bool step_timer_init(StepTimer * timer);
+
+/*
+ * Stop the step timer and release its hardware alarm.
+ */
+void step_timer_deinit(StepTimer * timer);
+
+/*
+ * Add a stepper to the step timer. The channel starts out idle.
+ *
+ * Returns the channel index, or -1 if all channels are in use.
+ */
+int step_timer_add(StepTimer * timer, Stepper * stepper);
+
+/*
+ * Set the step period, direction and PWM level of a channel. A period of
+ * zero stops stepping, leaving the coils as they are. Ends a run.
+ *
+ * Shortening the period takes effect immediately. Otherwise the pending
+ * step is kept and the new period applies from the step after it.
+ *
+ * This may be called from any core and from the control callback.
+ */
+void step_timer_set(StepTimer * timer, uint channel, uint32_t period_us, bool direction, uint16_t level);
+
+/*
+ * Like `step_timer_set`, with the period in fixed-point microseconds of
+ * `STEP_TIMER_FRAC_BITS` fractional bits.
+ *
+ * Each step still lands on a whole microsecond, but the fractions add up
+ * over the steps, so the step rate has no long-run error. Periods below one
+ * microsecond stop stepping.
+ */
+void step_timer_set_fine(StepTimer * timer, uint channel, uint64_t period, bool direction, uint16_t level);
+
+/*
+ * Make `steps` steps of a channel, one every `period_us`, then stop with
+ * the coils left energized. Negative steps go backward.
+ *
+ * Replaces whatever the channel was doing, and the first step comes one
+ * period from now. This may be called from any core.
+ */
+void step_timer_run(StepTimer * timer, uint channel, int32_t steps, uint32_t period_us, uint16_t level);
+
+/*
+ * Make one step of a channel for each of the `count` signed periods in
+ * `periods_us`, waiting the period before the step. Negative periods step
+ * backward. The channel stops after the last step with the coils left
+ * energized.
+ *
+ * The periods are read in place while the channel runs. Replaces whatever
+ * the channel was doing. This may be called from any core.
+ */
+void step_timer_run_profile(StepTimer * timer, uint channel, const int32_t * periods_us, uint32_t count, uint16_t level);
+
+/*
+ * Steps left of a run of a channel, zero once done. Also zero when stepping
+ * with `step_timer_set`.
+ */
+uint32_t step_timer_remaining(StepTimer * timer, uint channel);
+
+/*
+ * Call `control` from the timer interrupt every `period_us`, starting one
+ * period from now. A NULL `control` stops the calls.
+ *
+ * This may be called from any core and from the control callback.
+ */
+void step_timer_set_control(StepTimer * timer, StepTimerControl control, void * ctx, uint32_t period_us);
+
+/*
+ * Call the control callback from the timer interrupt right away, once,
+ * without waiting for its period. The periodic calls carry on as before.
+ *
+ * This may be called from any core.
+ */
+void step_timer_request_control(StepTimer * timer);
+
+/*
+ * Start and stop handling the channels from the timer interrupt.
+ */
+void step_timer_start(StepTimer * timer);
+void step_timer_stop(StepTimer * timer);
+
+#endif // STEP_TIMER_H
@@ -4,9 +4,12 @@
 #include <math.h>
 
 #include "stepper.h"
+#include "seq_registry.h"
 
 #define PANIC(msg) panic("Stepper error: %s", msg)
 
+#define CLAMP(x, lower, upper) ((x) < (lower) ? (lower) : ((x) > (upper) ? (upper) : (x)))
+
 const float PI = M_PI;
 
 const float COIL_PHASES[] = {
@@ -40,16 +43,194 @@ PWMSequence stepper_generate_seq(uint steps, float * table) {
     return seq;
 }
 
-static void state_to_levels(float state[STEPPER_PINS], uint16_t levels[STEPPER_PINS], uint16_t pwm) {
+void stepper_seq_to_fixed(PWMSequence * seq, StepperQ15 * table) {
+    for (size_t i = 0; i < seq->length * STEPPER_PINS; i++) {
+        float y = CLAMP(seq->items[i], 0.0f, 1.0f);
+        table[i] = (StepperQ15)(y * STEPPER_Q15_ONE + 0.5f);
+    }
+    seq->fixed = table;
+}
+
+PWMSequence stepper_generate_quarter_seq(uint steps, StepperQ15 * table) {
+    if (!steps || steps % 4) return (PWMSequence){0};
+
+    for (uint step = 0; step < STEPPER_QUARTER_LEN(steps); step++) {
+        float y = sin(2 * PI * (float)step / (float)steps);
+        table[step] = (StepperQ15)(CLAMP(y, 0.0f, 1.0f) * STEPPER_Q15_ONE + 0.5f);
+    }
+
+    PWMSequence seq = {0};
+    seq.quarter = table;
+    seq.length  = steps;
+
+    return seq;
+}
+
+// Fold the step of a coil into the quarter wave. Coil `c` is `c` quarters
+// ahead, and is only driven in the positive half of its sine. Returns -1 in
+// the negative half.
+static int quarter_index(const PWMSequence * seq, size_t t, int coil) {
+    size_t quarter = seq->length / 4;
+
+    size_t p = t + coil * quarter;
+    if (p >= seq->length) p -= seq->length;
+
+    if (p >= 2 * quarter) return -1;
+    return p <= quarter ? p : 2 * quarter - p;
+}
+
+static void quarter_to_duty(const PWMSequence * seq, size_t t, StepperQ15 duty[STEPPER_PINS]) {
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        int k = quarter_index(seq, t, i);
+        duty[i] = k < 0 ? 0 : seq->quarter[k];
+    }
+}
+
+void stepper_seq_duty(const PWMSequence * seq, size_t t, StepperQ15 duty[STEPPER_PINS]) {
+    size_t idx = t * STEPPER_PINS;
+
+    if (seq->fixed) {
+        for (int i = 0; i < STEPPER_PINS; i++) duty[i] = seq->fixed[idx + i];
+    } else if (seq->quarter) {
+        quarter_to_duty(seq, t, duty);
+    } else {
+        for (int i = 0; i < STEPPER_PINS; i++) {
+            float y = CLAMP(seq->items[idx + i], 0.0f, 1.0f);
+            duty[i] = (StepperQ15)(y * STEPPER_Q15_ONE + 0.5f);
+        }
+    }
+}
+
+const void * stepper_seq_table(PWMSequence seq) {
+    if (seq.items)   return seq.items;
+    if (seq.fixed)   return seq.fixed;
+    return seq.quarter;
+}
+
+static void state_to_levels(const float state[STEPPER_PINS], uint16_t levels[STEPPER_PINS], uint16_t pwm) {
     for (int i = 0; i < STEPPER_PINS; i++) {
         levels[i] = (uint16_t)(state[i] * pwm);
     }
 }
 
+static void fixed_to_levels(const StepperQ15 state[STEPPER_PINS], uint16_t levels[STEPPER_PINS], uint16_t pwm) {
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        uint32_t level = ((uint32_t)state[i] * pwm) >> STEPPER_Q15_SHIFT;
+        levels[i] = MIN(level, PWM_MAX);
+    }
+}
+
+size_t stepper_level_cache_len(PWMSequence seq) {
+    return seq.quarter ? STEPPER_QUARTER_LEN(seq.length) : seq.length * STEPPER_PINS;
+}
+
+// A quarter wave is cached as the levels of its entries, and folded like
+// the duties. Other sequences are cached as the levels of every step.
+static void fill_level_cache(Stepper * stepper, uint16_t level) {
+    const PWMSequence * seq = &stepper->sequence;
+
+    if (seq->quarter) {
+        for (size_t k = 0; k < STEPPER_QUARTER_LEN(seq->length); k++) {
+            uint32_t cached = ((uint32_t)seq->quarter[k] * level) >> STEPPER_Q15_SHIFT;
+            stepper->level_cache[k] = MIN(cached, PWM_MAX);
+        }
+    } else {
+        for (size_t t = 0; t < seq->length; t++) {
+            fixed_to_levels(&seq->fixed[t * STEPPER_PINS], &stepper->level_cache[t * STEPPER_PINS], level);
+        }
+    }
+    stepper->cached_level = level;
+}
+
+static void cached_levels(Stepper * stepper, int t, uint16_t levels[STEPPER_PINS]) {
+    const PWMSequence * seq = &stepper->sequence;
+
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        if (!seq->quarter) {
+            levels[i] = stepper->level_cache[t * STEPPER_PINS + i];
+            continue;
+        }
+        int k = quarter_index(seq, t, i);
+        levels[i] = k < 0 ? 0 : stepper->level_cache[k];
+    }
+}
+
+// Only cache a level once it has been used for a sequence worth of steps, so
+// that a refill costs no more than computing those steps directly. Levels
+// changing every few steps, as in ramps, are never cached.
+static bool level_cached(Stepper * stepper, uint16_t level) {
+    if (!stepper->level_cache)          return false;
+    if (stepper->cached_level == level) return true;
+
+    // A coarser sequence may not fit
+    if (stepper_level_cache_len(stepper->sequence) > stepper->level_cache_len) return false;
+
+    if (stepper->missed_level != level) {
+        stepper->missed_level = level;
+        stepper->misses       = 0;
+    }
+    if (++stepper->misses < stepper->sequence.length) return false;
+
+    fill_level_cache(stepper, level);
+    return true;
+}
+
+void stepper_levels(Stepper * stepper, int t, uint16_t level, uint16_t levels[STEPPER_PINS]) {
+    size_t idx = t * STEPPER_PINS;
+
+    if (level_cached(stepper, level)) {
+        cached_levels(stepper, t, levels);
+    } else if (stepper->sequence.fixed) {
+        fixed_to_levels(&stepper->sequence.fixed[idx], levels, level);
+    } else if (stepper->sequence.quarter) {
+        StepperQ15 duty[STEPPER_PINS];
+        quarter_to_duty(&stepper->sequence, t, duty);
+        fixed_to_levels(duty, levels, level);
+    } else {
+        state_to_levels(&stepper->sequence.items[idx], levels, level);
+        for (int i = 0; i < STEPPER_PINS; i++) levels[i] = MIN(levels[i], PWM_MAX);
+    }
+}
+
 void stepper_init(Stepper * stepper, int pins[STEPPER_PINS], int steps_pr_seq) {
-    float * buf = malloc(sizeof(float) * steps_pr_seq* STEPPER_PINS);
-    PWMSequence seq = stepper_generate_seq(steps_pr_seq, buf);
+    PWMSequence seq = seq_registry_acquire(steps_pr_seq, SEQ_WAVE_HALF_SINE);
+    if (!seq.length) PANIC("out of memory for the PWM sequence");
+
     stepper_init_with_seq(stepper, pins, seq);
+
+    // The cache is optional, without one every step is computed
+    uint16_t * cache = malloc(sizeof(uint16_t) * stepper_level_cache_len(seq));
+    if (cache) stepper_use_level_cache(stepper, cache);
+}
+
+void stepper_use_level_cache(Stepper * stepper, uint16_t * cache) {
+    if (!stepper->sequence.fixed && !stepper->sequence.quarter) PANIC("level cache requires a fixed point sequence");
+    stepper->level_cache     = cache;
+    stepper->level_cache_len = stepper_level_cache_len(stepper->sequence);
+    stepper->cached_level    = -1;
+    stepper->missed_level    = -1;
+    stepper->misses          = 0;
+}
+
+// Group the pins by PWM slice
+static void resolve_slices(Stepper * stepper) {
+    stepper->slice_count = 0;
+
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        uint slice = pwm_gpio_to_slice_num(stepper->pins[i]);
+
+        StepperSlice * s = NULL;
+        for (uint k = 0; k < stepper->slice_count; k++) {
+            if (stepper->slices[k].slice == slice) s = &stepper->slices[k];
+        }
+        if (!s) {
+            s = &stepper->slices[stepper->slice_count++];
+            *s = (StepperSlice){ .slice = slice, .pin_a = -1, .pin_b = -1 };
+        }
+
+        if (pwm_gpio_to_channel(stepper->pins[i]) == PWM_CHAN_B) s->pin_b = i;
+        else s->pin_a = i;
+    }
 }
 
 void stepper_init_with_seq(Stepper * stepper, int pins[STEPPER_PINS], PWMSequence seq) {
@@ -58,47 +239,184 @@ void stepper_init_with_seq(Stepper * stepper, int pins[STEPPER_PINS], PWMSequenc
     stepper->sequence = seq;
     stepper->t = 0;
 
+    stepper->level_cache     = NULL;
+    stepper->level_cache_len = 0;
+    stepper->cached_level    = -1;
+    stepper->missed_level    = -1;
+    stepper->misses          = 0;
+
+    stepper->resolutions[0]     = seq;
+    stepper->resolution_count   = 1;
+    stepper->resolution         = 0;
+    stepper->pending_resolution = -1;
+
+    stepper->position  = 0;
+    stepper->step_size = 1;
+
+#if STEPPER_STATS
+    step_stats_reset(&stepper->stats);
+#endif
+
     for (int i = 0; i < STEPPER_PINS; i++) {
-        uint pin = pins[i];
+        gpio_set_function(pins[i], GPIO_FUNC_PWM);
+    }
+
+    resolve_slices(stepper);
 
-        gpio_set_function(pin, GPIO_FUNC_PWM);
-        uint slice_num = pwm_gpio_to_slice_num(pin);
+    for (uint k = 0; k < stepper->slice_count; k++) {
+        uint slice_num = stepper->slices[k].slice;
 
         // 16 bit resolution
         pwm_set_wrap(slice_num, PWM_WRAP);
         pwm_set_enabled(slice_num, true);
         pwm_set_clkdiv(slice_num, 1.0f);
-
-        uint16_t levels[STEPPER_PINS] = {0};
-        state_to_levels(stepper->sequence.items, levels, PWM_MIN);
-        stepper_set_pins(stepper, levels);
     }
+
+    uint16_t levels[STEPPER_PINS] = {0};
+    stepper_levels(stepper, 0, PWM_MIN, levels);
+    stepper_set_pins(stepper, levels);
 }
 
 void stepper_deinit(Stepper * stepper) {
     stepper_stop(stepper);
+    stepper_release_resolutions(stepper);
+
+    // Shared sequences are freed with their last user
+    if (stepper->sequence.length && !seq_registry_release(stepper->sequence)) {
+        free((float *)stepper->sequence.items);
+        free((StepperQ15 *)stepper->sequence.fixed);
+        free((StepperQ15 *)stepper->sequence.quarter);
+    }
+    stepper->sequence = (PWMSequence){0};
 
-    // Free allocated memory for PWM sequence
-    if (stepper->sequence.items) {
-        free(stepper->sequence.items);
-        stepper->sequence.items = NULL;
-        stepper->sequence.length = 0;
+    if (stepper->level_cache) {
+        free(stepper->level_cache);
+        stepper->level_cache = NULL;
     }
 }
 
 void stepper_set_pins(Stepper * stepper, uint16_t state[STEPPER_PINS]) {
-    for (int i = 0; i < STEPPER_PINS; i++) {
+    for (uint k = 0; k < stepper->slice_count; k++) {
+        const StepperSlice * s = &stepper->slices[k];
+
+        // Make sure that levels are within bounds
+        uint16_t a = s->pin_a >= 0 ? MIN(state[s->pin_a], PWM_MAX) : 0;
+        uint16_t b = s->pin_b >= 0 ? MIN(state[s->pin_b], PWM_MAX) : 0;
+
+        if (s->pin_a >= 0 && s->pin_b >= 0) pwm_set_both_levels(s->slice, a, b);
+        else if (s->pin_a >= 0)              pwm_set_chan_level(s->slice, PWM_CHAN_A, a);
+        else                                 pwm_set_chan_level(s->slice, PWM_CHAN_B, b);
+    }
+}
+
+uint32_t stepper_slice_mask(Stepper * stepper) {
+    uint32_t mask = 0;
+    for (uint k = 0; k < stepper->slice_count; k++) mask |= 1u << stepper->slices[k].slice;
+    return mask;
+}
+
+void stepper_sync_slices(uint32_t slice_mask) {
+    uint32_t enabled = pwm_hw->en;
 
-        // Make sure that level is within bounds
-        uint16_t level = state[i] > PWM_MAX ? PWM_MAX : state[i];
+    // Stop the slices, zero their counters and start them together
+    pwm_set_mask_enabled(enabled & ~slice_mask);
+    for (uint slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        if (slice_mask & (1u << slice)) pwm_set_counter(slice, 0);
+    }
+    pwm_set_mask_enabled(enabled | slice_mask);
+}
+
+// ==================== RESOLUTIONS ====================
+
+bool stepper_use_resolutions(Stepper * stepper, const uint * steps_pr_seq, uint count) {
+    size_t base  = stepper->resolutions[0].length;
+    uint   added = stepper->resolution_count;
 
-        pwm_set_gpio_level(stepper->pins[i], level);
+    for (uint i = 0; i < count && stepper->resolution_count < STEPPER_MAX_RESOLUTIONS; i++) {
+        size_t last = stepper->resolutions[stepper->resolution_count - 1].length;
+        if (!steps_pr_seq[i] || steps_pr_seq[i] >= last || base % steps_pr_seq[i]) continue;
+
+        PWMSequence seq = seq_registry_acquire(steps_pr_seq[i], SEQ_WAVE_HALF_SINE);
+        if (!seq.length) {
+            // Leave the resolutions as they were before the call
+            while (stepper->resolution_count > added) {
+                seq_registry_release(stepper->resolutions[--stepper->resolution_count]);
+            }
+            return false;
+        }
+
+        stepper->resolutions[stepper->resolution_count++] = seq;
     }
+    return true;
 }
 
+void stepper_release_resolutions(Stepper * stepper) {
+    stepper_set_resolution(stepper, 0);
+
+    for (uint i = 1; i < stepper->resolution_count; i++) {
+        seq_registry_release(stepper->resolutions[i]);
+    }
+    stepper->resolution_count = MIN(stepper->resolution_count, 1);
+}
+
+static void switch_resolution(Stepper * stepper, uint index) {
+    size_t from = stepper->sequence.length;
+    size_t to   = stepper->resolutions[index].length;
+
+    stepper->t = (size_t)stepper->t * to / from;
+    stepper->sequence           = stepper->resolutions[index];
+    stepper->resolution         = index;
+    stepper->pending_resolution = -1;
+    stepper->step_size          = stepper->resolutions[0].length / to;
+
+    // The cache is shared by all sequences
+    stepper->cached_level = -1;
+    stepper->misses       = 0;
+}
+
+// Switch to the pending coarser sequence if the step lies on its grid
+static void try_pending_resolution(Stepper * stepper) {
+    size_t ratio = stepper->sequence.length / stepper->resolutions[stepper->pending_resolution].length;
+    if (stepper->t % ratio == 0) switch_resolution(stepper, stepper->pending_resolution);
+}
+
+void stepper_set_resolution(Stepper * stepper, uint index) {
+    if (index >= stepper->resolution_count) return;
+
+    if (index == stepper->resolution) {
+        stepper->pending_resolution = -1;
+    } else if (index < stepper->resolution) {
+        switch_resolution(stepper, index);
+    } else {
+        stepper->pending_resolution = index;
+        try_pending_resolution(stepper);
+    }
+}
+
+void stepper_update_resolution(Stepper * stepper, float seqs_pr_sec) {
+    uint index = stepper->resolution;
+
+    while (index + 1 < stepper->resolution_count &&
+            seqs_pr_sec * stepper->resolutions[index].length > STEPPER_MAX_STEP_RATE) {
+        index++;
+    }
+
+    while (index > 0 &&
+            seqs_pr_sec * stepper->resolutions[index - 1].length < STEPPER_MAX_STEP_RATE * STEPPER_RESOLUTION_HYSTERESIS) {
+        index--;
+    }
+
+    stepper_set_resolution(stepper, index);
+}
+
+// ==================== STEPPING ====================
+
 void stepper_step(Stepper* stepper, bool direction, uint16_t level) {
+    STEP_STATS_RECORD(stepper);
+
     // Step the stepper in the given direction
     stepper->t += direction ? 1 : -1;
+    stepper->position += direction ? stepper->step_size : -(int64_t)stepper->step_size;
 
     // Wrap around if negative
     if (stepper->t < 0) stepper->t += stepper->sequence.length;
@@ -106,15 +424,33 @@ void stepper_step(Stepper* stepper, bool direction, uint16_t level) {
     // Wrap around if exceeding length
     stepper->t = stepper->t % stepper->sequence.length;
 
-    float * state = &stepper->sequence.items[stepper->t * STEPPER_PINS];
+    if (stepper->pending_resolution >= 0) try_pending_resolution(stepper);
 
     uint16_t levels[STEPPER_PINS] = {0};
-    state_to_levels(state, levels, level);
+
+    // Table lookup if the level is cached
+    if (stepper->level_cache && stepper->cached_level == level) cached_levels(stepper, stepper->t, levels);
+    else stepper_levels(stepper, stepper->t, level, levels);
 
     stepper_set_pins(stepper, levels);
 }
 
 void stepper_stop(Stepper* stepper) {
+    STEP_STATS_RESTART(stepper);
+
     uint16_t levels[STEPPER_PINS] = {0, 0, 0, 0};
     stepper_set_pins(stepper, levels);
 }
+
+void stepper_hold(Stepper* stepper, uint16_t level) {
+    if (!level) {
+        stepper_stop(stepper);
+        return;
+    }
+
+    STEP_STATS_RESTART(stepper);
+
+    uint16_t levels[STEPPER_PINS] = {0};
+    stepper_levels(stepper, stepper->t, level, levels);
+    stepper_set_pins(stepper, levels);
+}
@@ -3,6 +3,8 @@
 
 #include <pico/stdlib.h>
 
+#include "step_stats.h"
+
 /*
  * Number of pins used for a stepper motor
  */
@@ -30,6 +32,24 @@ static const uint16_t PWM_MAX  = PWM_WRAP * 70/100; // 70% duty cycle
  */
 static const uint16_t PWM_MIN  = PWM_WRAP * 20/100; // 20% duty cycle
 
+/*
+ * Maximum number of sequences a stepper switches between with speed,
+ * including its own. See `stepper_use_resolutions`.
+ */
+#define STEPPER_MAX_RESOLUTIONS 4
+
+/*
+ * Step rate in steps per second above which `stepper_update_resolution`
+ * switches to a coarser sequence.
+ */
+static const float STEPPER_MAX_STEP_RATE = 8000.0f;
+
+/*
+ * A finer sequence is switched back to when its step rate would be below
+ * this fraction of `STEPPER_MAX_STEP_RATE`.
+ */
+static const float STEPPER_RESOLUTION_HYSTERESIS = 0.7f;
+
 /*
  * Named constants for different stepping modes.
  *
@@ -42,17 +62,58 @@ enum StepperStepping {
     EIGHTH_STEP  = 1<<5,
 };
 
+/*
+ * Fixed point duty fraction. `STEPPER_Q15_ONE` is a 100% duty cycle.
+ *
+ * The RP2040 has no FPU, so scaling a fraction by a PWM level is done with an
+ * integer multiply and shift: `(fraction * level) >> STEPPER_Q15_SHIFT`.
+ */
+typedef uint16_t StepperQ15;
+
+#define STEPPER_Q15_SHIFT 15
+#define STEPPER_Q15_ONE   (1u << STEPPER_Q15_SHIFT)
+
 /*
  * PWM sequence structure.
  *
  * Holds the PWM levels for each coil for each step in the sequence.
- * This items are dynamically allocated and must be freed when no longer needed.
+ * The tables are either constant, see `seq_tables.h`, or dynamically allocated
+ * and must be freed when no longer needed.
+ *
+ * `fixed` is an optional fixed point copy of `items`, see `stepper_seq_to_fixed`.
+ * When present, stepping does no floating point math.
+ *
+ * A compact sequence only has `quarter`, the first quarter wave of the coil
+ * duty in fixed point, see `stepper_generate_quarter_seq`. Every coil is the
+ * same half sine a quarter of the sequence apart, so the levels of a step
+ * are folded from it, and `items` and `fixed` are NULL. Use
+ * `stepper_seq_duty` to read any kind of sequence.
  */
 typedef struct {
-    float * items;
+    const float * items;
+    const StepperQ15 * fixed;
     size_t length;
+    const StepperQ15 * quarter;
 } PWMSequence;
 
+/*
+ * Entries of the quarter wave table of a compact sequence of `steps` steps,
+ * from 0 to 90 degrees inclusive.
+ */
+#define STEPPER_QUARTER_LEN(steps) ((steps) / 4 + 1)
+
+
+/*
+ * A PWM slice driven by a stepper motor.
+ *
+ * `pin_a` and `pin_b` index the stepper pins on channel A and B of the
+ * slice, or are -1 if the channel is not connected to the stepper.
+ */
+typedef struct {
+    uint8_t slice;
+    int8_t pin_a;
+    int8_t pin_b;
+} StepperSlice;
 
 /*
  * Stepper motor structure.
@@ -62,6 +123,38 @@ typedef struct {
     int * pins;           // Pins connected to the stepper motor
     PWMSequence sequence; // PWM sequence for the stepper motor
     int t;                // The current step
+
+    // PWM slices of the pins, resolved at init. See `stepper_set_pins`.
+    StepperSlice slices[STEPPER_PINS];
+    uint slice_count;
+
+    // Optional cache of compare values at `cached_level`, with room for
+    // `level_cache_len` of them. See `stepper_use_level_cache`.
+    uint16_t * level_cache;
+    size_t level_cache_len;
+    int cached_level;
+
+    // Level of the last steps computed without the cache, and their count
+    int missed_level;
+    size_t misses;
+
+    // Sequences to switch between with speed, finest first. The first one is
+    // the sequence the stepper was initialized with, and `sequence` is the
+    // one in use. See `stepper_use_resolutions`.
+    PWMSequence resolutions[STEPPER_MAX_RESOLUTIONS];
+    uint resolution_count;
+    uint resolution;        // Index of `sequence` in `resolutions`
+    int pending_resolution; // Coarser sequence waiting for phase alignment, or -1
+
+    // Signed steps made, counted in steps of the finest sequence so they do
+    // not depend on the resolution in use. `step_size` is the number of
+    // them in a step of `sequence`.
+    int64_t position;
+    uint step_size;
+
+#if STEPPER_STATS
+    StepStats stats; // Step timing, see `step_stats.h`
+#endif
 } Stepper;
 
 /*
@@ -69,8 +162,10 @@ typedef struct {
  *
  * Refer to the `StepperStepping` enum for different stepping modes.
  *
- * This method allocates memory for the PWM sequence internally using
- * the `malloc` from the PICO SDK. See `stepper_deinit` for freeing the memory.
+ * The PWM sequence and its fixed point table are shared with every other
+ * stepper of the same stepping mode through the sequence registry, see
+ * `seq_registry.h`. A level cache is allocated with `malloc`, and left out if
+ * memory runs out. See `stepper_deinit` for freeing the memory.
  *
  * See also `stepper_init_with_seq` and `stepper_generate_seq` for more control
  * over memory allocation.
@@ -79,6 +174,8 @@ void stepper_init(Stepper * stepper, int pins[STEPPER_PINS], int steps_pr_seq);
 
 /*
  * Deinitialize a stepper motor, stopping it and freeing allocated memory.
+ *
+ * A sequence from the registry is released. Any other sequence is freed.
  */
 void stepper_deinit(Stepper * stepper);
 
@@ -87,6 +184,8 @@ void stepper_deinit(Stepper * stepper);
  *
  * `direction` is true for forward, false for backward.
  * `level` is the PWM level to set for the step (0 to PWM_MAX).
+ *
+ * `position` is updated by `step_size`.
  */
 void stepper_step(Stepper* stepper, bool direction, uint16_t level);
 
@@ -95,9 +194,28 @@ void stepper_step(Stepper* stepper, bool direction, uint16_t level);
  *
  * `state` is an array of PWM levels with a maximum of `PWM_MAX`.
  * To get 20% duty cycle, set level to `PWM_WRAP * 20/100`.
+ *
+ * Both channels of a slice are set with a single store to its CC register,
+ * so the coils never see a half updated step. A slice with only one of the
+ * stepper pins is read, modified and written to keep the other channel.
  */
 void stepper_set_pins(Stepper * stepper, uint16_t state[STEPPER_PINS]);
 
+/*
+ * Bit mask of the PWM slices driven by the stepper.
+ */
+uint32_t stepper_slice_mask(Stepper * stepper);
+
+/*
+ * Restart the given PWM slices in phase, so they wrap at the same time.
+ *
+ * A slice latches new levels on its wrap, so levels written to in phase
+ * slices within one PWM period take effect together. Use
+ * `stepper_slice_mask` to find the slices of a stepper. Levels and other
+ * slices are left alone.
+ */
+void stepper_sync_slices(uint32_t slice_mask);
+
 /*
  * Stop the stepper motor by setting all pins to 0 PWM level.
  *
@@ -105,6 +223,15 @@ void stepper_set_pins(Stepper * stepper, uint16_t state[STEPPER_PINS]);
  */
 void stepper_stop(Stepper* stepper);
 
+/*
+ * Energize the coils at the current step of the sequence with the given PWM
+ * level (0 to PWM_MAX), without stepping.
+ *
+ * A low level holds the motor in place with less current than stepping
+ * takes. A level of 0 releases the motor like `stepper_stop`.
+ */
+void stepper_hold(Stepper* stepper, uint16_t level);
+
 /*
  * Generate a stepping sequence with given number of steps into the provided table.
  *
@@ -122,4 +249,102 @@ PWMSequence stepper_generate_seq(uint steps, float * table);
  */
 void stepper_init_with_seq(Stepper * stepper, int pins[STEPPER_PINS], PWMSequence seq);
 
+/*
+ * Convert the float items of a sequence to fixed point duty fractions.
+ *
+ * The caller must provide a table of size `seq->length * STEPPER_PINS`, which
+ * is stored in `seq->fixed`. This function does no allocations.
+ */
+void stepper_seq_to_fixed(PWMSequence * seq, StepperQ15 * table);
+
+/*
+ * Generate a compact half sine sequence of `steps` steps, equal to
+ * `stepper_generate_seq` in fixed point, storing only its quarter wave.
+ *
+ * The caller must provide a table of `STEPPER_QUARTER_LEN(steps)` entries,
+ * 16 times smaller than a fixed point table. `steps` must be a multiple of
+ * 4, otherwise a sequence with a length of zero is returned. This function
+ * does no allocations.
+ */
+PWMSequence stepper_generate_quarter_seq(uint steps, StepperQ15 * table);
+
+/*
+ * Get the fixed point duty of every coil at step `t` of a sequence, from
+ * whichever table it has.
+ */
+void stepper_seq_duty(const PWMSequence * seq, size_t t, StepperQ15 duty[STEPPER_PINS]);
+
+/*
+ * The table a sequence is read from, which identifies it. NULL for an
+ * empty sequence.
+ */
+const void * stepper_seq_table(PWMSequence seq);
+
+/*
+ * Number of levels a level cache of a sequence holds. A quarter wave only
+ * caches the levels of its `STEPPER_QUARTER_LEN` entries, other sequences
+ * those of every step.
+ */
+size_t stepper_level_cache_len(PWMSequence seq);
+
+/*
+ * Let the stepper cache the compare values of every step for the last used
+ * level, turning `stepper_step` into a table lookup. Steps at other levels
+ * are computed directly, and the cache is only refilled once a new level has
+ * been used for `sequence.length` steps in a row.
+ *
+ * The sequence of the stepper must have a fixed point or quarter wave table,
+ * and `cache` must have room for `stepper_level_cache_len(sequence)` levels.
+ * Coarser sequences that need more room are not cached. This method does not
+ * allocate memory.
+ */
+void stepper_use_level_cache(Stepper * stepper, uint16_t * cache);
+
+/*
+ * Add coarser sequences from the sequence registry, with the given steps per
+ * sequence, for the stepper to switch to at high speed. See
+ * `stepper_update_resolution`.
+ *
+ * Lengths that do not divide the length of the stepper's own sequence are
+ * skipped, as their steps do not line up with it. Must be called before the
+ * level cache is used with a sequence, as all sequences share the cache.
+ * The sequences are released by `stepper_deinit`, or
+ * `stepper_release_resolutions`.
+ *
+ * Returns false if a sequence could not be allocated, in which case none of
+ * the sequences of this call are added.
+ */
+bool stepper_use_resolutions(Stepper * stepper, const uint * steps_pr_seq, uint count);
+
+/*
+ * Switch back to the stepper's own sequence and release the coarser ones.
+ */
+void stepper_release_resolutions(Stepper * stepper);
+
+/*
+ * Switch to the sequence at `index` of `resolutions`.
+ *
+ * A finer sequence is switched to immediately, mapping the current step to
+ * the same phase. A coarser one is switched to at the first step lying on
+ * its coarser grid, so the phase of the coils never jumps.
+ */
+void stepper_set_resolution(Stepper * stepper, uint index);
+
+/*
+ * Pick the finest sequence whose step rate stays below
+ * `STEPPER_MAX_STEP_RATE` at `seqs_pr_sec` sequences per second, with
+ * hysteresis, and switch to it with `stepper_set_resolution`.
+ *
+ * Switching to a coarser sequence changes the distance of a step, so
+ * callers must rescale their step rate when `sequence.length` changes.
+ */
+void stepper_update_resolution(Stepper * stepper, float seqs_pr_sec);
+
+/*
+ * Compute the clamped PWM levels of the coils at step `t` for the given level.
+ *
+ * Uses the level cache or fixed point table when available.
+ */
+void stepper_levels(Stepper * stepper, int t, uint16_t level, uint16_t levels[STEPPER_PINS]);
+
 #endif // STEPPER_H
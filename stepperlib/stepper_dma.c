@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <pico/stdlib.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/pwm.h>
+
+#include "stepper_dma.h"
+
+// Transfers of a data channel before its control channel re-arms it
+#define DMA_TRANSFERS 0xffffffffu
+
+// Read by the control channels, so it must live in RAM
+static uint32_t dma_transfers = DMA_TRANSFERS;
+
+static bool is_pow2(uint x) {
+    return x && !(x & (x - 1));
+}
+
+static uint log2_pow2(uint x) {
+    uint bits = 0;
+    while (x >>= 1) bits++;
+    return bits;
+}
+
+static uint table_length(StepperDma * sd) {
+    return sd->stepper->sequence.length * sd->repeat;
+}
+
+static uint32_t slice_compare(StepperDma * sd, uint slice_idx, int t) {
+    Stepper * stepper = sd->stepper;
+
+    uint16_t levels[STEPPER_PINS];
+    stepper_levels(stepper, t, sd->level, levels);
+
+    uint32_t cc = 0;
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        uint pin = stepper->pins[i];
+        if (pwm_gpio_to_slice_num(pin) != sd->slices[slice_idx]) continue;
+        cc |= (uint32_t)levels[i] << (pwm_gpio_to_channel(pin) ? 16 : 0);
+    }
+    return cc;
+}
+
+static bool alloc_tables(StepperDma * sd, uint repeat) {
+    size_t bytes = sd->stepper->sequence.length * repeat * sizeof(uint32_t);
+    if (bytes > STEPPER_DMA_MAX_TABLE_BYTES) return false;
+
+    for (uint s = 0; s < sd->slice_count; s++) {
+        free(sd->tables[s]);
+
+        // The DMA read ring requires the table to be aligned to its size
+        sd->tables[s] = aligned_alloc(bytes, bytes);
+        if (!sd->tables[s]) return false;
+    }
+    sd->repeat = repeat;
+    return true;
+}
+
+// Fill the tables so that streaming starts with the step after `stepper->t`
+static void build_tables(StepperDma * sd) {
+    int length = sd->stepper->sequence.length;
+    int dir    = sd->direction ? 1 : -1;
+
+    for (uint s = 0; s < sd->slice_count; s++) {
+        uint32_t * table = sd->tables[s];
+        for (int k = 0; k < length; k++) {
+            int t = ((sd->stepper->t + (k + 1) * dir) % length + length) % length;
+            uint32_t cc = slice_compare(sd, s, t);
+            for (uint r = 0; r < sd->repeat; r++) {
+                table[k * sd->repeat + r] = cc;
+            }
+        }
+    }
+}
+
+static void set_timer_rate(StepperDma * sd, float rate) {
+    float clk = clock_get_hz(clk_sys);
+
+    float num = MAX(MIN(65535.0f * rate / clk, 65535.0f), 1.0f);
+    float den = MAX(MIN(clk * (uint16_t)num / rate + 0.5f, 65535.0f), num);
+
+    dma_timer_set_fraction(sd->timer, (uint16_t)num, (uint16_t)den);
+}
+
+static void start(StepperDma * sd) {
+    uint ring_bits = log2_pow2(table_length(sd) * sizeof(uint32_t));
+    uint32_t mask  = 0;
+
+    build_tables(sd);
+
+    for (uint s = 0; s < sd->slice_count; s++) {
+        dma_channel_config c = dma_channel_get_default_config(sd->chans[s]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_ring(&c, false, ring_bits);
+        channel_config_set_dreq(&c, dma_get_timer_dreq(sd->timer));
+        channel_config_set_chain_to(&c, sd->ctrl_chans[s]);
+
+        dma_channel_configure(sd->chans[s], &c,
+                &pwm_hw->slice[sd->slices[s]].cc, sd->tables[s],
+                DMA_TRANSFERS, false);
+
+        // When the data channel runs out of transfers, its control channel
+        // resets the count and triggers it again, continuing the ring
+        dma_channel_config rc = dma_channel_get_default_config(sd->ctrl_chans[s]);
+        channel_config_set_transfer_data_size(&rc, DMA_SIZE_32);
+        channel_config_set_read_increment(&rc, false);
+        channel_config_set_write_increment(&rc, false);
+
+        dma_channel_configure(sd->ctrl_chans[s], &rc,
+                &dma_channel_hw_addr(sd->chans[s])->al1_transfer_count_trig, &dma_transfers,
+                1, false);
+
+        mask |= 1u << sd->chans[s];
+    }
+
+    // Start all slices on the same timer tick
+    dma_start_channel_mask(mask);
+    sd->running = true;
+}
+
+bool stepper_dma_init(StepperDma * sd, Stepper * stepper) {
+    *sd = (StepperDma){0};
+    sd->stepper   = stepper;
+    sd->direction = true;
+    sd->timer     = -1;
+
+    if (!is_pow2(stepper->sequence.length)) return false;
+
+    // Find the slices spanned by the stepper pins
+    for (int i = 0; i < STEPPER_PINS; i++) {
+        uint slice = pwm_gpio_to_slice_num(stepper->pins[i]);
+        bool known = false;
+        for (uint s = 0; s < sd->slice_count; s++) known |= sd->slices[s] == slice;
+        if (!known) sd->slices[sd->slice_count++] = slice;
+    }
+
+    for (uint s = 0; s < sd->slice_count; s++) sd->chans[s] = sd->ctrl_chans[s] = -1;
+
+    sd->timer = dma_claim_unused_timer(false);
+    bool ok = sd->timer >= 0;
+
+    for (uint s = 0; ok && s < sd->slice_count; s++) {
+        sd->chans[s]      = dma_claim_unused_channel(false);
+        sd->ctrl_chans[s] = dma_claim_unused_channel(false);
+        ok = sd->chans[s] >= 0 && sd->ctrl_chans[s] >= 0;
+    }
+
+    if (!ok || !alloc_tables(sd, 1)) {
+        stepper_dma_deinit(sd);
+        return false;
+    }
+
+    return true;
+}
+
+void stepper_dma_deinit(StepperDma * sd) {
+    stepper_dma_stop(sd);
+
+    for (uint s = 0; s < sd->slice_count; s++) {
+        if (sd->chans[s] >= 0) dma_channel_unclaim(sd->chans[s]);
+        if (sd->ctrl_chans[s] >= 0) dma_channel_unclaim(sd->ctrl_chans[s]);
+        sd->chans[s] = sd->ctrl_chans[s] = -1;
+
+        free(sd->tables[s]);
+        sd->tables[s] = NULL;
+    }
+
+    if (sd->timer >= 0) dma_timer_unclaim(sd->timer);
+    sd->timer = -1;
+}
+
+void stepper_dma_stop(StepperDma * sd) {
+    if (!sd->running) return;
+
+    // Control channels first, so that a re-arm in flight can not restart a
+    // data channel
+    for (uint s = 0; s < sd->slice_count; s++) {
+        dma_channel_abort(sd->ctrl_chans[s]);
+        dma_channel_abort(sd->chans[s]);
+    }
+    sd->running = false;
+
+    // The read address points at the next entry. Work out which step the
+    // previous entry, the last one written, belongs to.
+    const uint32_t * next = (const uint32_t *)dma_channel_hw_addr(sd->chans[0])->read_addr;
+    uint length = table_length(sd);
+    uint last   = ((next - sd->tables[0]) + length - 1) % length;
+
+    int seq_len = sd->stepper->sequence.length;
+    int steps   = last / sd->repeat + 1;
+    int t       = sd->stepper->t + (sd->direction ? steps : -steps);
+
+    sd->stepper->t = (t % seq_len + seq_len) % seq_len;
+}
+
+void stepper_dma_set_speed(StepperDma * sd, float steps_pr_sec) {
+    sd->steps_pr_sec = steps_pr_sec;
+
+    if (steps_pr_sec <= 0) {
+        stepper_dma_stop(sd);
+        return;
+    }
+
+    // Repeat table entries until the timer rate is within reach
+    float min_rate = (float)clock_get_hz(clk_sys) / 65535.0f;
+    uint  repeat   = 1;
+    while (steps_pr_sec * repeat < min_rate &&
+           sd->stepper->sequence.length * repeat * 2 * sizeof(uint32_t) <= STEPPER_DMA_MAX_TABLE_BYTES) {
+        repeat *= 2;
+    }
+
+    if (repeat != sd->repeat) {
+        stepper_dma_stop(sd);
+        if (!alloc_tables(sd, repeat)) return;
+    }
+
+    set_timer_rate(sd, steps_pr_sec * sd->repeat);
+
+    if (!sd->running) start(sd);
+}
+
+void stepper_dma_set_drive(StepperDma * sd, bool direction, uint16_t level) {
+    if (direction == sd->direction && level == sd->level) return;
+
+    bool running = sd->running;
+    stepper_dma_stop(sd);
+
+    sd->direction = direction;
+    sd->level     = level;
+
+    if (running) start(sd);
+}
@@ -0,0 +1,92 @@
+#ifndef STEPPER_DMA_H
+#define STEPPER_DMA_H
+
+#include "stepper.h"
+
+/*
+ * A stepper motor has 4 pins, so it can span at most 4 PWM slices.
+ */
+#define STEPPER_DMA_MAX_SLICES STEPPER_PINS
+
+/*
+ * Largest table the DMA read ring can wrap around (2^15 bytes).
+ */
+static const uint STEPPER_DMA_MAX_TABLE_BYTES = 1u << 15;
+
+/*
+ * DMA driven stepping backend.
+ *
+ * The compare values of every step in the PWM sequence are precomputed into
+ * one table per PWM slice. A DMA channel per slice streams its table into the
+ * slice's CC register in a ring, paced by a shared DMA timer. A chained
+ * control channel re-arms each channel, so streaming never runs out. The CPU
+ * is only involved when the speed, direction or level changes.
+ *
+ * Slices used by the stepper are owned by it. A slice channel not connected
+ * to one of the stepper pins is driven low.
+ */
+typedef struct {
+    Stepper * stepper;
+
+    // Slices spanned by the stepper, the DMA channel feeding each of them
+    // and the control channel re-arming that channel
+    uint slices[STEPPER_DMA_MAX_SLICES];
+    int chans[STEPPER_DMA_MAX_SLICES];
+    int ctrl_chans[STEPPER_DMA_MAX_SLICES];
+    uint32_t * tables[STEPPER_DMA_MAX_SLICES];
+    uint slice_count;
+
+    // DMA timer pacing all channels
+    int timer;
+
+    // Number of table entries per step (power of two). Entries are repeated
+    // for slow speeds, as the DMA timer can not tick slower than
+    // `clk_sys / 65535`.
+    uint repeat;
+
+    uint16_t level;
+    bool direction;
+    float steps_pr_sec;
+    bool running;
+} StepperDma;
+
+/*
+ * Initialize the DMA backend for an already initialized stepper.
+ *
+ * The sequence length of the stepper must be a power of two. This method
+ * claims two DMA channels per slice and a DMA timer, and allocates the
+ * compare tables using `malloc`. See `stepper_dma_deinit` for releasing them.
+ *
+ * Returns false if the sequence can not be streamed or the hardware is
+ * already in use.
+ */
+bool stepper_dma_init(StepperDma * sd, Stepper * stepper);
+
+/*
+ * Stop streaming and release the DMA resources and tables.
+ */
+void stepper_dma_deinit(StepperDma * sd);
+
+/*
+ * Set the stepping rate in steps per second. A rate of zero stops the
+ * stepper, holding its current position.
+ *
+ * Only the DMA timer is reprogrammed, unless the rate crosses into a range
+ * that needs a different table repetition.
+ */
+void stepper_dma_set_speed(StepperDma * sd, float steps_pr_sec);
+
+/*
+ * Set the direction and PWM level (0 to PWM_MAX) of the steps.
+ *
+ * This regenerates the compare tables, continuing from the current phase.
+ */
+void stepper_dma_set_drive(StepperDma * sd, bool direction, uint16_t level);
+
+/*
+ * Stop streaming. The stepper is left energized at its current step, which
+ * is written back to `stepper->t`.
+ */
+void stepper_dma_stop(StepperDma * sd);
+
+#endif // STEPPER_DMA_H